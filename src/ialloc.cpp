@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include <new>
+
+#include "ithread.h"
+#include "ialloc.h"
+
+#if defined (IMOCAP_COUNT_ALLOCS)
+
+#if __cplusplus >= 201103L
+#	define IALLOC_THROW
+#	define IALLOC_NOTHROW	noexcept
+#else
+#	define IALLOC_THROW		throw (std::bad_alloc)
+#	define IALLOC_NOTHROW	throw ()
+#endif
+
+// counts of the process, never locked
+static volatile long allocCalls = 0;
+static volatile long allocBytes = 0;
+
+//-----------------------------------------------------------------------------
+// counted allocation, with the behavior of the standard operator new
+//-----------------------------------------------------------------------------
+static void *countedAlloc(std::size_t size)
+{
+	atomicAdd(allocCalls, 1);
+	atomicAdd(allocBytes, static_cast<long>(size));
+	if (0 == size) size = 1;
+	for (;;) {
+		void *p = std::malloc(size);
+		if (NULL != p) return p;
+		std::new_handler handler = std::set_new_handler(NULL);
+		std::set_new_handler(handler);
+		if (NULL == handler) throw std::bad_alloc();
+		handler();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// replaced operators
+//-----------------------------------------------------------------------------
+void *operator new(std::size_t size) IALLOC_THROW
+{
+	return countedAlloc(size);
+}
+
+void *operator new[](std::size_t size) IALLOC_THROW
+{
+	return countedAlloc(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) IALLOC_NOTHROW
+{
+	try {
+		return countedAlloc(size);
+	} catch (...) {
+		return NULL;
+	}
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) IALLOC_NOTHROW
+{
+	try {
+		return countedAlloc(size);
+	} catch (...) {
+		return NULL;
+	}
+}
+
+void operator delete(void *p) IALLOC_NOTHROW
+{
+	std::free(p);
+}
+
+void operator delete[](void *p) IALLOC_NOTHROW
+{
+	std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) IALLOC_NOTHROW
+{
+	std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) IALLOC_NOTHROW
+{
+	std::free(p);
+}
+
+//-----------------------------------------------------------------------------
+// counts
+//-----------------------------------------------------------------------------
+bool isCountingAllocs()
+{
+	return true;
+}
+
+iAllocCount getAllocCount()
+{
+	return iAllocCount(static_cast<unsigned long>(atomicAdd(allocCalls, 0)),
+		static_cast<unsigned long>(atomicAdd(allocBytes, 0)));
+}
+
+#else	// #if defined (IMOCAP_COUNT_ALLOCS)
+
+bool isCountingAllocs()
+{
+	return false;
+}
+
+iAllocCount getAllocCount()
+{
+	return iAllocCount();
+}
+
+#endif	// #if defined (IMOCAP_COUNT_ALLOCS)
@@ -0,0 +1,49 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __IALLOC_H__
+#define __IALLOC_H__
+
+///////////////////////////////////////////////////////////////////////////////
+// accounting of heap allocations
+//
+// Builds defining IMOCAP_COUNT_ALLOCS replace the global operator new and
+// delete of the plug-in, so that every allocation made through them is
+// counted, from any thread. Counts wrap around, only differences between
+// two snapshots mean anything. Other builds count nothing.
+//
+struct iAllocCount {
+	unsigned long allocs;		// calls of operator new
+	unsigned long bytes;		// bytes asked for
+
+	iAllocCount() : allocs(0), bytes(0) {}
+	iAllocCount(unsigned long a, unsigned long b) : allocs(a), bytes(b) {}
+	iAllocCount operator-(const iAllocCount &c) const {
+		return iAllocCount(allocs - c.allocs, bytes - c.bytes);
+	}
+	iAllocCount &operator+=(const iAllocCount &c) {
+		allocs += c.allocs;
+		bytes += c.bytes;
+		return *this;
+	}
+};
+
+// whether allocations are counted by this build
+bool isCountingAllocs();
+// snapshot of the counts
+iAllocCount getAllocCount();
+
+#endif	// #ifndef __IALLOC_H__
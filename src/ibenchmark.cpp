@@ -0,0 +1,352 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "ithread.h"
+#include "iparallel.h"
+#include "ikinematics.h"
+#include "ireport.h"
+#include "imocapdatabvh.h"
+#include "imocapdatahtr.h"
+#include "ibenchmark.h"
+
+using namespace std;
+
+// allocations per frame taken as none
+const double allocsEpsilon = 0.001;
+
+//////////////////////////////////////
+// best times of the stages
+//
+struct iBenchTimes {
+	double tokenize, hierarchy, motion, bake, solve;
+	int result;
+	iBenchTimes() : tokenize(0.0), hierarchy(0.0), motion(0.0), bake(0.0), solve(0.0), result(MC_SUCCESS) {}
+};
+//
+//////////////////////////////////////
+
+//////////////////////////////////////
+// stand-in of keying joints
+//
+class iBakeTask : public iTask {
+	iSkeleton &skel;
+	vector< vector<float> > &values;
+public:
+	iBakeTask(iSkeleton &skobj, vector< vector<float> > &buffers) : skel(skobj), values(buffers) {}
+	void run(unsigned int idx) {
+		iSkeleton::iJoint *jot = skel.getNode(idx).joint;
+		imath::iVec base;
+		jot->getOffset(base);
+		vector<float> &out = values[idx];
+		out.resize(jot->motion.size() * Channel::MC_CH_COUNT);
+		for (unsigned int i = 0; i < jot->motion.size(); ++i) {
+			const iSkeleton::iFrame &fm = jot->motion[i];
+			float *v = &out[i * Channel::MC_CH_COUNT];
+			v[0] = static_cast<float>(base.x + fm.offset.x);
+			v[1] = static_cast<float>(base.y + fm.offset.y);
+			v[2] = static_cast<float>(base.z + fm.offset.z);
+			v[3] = static_cast<float>(fm.rotation.x);
+			v[4] = static_cast<float>(fm.rotation.y);
+			v[5] = static_cast<float>(fm.rotation.z);
+		}
+	}
+};
+//
+//////////////////////////////////////
+
+//-----------------------------------------------------------------------------
+// keep the better time
+//-----------------------------------------------------------------------------
+static void keepBest(double &best, double seconds, unsigned int run)
+{
+	if (0 == run || seconds < best) best = seconds;
+}
+
+//-----------------------------------------------------------------------------
+// a parser of the format
+//-----------------------------------------------------------------------------
+static iMocapData *createParser(unsigned int format, istream *in, iSkeleton *skel)
+{
+	if (iGeneratorParam::MC_GF_BVH == format) return new iMocapDataBvh(in, skel);
+	return new iMocapDataHtr(in, skel);
+}
+
+//-----------------------------------------------------------------------------
+// allocations of the motion phase
+//-----------------------------------------------------------------------------
+static int countMotionAllocs(unsigned int format, const string &data, double &allocs)
+{
+	istringstream in(data);
+	iSkeleton skel;
+	iImportReport report;
+	iMocapData *parser = createParser(format, &in, &skel);
+	const int result = parser->load(&report);
+	delete parser;
+	allocs = report.getPhaseAllocs("motion").allocs;
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+// allocations of every motion frame after warm-up
+//
+// Files of all frames and of half of them are parsed, so that allocations
+// made once (buffers, threads, reserved motion) cancel out.
+//-----------------------------------------------------------------------------
+static int measureFrameAllocs(const iBenchmarkParam &param, const string &data, double &perFrame)
+{
+	iGeneratorParam half(param.file);
+	half.frames = param.file.frames / 2;
+	ostringstream file;
+	int result = generateMocap(half, file);
+	if (MC_SUCCESS != result) return result;
+
+	double fullAllocs, halfAllocs;
+	result = countMotionAllocs(param.file.format, data, fullAllocs);
+	if (MC_SUCCESS != result) return result;
+	result = countMotionAllocs(param.file.format, file.str(), halfAllocs);
+	if (MC_SUCCESS != result) return result;
+
+	const unsigned int frames = param.file.frames - half.frames;
+	perFrame = (frames > 0) ? (fullAllocs - halfAllocs) / frames : 0.0;
+	return MC_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// time the stages with a count of threads
+//-----------------------------------------------------------------------------
+static void timeStages(const iBenchmarkParam &param, const string &data,
+	unsigned int threads, iBenchTimes &times)
+{
+	for (unsigned int run = 0; run < param.repeat; ++run) {
+		// tokenizer alone
+		{
+			istringstream in(data);
+			unsigned long words = 0;
+			const double begin = getWallTime();
+			if (iGeneratorParam::MC_GF_BVH == param.file.format) {
+				times.result = iMocapDataBvh::countWords(&in, words);
+			} else {
+				times.result = iMocapDataHtr::countWords(&in, words);
+			}
+			if (MC_SUCCESS != times.result) return;
+			keepBest(times.tokenize, getWallTime() - begin, run);
+		}
+
+		// parser
+		iSkeleton skel;
+		{
+			istringstream in(data);
+			iImportReport report;
+			iMocapData *parser = createParser(param.file.format, &in, &skel);
+			times.result = parser->load(&report);
+			delete parser;
+			if (MC_SUCCESS != times.result) return;
+			keepBest(times.hierarchy, report.getPhase("hierarchy"), run);
+			keepBest(times.motion, report.getPhase("motion"), run);
+		}
+
+		// stand-ins of the rebuild
+		{
+			vector< vector<float> > values(skel.countJoints());
+			iBakeTask task(skel, values);
+			const double begin = getWallTime();
+			if (!parallelFor(skel.countJoints(), task, threads)) times.result = MC_CANCELLED;
+			if (MC_SUCCESS != times.result) return;
+			keepBest(times.bake, getWallTime() - begin, run);
+		}
+		{
+			iKinematics kine;
+			const double begin = getWallTime();
+			times.result = kine.solve(skel, 0, param.file.frames, 1.0, threads);
+			if (MC_SUCCESS != times.result) return;
+			keepBest(times.solve, getWallTime() - begin, run);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// add a metric of a stage
+//-----------------------------------------------------------------------------
+static void addMetric(iBenchmarkMetrics &metrics, const iBenchmarkParam &param,
+	unsigned int threads, const char *stage, double amount, double seconds)
+{
+	if (seconds <= 0.0) return;
+	char name[64];
+	sprintf(name, "%s.t%u.%s", param.file.getFormatName(), threads, stage);
+	metrics[name] = amount / seconds;
+}
+
+//-----------------------------------------------------------------------------
+// runBenchmark
+//-----------------------------------------------------------------------------
+int runBenchmark(const iBenchmarkParam &param, ostream &out, iBenchmarkMetrics *metrics)
+{
+	// the file
+	//
+	string data;
+	double seconds;
+	{
+		ostringstream file;
+		const double begin = getWallTime();
+		const int result = generateMocap(param.file, file);
+		if (MC_SUCCESS != result) return result;
+		data = file.str();
+		seconds = getWallTime() - begin;
+	}
+	const double megabytes = data.size() / 1048576.0;
+	const double frames = param.file.frames;
+
+	char line[256];
+	sprintf(line, "%s, %u joints, %u frames, %.1f MB (generated in %.2fs), best of %u",
+		param.file.getFormatName(), param.file.joints, param.file.frames, megabytes, seconds,
+		(param.repeat > 0) ? param.repeat : 1);
+	out << line << "\n";
+	sprintf(line, "%8s %14s %14s %14s %14s %14s %14s %8s", "threads", "tokenize MB/s",
+		"hierarchy ms", "motion MB/s", "motion fps", "bake fps", "solve fps", "result");
+	out << line << "\n";
+
+	// the table
+	//
+	vector<unsigned int> counts(param.threads);
+	if (counts.empty()) counts.push_back(0);
+
+	int result = MC_SUCCESS;
+	for (unsigned int i = 0; i < counts.size(); ++i) {
+		startPool(counts[i]);
+		iBenchTimes times;
+		iBenchmarkParam once(param);
+		if (0 == once.repeat) once.repeat = 1;
+		timeStages(once, data, counts[i], times);
+
+		sprintf(line, "%8u %14.1f %14.2f %14.1f %14.0f %14.0f %14.0f %8d", countPoolThreads(),
+			(times.tokenize > 0.0) ? megabytes / times.tokenize : 0.0,
+			times.hierarchy * 1000.0,
+			(times.motion > 0.0) ? megabytes / times.motion : 0.0,
+			(times.motion > 0.0) ? frames / times.motion : 0.0,
+			(times.bake > 0.0) ? frames / times.bake : 0.0,
+			(times.solve > 0.0) ? frames / times.solve : 0.0,
+			times.result);
+		out << line << "\n";
+		if (MC_SUCCESS != times.result) {
+			result = times.result;
+		} else if (NULL != metrics) {
+			addMetric(*metrics, param, counts[i], "tokenizeMBps", megabytes, times.tokenize);
+			addMetric(*metrics, param, counts[i], "motionMBps", megabytes, times.motion);
+			addMetric(*metrics, param, counts[i], "motionFps", frames, times.motion);
+			addMetric(*metrics, param, counts[i], "bakeFps", frames, times.bake);
+			addMetric(*metrics, param, counts[i], "solveFps", frames, times.solve);
+		}
+	}
+
+	// the pool at the last count asked for, as the plug-in starts it
+	startPool(counts.back());
+
+	// the budget of allocations
+	//
+	if (isCountingAllocs() && MC_SUCCESS == result) {
+		double perFrame = 0.0;
+		result = measureFrameAllocs(param, data, perFrame);
+		if (MC_SUCCESS == result) {
+			sprintf(line, "motion allocations per frame after warm-up: %.3f", perFrame);
+			out << line << "\n";
+			if (NULL != metrics) {
+				sprintf(line, "%s.motionAllocsPerFrame", param.file.getFormatName());
+				(*metrics)[line] = perFrame;
+			}
+		}
+	}
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+// read a baseline
+//-----------------------------------------------------------------------------
+int readMetrics(const string &path, iBenchmarkMetrics &metrics)
+{
+	ifstream in(path.c_str());
+	if (!in) return MC_INVALID_STREAM;
+
+	string textLine;
+	while (getline(in, textLine)) {
+		istringstream words(textLine);
+		string name;
+		double value;
+		if (!(words >> name) || '#' == name[0]) continue;
+		if (!(words >> value)) return MC_ILLEAGAL_DATA;
+		metrics[name] = value;
+	}
+	return MC_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// write a baseline
+//-----------------------------------------------------------------------------
+int writeMetrics(const string &path, const iBenchmarkMetrics &metrics)
+{
+	ofstream out(path.c_str());
+	if (!out) return MC_INVALID_STREAM;
+	out.precision(6);
+	out << "# imocapBenchmark baseline, higher is better except budgets of allocations\n";
+	for (iBenchmarkMetrics::const_iterator it = metrics.begin(); it != metrics.end(); ++it) {
+		out << it->first << " " << it->second << "\n";
+	}
+	return out ? MC_SUCCESS : MC_INVALID_STREAM;
+}
+
+//-----------------------------------------------------------------------------
+// compare metrics with a baseline
+//-----------------------------------------------------------------------------
+unsigned int compareMetrics(const iBenchmarkMetrics &baseline,
+	const iBenchmarkMetrics &current, double noise, ostream &out)
+{
+	unsigned int regressions = 0, count = 0;
+	ostringstream items;
+	items.precision(6);
+
+	for (iBenchmarkMetrics::const_iterator it = baseline.begin(); it != baseline.end(); ++it) {
+		iBenchmarkMetrics::const_iterator now = current.find(it->first);
+		const bool missing = (current.end() == now);
+		const double value = missing ? 0.0 : now->second;
+		const double ratio = (it->second > 0.0) ? value / it->second : 1.0;
+		bool regressed;
+		if (string::npos == it->first.find("Allocs")) {
+			regressed = missing || (ratio < 1.0 - noise);
+		} else if (missing) {
+			// budgets are only measured by builds counting allocations
+			regressed = isCountingAllocs();
+		} else {
+			regressed = (value > it->second * (1.0 + noise) + allocsEpsilon);
+		}
+		if (regressed) ++regressions;
+
+		items << (count++ ? ",\n" : "\n") << "\t\t{ \"name\": \"" << it->first
+			<< "\", \"baseline\": " << it->second << ", \"current\": " << value
+			<< ", \"ratio\": " << ratio << ", \"missing\": " << (missing ? "true" : "false")
+			<< ", \"regressed\": " << (regressed ? "true" : "false") << " }";
+	}
+
+	out << "{\n";
+	out << "\t\"noise\": " << noise << ",\n";
+	out << "\t\"regressions\": " << regressions << ",\n";
+	out << "\t\"metrics\": [" << items.str() << "\n\t]\n";
+	out << "}\n";
+	return regressions;
+}
@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __IBENCHMARK_H__
+#define __IBENCHMARK_H__
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "igenerator.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// benchmark of the import stages
+//
+// A synthetic file is generated in memory, then for every count of threads
+// the tokenizer, the parser (hierarchy & motion) and two stand-ins of the
+// rebuild are timed separately: baking channel values of every joint as
+// keys would be set, and solving world transforms of all frames. The best
+// of the repeats is printed as a table of throughputs. Nothing here depends
+// on Maya.
+//
+struct iBenchmarkParam {
+	iGeneratorParam file;				// the file to load
+	std::vector<unsigned int> threads;	// counts of threads, 0 for all
+	unsigned int repeat;				// runs of every stage
+
+	iBenchmarkParam() : repeat(3) {}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// metrics of benchmarks
+//
+// Metrics are named "<format>.t<threads>.<stage>" (threads as requested, 0
+// for all) and measured so that higher is better. Builds counting
+// allocations add budgets "<format>.motionAllocsPerFrame", which are lower
+// is better. Baseline files hold a "name value" pair per line, lines
+// beginning with '#' are comments.
+//
+typedef std::map<std::string, double> iBenchmarkMetrics;
+
+// run the benchmark and print the table, metrics of the stages which
+// succeeded are added if wanted, return a MCDATA_RESULT value
+int runBenchmark(const iBenchmarkParam &param, std::ostream &out,
+	iBenchmarkMetrics *metrics = NULL);
+
+// read/write a baseline
+int readMetrics(const std::string &path, iBenchmarkMetrics &metrics);
+int writeMetrics(const std::string &path, const iBenchmarkMetrics &metrics);
+
+// compare metrics with a baseline and write the verdict of every metric
+// as JSON, a metric regresses when it drops below (1 - noise) of the
+// baseline or is missing, a budget when it rises above (1 + noise) of it,
+// return the quantity of regressions
+unsigned int compareMetrics(const iBenchmarkMetrics &baseline,
+	const iBenchmarkMetrics &current, double noise, std::ostream &out);
+
+#endif	// #ifndef __IBENCHMARK_H__
@@ -0,0 +1,60 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "idebug.h"
+#include "ichannel.h"
+
+using namespace std;
+
+//-----------------------------------------------------------------------------
+// measure min/max of every channel
+//-----------------------------------------------------------------------------
+void measureChannels(const iSkeleton::iMotion &motion,
+	iFrameCount first, iFrameCount last, iChannelRange &range)
+{
+	const unsigned int count = Channel::MC_CH_COUNT;
+	unsigned int c;
+
+	if (last > motion.size()) last = motion.size();
+	if (first >= last) {
+		range.frames = 0;
+		for (c = 0; c < count; ++c) range.minimum[c] = range.maximum[c] = 0.0;
+		return;
+	}
+	range.frames = last - first;
+
+	// all six lanes are updated without branches, so that compilers
+	// are able to turn the inner loop into packed min/max instructions
+	double lo[count], hi[count];
+	for (c = 0; c < count; ++c) lo[c] = hi[c] = getChannel(motion[first], c);
+
+	for (iFrameCount i = first + 1; i < last; ++i) {
+		const iSkeleton::iFrame &fm = motion[i];
+		const double v[count] = {
+			fm.offset.x, fm.offset.y, fm.offset.z,
+			fm.rotation.x, fm.rotation.y, fm.rotation.z
+		};
+		for (c = 0; c < count; ++c) {
+			lo[c] = (v[c] < lo[c]) ? v[c] : lo[c];
+			hi[c] = (v[c] > hi[c]) ? v[c] : hi[c];
+		}
+	}
+
+	for (c = 0; c < count; ++c) {
+		range.minimum[c] = lo[c];
+		range.maximum[c] = hi[c];
+	}
+}
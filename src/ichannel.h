@@ -0,0 +1,64 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __ICHANNEL_H__
+#define __ICHANNEL_H__
+
+#include <vector>
+
+#include "iskeleton.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// value range of a joint's channels over frames
+//
+struct iChannelRange {
+	iFrameCount frames;			// quantity of measured frames
+	double minimum[Channel::MC_CH_COUNT];
+	double maximum[Channel::MC_CH_COUNT];
+
+	// a channel without any frame is constant as well
+	bool isConstant(unsigned int ch, double tolerance) const {
+		return (0 == frames) || (maximum[ch] - minimum[ch] <= tolerance);
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// channel functions
+//
+// get a channel value from a frame
+inline double getChannel(const iSkeleton::iFrame &fm, unsigned int ch) {
+	switch (ch) {
+	case Channel::MC_CH_TX: return fm.offset.x;
+	case Channel::MC_CH_TY: return fm.offset.y;
+	case Channel::MC_CH_TZ: return fm.offset.z;
+	case Channel::MC_CH_RX: return fm.rotation.x;
+	case Channel::MC_CH_RY: return fm.rotation.y;
+	case Channel::MC_CH_RZ: return fm.rotation.z;
+	}
+	return 0.0;
+}
+
+// whether a channel is keyed by a curve, a constant one of a free plug is
+// set as a static value instead
+inline bool isKeyedChannel(const iChannelRange &range, unsigned int ch, double tolerance, bool connected) {
+	return connected || !range.isConstant(ch, tolerance);
+}
+
+// measure min/max of every channel in frames [first, last)
+void measureChannels(const iSkeleton::iMotion &motion,
+	iFrameCount first, iFrameCount last, iChannelRange &range);
+
+#endif	// #ifndef __ICHANNEL_H__
@@ -0,0 +1,318 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <new>
+#include <vector>
+
+#include "ithread.h"
+#if !defined (_WIN32)
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#endif
+
+#include "idebug.h"
+#include "ichunkstore.h"
+
+using namespace std;
+
+#if defined (_WIN32)
+typedef ULONGLONG iFileOffset;
+typedef HANDLE iFileHandle;
+#	define NO_FILE	INVALID_HANDLE_VALUE
+#else
+typedef off_t iFileOffset;
+typedef int iFileHandle;
+#	define NO_FILE	(-1)
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// chunks in the heap & in the temporary file
+//
+// Segments of the file are mapped one after another as it grows, chunks are
+// carved out of the last one. Freed chunks of the file are kept by size and
+// handed out again, since all chunks of a type have the same size.
+//
+struct iSegment {
+	size_t bytes;
+#if defined (_WIN32)
+	HANDLE mapping;
+#endif
+};
+
+struct iChunkRegistry {
+	iMutex lock;
+	double budget;					// bytes of chunks in the heap at most
+	string folder;					// of the temporary file
+	double heap;					// bytes of chunks in the heap
+	double spilled;					// bytes of chunks in the file
+	iFileHandle file;
+	iFileOffset length;				// bytes of the file
+	map<char *, iSegment> segments;	// mapped segments by base
+	char *cursor;					// free part of the last segment
+	size_t room;
+	map<size_t, vector<void *> > freed;
+
+	iChunkRegistry() : budget(0.0), heap(0.0), spilled(0.0), file(NO_FILE),
+		length(0), cursor(NULL), room(0) {
+		initMutex(lock);
+	}
+	~iChunkRegistry();
+};
+
+//-----------------------------------------------------------------------------
+// create the temporary file, it is gone once closed
+//-----------------------------------------------------------------------------
+static bool openFile(iChunkRegistry &reg)
+{
+#if defined (_WIN32)
+	char folder[MAX_PATH], path[MAX_PATH];
+	if (reg.folder.empty()) {
+		if (0 == GetTempPathA(MAX_PATH, folder)) return false;
+	} else {
+		strncpy(folder, reg.folder.c_str(), MAX_PATH - 1);
+		folder[MAX_PATH - 1] = '\0';
+	}
+	if (0 == GetTempFileNameA(folder, "imc", 0, path)) return false;
+	reg.file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+#else
+	string folder(reg.folder);
+	if (folder.empty()) {
+		const char *tmp = getenv("TMPDIR");
+		folder = (NULL != tmp && *tmp) ? tmp : "/tmp";
+	}
+	string pattern(folder + "/imocapXXXXXX");
+	vector<char> path(pattern.begin(), pattern.end());
+	path.push_back('\0');
+	reg.file = mkstemp(&path[0]);
+	if (NO_FILE != reg.file) unlink(&path[0]);
+#endif
+	if (NO_FILE == reg.file) {
+		ILOG4 ("Error: Cannot create a spill file in " << folder);
+		return false;
+	}
+	reg.length = 0;
+	ILOG2 ("Spilling chunks over " << reg.budget / (1024.0 * 1024.0) << " MB to " << folder);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// grow the file by a segment and map it, NULL if failed
+//-----------------------------------------------------------------------------
+static char *mapSegment(iChunkRegistry &reg, size_t bytes)
+{
+	if (NO_FILE == reg.file && !openFile(reg)) return NULL;
+
+	iSegment segment;
+	segment.bytes = bytes;
+	const iFileOffset length = reg.length + bytes;
+#if defined (_WIN32)
+	segment.mapping = CreateFileMappingA(reg.file, NULL, PAGE_READWRITE,
+		static_cast<DWORD>(length >> 32), static_cast<DWORD>(length & 0xffffffff), NULL);
+	if (NULL == segment.mapping) return NULL;
+	char *base = static_cast<char *>(MapViewOfFile(segment.mapping, FILE_MAP_ALL_ACCESS,
+		static_cast<DWORD>(reg.length >> 32), static_cast<DWORD>(reg.length & 0xffffffff), bytes));
+	if (NULL == base) {
+		CloseHandle(segment.mapping);
+		return NULL;
+	}
+#else
+	if (0 != ftruncate(reg.file, length)) return NULL;
+	void *view = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, reg.file, reg.length);
+	if (MAP_FAILED == view) return NULL;
+	char *base = static_cast<char *>(view);
+#endif
+	reg.length = length;
+	reg.segments[base] = segment;
+	ILOG1 ("Spill file grown to " << static_cast<double>(length) / (1024.0 * 1024.0) << " MB");
+	return base;
+}
+
+//-----------------------------------------------------------------------------
+// unmap all segments and remove the file
+//-----------------------------------------------------------------------------
+static void closeFile(iChunkRegistry &reg)
+{
+	map<char *, iSegment>::iterator iter;
+	for (iter = reg.segments.begin(); iter != reg.segments.end(); ++iter) {
+#if defined (_WIN32)
+		UnmapViewOfFile(iter->first);
+		CloseHandle(iter->second.mapping);
+#else
+		munmap(iter->first, iter->second.bytes);
+#endif
+	}
+	reg.segments.clear();
+	reg.freed.clear();
+	reg.cursor = NULL;
+	reg.room = 0;
+	if (NO_FILE != reg.file) {
+#if defined (_WIN32)
+		CloseHandle(reg.file);
+#else
+		close(reg.file);
+#endif
+		reg.file = NO_FILE;
+	}
+	reg.length = 0;
+}
+
+iChunkRegistry::~iChunkRegistry()
+{
+	closeFile(*this);
+	freeMutex(lock);
+}
+
+static iChunkRegistry registry;
+
+//-----------------------------------------------------------------------------
+// room for a chunk in the file, NULL if failed
+//-----------------------------------------------------------------------------
+static void *spillChunk(iChunkRegistry &reg, size_t bytes)
+{
+	vector<void *> &slots = reg.freed[bytes];
+	if (!slots.empty()) {
+		void *chunk = slots.back();
+		slots.pop_back();
+		return chunk;
+	}
+
+	// the rest of the last segment is left when a chunk does not fit
+	if (bytes > reg.room) {
+		const size_t length = (bytes + spillSegmentBytes - 1) / spillSegmentBytes * spillSegmentBytes;
+		char *base = mapSegment(reg, length);
+		if (NULL == base) return NULL;
+		reg.cursor = base;
+		reg.room = length;
+	}
+	void *chunk = reg.cursor;
+	reg.cursor += bytes;
+	reg.room -= bytes;
+	return chunk;
+}
+
+//-----------------------------------------------------------------------------
+// whether a chunk is carved out of a segment of the file
+//-----------------------------------------------------------------------------
+static bool isInFile(iChunkRegistry &reg, const void *chunk)
+{
+	char *p = static_cast<char *>(const_cast<void *>(chunk));
+	map<char *, iSegment>::iterator iter = reg.segments.upper_bound(p);
+	if (iter == reg.segments.begin()) return false;
+	--iter;
+	return p < iter->first + iter->second.bytes;
+}
+
+//-----------------------------------------------------------------------------
+// setSpillBudget
+//-----------------------------------------------------------------------------
+void setSpillBudget(double bytes, const string &folder)
+{
+	lockMutex(registry.lock);
+	registry.budget = bytes;
+	registry.folder = folder;
+	unlockMutex(registry.lock);
+}
+
+//-----------------------------------------------------------------------------
+// getSpillBudget
+//-----------------------------------------------------------------------------
+void getSpillBudget(double &bytes, string &folder)
+{
+	lockMutex(registry.lock);
+	bytes = registry.budget;
+	folder = registry.folder;
+	unlockMutex(registry.lock);
+}
+
+//-----------------------------------------------------------------------------
+// isSpilling
+//-----------------------------------------------------------------------------
+bool isSpilling()
+{
+	lockMutex(registry.lock);
+	const bool spilling = (registry.budget > 0.0);
+	unlockMutex(registry.lock);
+	return spilling;
+}
+
+//-----------------------------------------------------------------------------
+// allocChunk
+//-----------------------------------------------------------------------------
+void *allocChunk(size_t bytes)
+{
+	lockMutex(registry.lock);
+	void *chunk = NULL;
+	if (registry.budget <= 0.0 || registry.heap + bytes <= registry.budget) {
+		chunk = ::operator new(bytes, nothrow);
+		if (NULL != chunk) registry.heap += bytes;
+	} else {
+		chunk = spillChunk(registry, bytes);
+		if (NULL != chunk) registry.spilled += bytes;
+	}
+	unlockMutex(registry.lock);
+
+	if (NULL == chunk) throw bad_alloc();
+	return chunk;
+}
+
+//-----------------------------------------------------------------------------
+// freeChunk
+//-----------------------------------------------------------------------------
+void freeChunk(void *chunk, size_t bytes)
+{
+	if (NULL == chunk) return;
+
+	lockMutex(registry.lock);
+	if (isInFile(registry, chunk)) {
+		registry.freed[bytes].push_back(chunk);
+		registry.spilled -= bytes;
+		if (registry.spilled <= 0.0) {
+			registry.spilled = 0.0;
+			closeFile(registry);
+		}
+	} else {
+		::operator delete(chunk);
+		registry.heap -= bytes;
+	}
+	unlockMutex(registry.lock);
+}
+
+//-----------------------------------------------------------------------------
+// getChunkUse
+//-----------------------------------------------------------------------------
+void getChunkUse(double &heap, double &spilled)
+{
+	lockMutex(registry.lock);
+	heap = registry.heap;
+	spilled = registry.spilled;
+	unlockMutex(registry.lock);
+}
+
+//-----------------------------------------------------------------------------
+// isChunkSpilled
+//-----------------------------------------------------------------------------
+bool isChunkSpilled(const void *chunk)
+{
+	if (NULL == chunk) return false;
+	lockMutex(registry.lock);
+	const bool spilled = isInFile(registry, chunk);
+	unlockMutex(registry.lock);
+	return spilled;
+}
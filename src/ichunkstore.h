@@ -0,0 +1,58 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __ICHUNKSTORE_H__
+#define __ICHUNKSTORE_H__
+
+#include <cstddef>
+#include <string>
+
+///////////////////////////////////////////////////////////////////////////////
+// store of chunks
+//
+// Chunks of iChunkVector (motion, sampler tracks, world transforms) come
+// from here. They are taken from the heap until the spill budget is used
+// up, later ones are carved one after another out of a temporary file
+// mapped into memory, so that a take larger than the memory keeps being
+// written sequentially and the system pages frames in and out on access.
+// The file is removed once its last chunk is freed, or when the process
+// ends. All functions are safe to call from several threads.
+//
+
+// bytes of the temporary file mapped at one time
+const size_t spillSegmentBytes = 64 << 20;
+
+// chunks may take this much of the heap (bytes), 0 for no limit; those
+// over it are spilled to a file in the folder, empty for the temporary
+// folder of the system
+void setSpillBudget(double bytes, const std::string &folder = std::string());
+// get the spill budget and its folder
+void getSpillBudget(double &bytes, std::string &folder);
+// spilling or not
+bool isSpilling();
+
+// get room for a chunk, throw std::bad_alloc when neither the heap nor
+// the file can hold it
+void *allocChunk(size_t bytes);
+// free room of a chunk
+void freeChunk(void *chunk, size_t bytes);
+
+// bytes of chunks in the heap & in the file
+void getChunkUse(double &heap, double &spilled);
+// whether a chunk is in the file
+bool isChunkSpilled(const void *chunk);
+
+#endif	// #ifndef __ICHUNKSTORE_H__
@@ -0,0 +1,137 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __ICHUNKVECTOR_H__
+#define __ICHUNKVECTOR_H__
+
+#include <cstddef>
+#include <algorithm>
+#include <new>
+#include <vector>
+
+#include "ichunkstore.h"
+
+// elements per chunk, as a power of two
+const unsigned int chunkShift = 12;
+const size_t chunkSize = static_cast<size_t>(1) << chunkShift;
+
+///////////////////////////////////////////////////////////////////////////////
+// class for sequences stored in fixed-size chunks
+//
+// Behaves like the part of std::vector the motion of joints needs, but grows
+// by adding chunks, so that elements never move and a long take is never
+// copied as a whole to make room for more frames. Each chunk is contiguous,
+// for the stages working on runs of elements. Chunks come from the chunk
+// store, so they may live in a spill file rather than in the heap.
+//
+template <class T>
+class iChunkVector {
+public:
+	typedef T value_type;
+
+	// constructor
+	iChunkVector() : count(0) {}
+	iChunkVector(const iChunkVector &other) : count(0) { assign(other); }
+	// destructor
+	~iChunkVector() { release(); }
+	iChunkVector &operator=(const iChunkVector &other) {
+		if (this != &other) assign(other);
+		return *this;
+	}
+
+	// quantity of elements & room for them
+	size_t size() const { return count; }
+	size_t capacity() const { return chunks.size() << chunkShift; }
+	bool empty() const { return 0 == count; }
+
+	// elements are accessible through operator[]
+	T &operator[](size_t idx) { return chunks[idx >> chunkShift][idx & (chunkSize - 1)]; }
+	const T &operator[](size_t idx) const { return chunks[idx >> chunkShift][idx & (chunkSize - 1)]; }
+	T &back() { return (*this)[count - 1]; }
+	const T &back() const { return (*this)[count - 1]; }
+
+	// make room for n elements at least, chunks in use stay where they are
+	void reserve(size_t n) {
+		if (n <= capacity()) return;
+		chunks.reserve((n + chunkSize - 1) >> chunkShift);
+		while (capacity() < n) chunks.push_back(newChunk());
+	}
+	// append an element
+	void push_back(const T &value) {
+		if (count == capacity()) chunks.push_back(newChunk());
+		(*this)[count++] = value;
+	}
+	// change the quantity of elements, new ones are default values; fresh
+	// chunks come constructed so only the room kept by clear() is reset
+	void resize(size_t n) {
+		const size_t kept = std::min(n, capacity());
+		for (size_t i = count; i < kept; ++i) (*this)[i] = T();
+		reserve(n);
+		count = n;
+	}
+	// change the quantity of elements, new ones are copies of the value
+	void resize(size_t n, const T &value) {
+		reserve(n);
+		for (size_t i = count; i < n; ++i) (*this)[i] = value;
+		count = n;
+	}
+	// remove all elements but keep the chunks
+	void clear() { count = 0; }
+	// remove all elements and free the chunks
+	void release() {
+		for (size_t c = 0; c < chunks.size(); ++c) deleteChunk(chunks[c]);
+		std::vector<T *>().swap(chunks);
+		count = 0;
+	}
+	// exchange contents without copying elements
+	void swap(iChunkVector &other) {
+		chunks.swap(other.chunks);
+		std::swap(count, other.count);
+	}
+
+	// chunks, each one holds chunkSize elements
+	size_t countChunks() const { return chunks.size(); }
+	T *getChunk(size_t c) { return chunks[c]; }
+	const T *getChunk(size_t c) const { return chunks[c]; }
+
+private:
+	std::vector<T *> chunks;
+	size_t count;
+
+	// get/free a chunk of constructed elements
+	static T *newChunk() {
+		T *chunk = static_cast<T *>(allocChunk(chunkSize * sizeof(T)));
+		for (size_t i = 0; i < chunkSize; ++i) new (chunk + i) T();
+		return chunk;
+	}
+	static void deleteChunk(T *chunk) {
+		for (size_t i = 0; i < chunkSize; ++i) chunk[i].~T();
+		freeChunk(chunk, chunkSize * sizeof(T));
+	}
+
+	// copy the elements of another one
+	void assign(const iChunkVector &other) {
+		clear();
+		reserve(other.count);
+		for (size_t c = 0; c * chunkSize < other.count; ++c) {
+			const size_t n = std::min(chunkSize, other.count - c * chunkSize);
+			std::copy(other.chunks[c], other.chunks[c] + n, chunks[c]);
+		}
+		count = other.count;
+	}
+};
+
+#endif	// #ifndef __ICHUNKVECTOR_H__
@@ -0,0 +1,234 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+
+#include "idebug.h"
+#include "irotation.h"
+#include "iclipsampler.h"
+
+using namespace std;
+using namespace imath;
+
+// below it slerp becomes plain lerp
+const double slerpThreshold = 1.0e-6;
+
+//-----------------------------------------------------------------------------
+// slerp weights of a segment spanning theta
+//-----------------------------------------------------------------------------
+static inline void slerpWeights(double theta, double invSin, double u, double &w0, double &w1)
+{
+	const bool tiny = (theta < slerpThreshold);
+	w0 = tiny ? (1.0 - u) : (sin((1.0 - u) * theta) * invSin);
+	w1 = tiny ? u : (sin(u * theta) * invSin);
+}
+
+//-----------------------------------------------------------------------------
+// prepare
+//-----------------------------------------------------------------------------
+int iClipSampler::prepare(iSkeleton &skel)
+{
+	if (skel.empty()) return MC_INVALID_SKELETON;
+
+	joints = skel.countJoints();
+	frames = skel.getFrames();
+	frameTime = skel.getFrameTime();
+	cursor = noCursor;
+	tracks.resize(joints);
+	vector<double> r(chunkSize * 3);
+	double *rx = &r[0], *ry = &r[chunkSize], *rz = &r[chunkSize * 2];
+
+	for (unsigned int j = 0; j < joints; ++j) {
+		iSkeleton::iJoint *jot = skel.getNode(j).joint;
+		iTrack &trk = tracks[j];
+		iFrameCount n = jot->motion.size();
+		if (n > frames) n = frames;
+		trk.order = skel.getRotOrder(jot);
+		trk.count = n;
+		trk.theta = 0.0;
+		trk.invSin = 0.0;
+		unsigned int k;
+		iFrameCount i;
+		for (k = 0; k < 4; ++k) trk.q[k].resize(n);
+		for (k = 0; k < 3; ++k) trk.t[k].resize(n);
+		trk.s.resize(n);
+		if (0 == n) continue;
+
+		// split frames by components, a chunk at a time
+		for (iFrameCount first = 0; first < n; first += chunkSize) {
+			const size_t c = static_cast<size_t>(first >> chunkShift);
+			const unsigned int m = static_cast<unsigned int>((n - first < chunkSize) ? n - first : chunkSize);
+			for (i = 0; i < m; ++i) {
+				const iSkeleton::iFrame &fm = jot->motion[first + i];
+				rx[i] = fm.rotation.x; ry[i] = fm.rotation.y; rz[i] = fm.rotation.z;
+				trk.t[0][first + i] = fm.offset.x;
+				trk.t[1][first + i] = fm.offset.y;
+				trk.t[2][first + i] = fm.offset.z;
+				trk.s[first + i] = fm.scale;
+			}
+			eulerToQuaternion(trk.order, m, rx, ry, rz,
+				trk.q[0].getChunk(c), trk.q[1].getChunk(c), trk.q[2].getChunk(c), trk.q[3].getChunk(c));
+		}
+
+		// neighbours on the same hemisphere, so that slerps take the short way
+		for (i = 1; i < n; ++i) {
+			const double d = trk.q[0][i] * trk.q[0][i - 1] + trk.q[1][i] * trk.q[1][i - 1] +
+				trk.q[2][i] * trk.q[2][i - 1] + trk.q[3][i] * trk.q[3][i - 1];
+			if (d < 0.0) {
+				for (k = 0; k < 4; ++k) trk.q[k][i] = -trk.q[k][i];
+			}
+		}
+	}
+	ILOG1 ("Sampler prepared with " << joints << " joints x " << frames << " frames");
+
+	return MC_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// locate
+//-----------------------------------------------------------------------------
+void iClipSampler::locate(double time, iFrameCount &idx, double &u) const
+{
+	const double f = (frameTime > 0.0) ? (time / frameTime) : 0.0;
+	if (f <= 0.0 || frames < 2) {
+		idx = 0;
+		u = 0.0;
+	} else if (f >= static_cast<double>(frames - 1)) {
+		idx = frames - 2;
+		u = 1.0;
+	} else {
+		idx = static_cast<iFrameCount>(f);
+		u = f - static_cast<double>(idx);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// sample
+//-----------------------------------------------------------------------------
+void iClipSampler::sample(double time, vector<iSkeleton::iFrame> &pose)
+{
+	pose.resize(joints);
+	iFrameCount idx;
+	double u;
+	locate(time, idx, u);
+
+	// slerps of a segment are kept until the cursor moves
+	const bool moved = (idx != cursor);
+	cursor = idx;
+
+	for (unsigned int j = 0; j < joints; ++j) {
+		iTrack &trk = tracks[j];
+		iSkeleton::iFrame &fm = pose[j];
+		if (0 == trk.count) {
+			fm = iSkeleton::iFrame();
+			continue;
+		}
+		const size_t i0 = static_cast<size_t>((idx < trk.count) ? idx : trk.count - 1);
+		const size_t i1 = static_cast<size_t>((idx + 1 < trk.count) ? idx + 1 : trk.count - 1);
+
+		if (moved) {
+			double d = trk.q[0][i0] * trk.q[0][i1] + trk.q[1][i0] * trk.q[1][i1] +
+				trk.q[2][i0] * trk.q[2][i1] + trk.q[3][i0] * trk.q[3][i1];
+			if (d > 1.0) d = 1.0;
+			trk.theta = acos(d);
+			trk.invSin = (trk.theta < slerpThreshold) ? 0.0 : 1.0 / sin(trk.theta);
+		}
+
+		double w0, w1;
+		slerpWeights(trk.theta, trk.invSin, u, w0, w1);
+		double q[4];
+		for (unsigned int k = 0; k < 4; ++k) {
+			q[k] = trk.q[k][i0] * w0 + trk.q[k][i1] * w1;
+		}
+		double r[3];
+		quaternionToEuler(trk.order, 1, &q[0], &q[1], &q[2], &q[3], &r[0], &r[1], &r[2]);
+		fm.rotation.set(r[0], r[1], r[2]);
+
+		fm.offset.x = trk.t[0][i0] + (trk.t[0][i1] - trk.t[0][i0]) * u;
+		fm.offset.y = trk.t[1][i0] + (trk.t[1][i1] - trk.t[1][i0]) * u;
+		fm.offset.z = trk.t[2][i0] + (trk.t[2][i1] - trk.t[2][i0]) * u;
+		fm.scale = trk.s[i0] + (trk.s[i1] - trk.s[i0]) * u;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// sampleMany
+//-----------------------------------------------------------------------------
+void iClipSampler::sampleMany(const double *times, unsigned int count, vector<iSkeleton::iFrame> &poses)
+{
+	poses.resize(static_cast<size_t>(joints) * count);
+	if (0 == count) return;
+
+	for (unsigned int j = 0; j < joints; ++j) {
+		sampleJoint(j, times, count, &poses[static_cast<size_t>(j) * count]);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// sampleJoint
+//-----------------------------------------------------------------------------
+void iClipSampler::sampleJoint(unsigned int joint, const double *times, unsigned int count,
+	iSkeleton::iFrame *out) const
+{
+	if (joint >= joints || 0 == count) return;
+	const iTrack &trk = tracks[joint];
+	unsigned int i, k;
+	if (0 == trk.count) {
+		for (i = 0; i < count; ++i) out[i] = iSkeleton::iFrame();
+		return;
+	}
+	const iFrameCount last = trk.count - 1;
+
+	// segments & fractions, then every step by components over all times
+	//
+	vector<iFrameCount> base(count);
+	vector<double> buf(count * 8);
+	double *q[4] = {&buf[0], &buf[count], &buf[count * 2], &buf[count * 3]};
+	double *r[3] = {&buf[count * 4], &buf[count * 5], &buf[count * 6]};
+	double *frac = &buf[count * 7];
+	for (i = 0; i < count; ++i) {
+		locate(times[i], base[i], frac[i]);
+		base[i] = (base[i] < last) ? base[i] : last;
+	}
+
+	// slerp
+	for (i = 0; i < count; ++i) {
+		const size_t i0 = static_cast<size_t>(base[i]);
+		const size_t i1 = static_cast<size_t>((i0 < last) ? i0 + 1 : last);
+		double d = trk.q[0][i0] * trk.q[0][i1] + trk.q[1][i0] * trk.q[1][i1] +
+			trk.q[2][i0] * trk.q[2][i1] + trk.q[3][i0] * trk.q[3][i1];
+		d = (d > 1.0) ? 1.0 : d;
+		const double theta = acos(d);
+		const double invSin = (theta < slerpThreshold) ? 0.0 : 1.0 / sin(theta);
+		double w0, w1;
+		slerpWeights(theta, invSin, frac[i], w0, w1);
+		for (k = 0; k < 4; ++k) q[k][i] = trk.q[k][i0] * w0 + trk.q[k][i1] * w1;
+	}
+	quaternionToEuler(trk.order, count, q[0], q[1], q[2], q[3], r[0], r[1], r[2]);
+
+	// lerp
+	for (i = 0; i < count; ++i) {
+		const size_t i0 = static_cast<size_t>(base[i]);
+		const size_t i1 = static_cast<size_t>((i0 < last) ? i0 + 1 : last);
+		const double u = frac[i];
+		iSkeleton::iFrame &fm = out[i];
+		fm.rotation.set(r[0][i], r[1][i], r[2][i]);
+		fm.offset.x = trk.t[0][i0] + (trk.t[0][i1] - trk.t[0][i0]) * u;
+		fm.offset.y = trk.t[1][i0] + (trk.t[1][i1] - trk.t[1][i0]) * u;
+		fm.offset.z = trk.t[2][i0] + (trk.t[2][i1] - trk.t[2][i0]) * u;
+		fm.scale = trk.s[i0] + (trk.s[i1] - trk.s[i0]) * u;
+	}
+}
@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __ICLIPSAMPLER_H__
+#define __ICLIPSAMPLER_H__
+
+#include <vector>
+
+#include "iskeleton.h"
+
+// cursor of a sampler which has cached no segment
+const iFrameCount noCursor = ~static_cast<iFrameCount>(0);
+
+///////////////////////////////////////////////////////////////////////////////
+// class for sampling poses of a skeleton at any time
+//
+// Offsets and scales are interpolated linearly, rotations are slerped
+// through quaternions and given back as Euler angles in the orders of the
+// joints. A pose has one frame for every joint in pre-order. Times are in
+// seconds from the first frame, clamped to the clip.
+//
+class iClipSampler {
+public:
+	// constructor
+	iClipSampler() : joints(0), frames(0), frameTime(0.0), cursor(noCursor) {}
+
+	// take the motion of a skeleton (copied, the skeleton may change later)
+	int prepare(iSkeleton &skel);
+
+	// get parameters
+	unsigned int getJoints() { return joints; }
+	iFrameCount getFrames() { return frames; }
+	double getFrameTime() { return frameTime; }
+	double getDuration() { return (frames > 1) ? static_cast<double>(frames - 1) * frameTime : 0.0; }
+
+	// pose at a time, cheapest when times go forward a frame or less a call
+	void sample(double time, std::vector<iSkeleton::iFrame> &pose);
+	// poses at many times, frames of joint j are pose[j * count ... ]
+	void sampleMany(const double *times, unsigned int count, std::vector<iSkeleton::iFrame> &poses);
+	// frames of one joint at many times, safe to call from several threads
+	void sampleJoint(unsigned int joint, const double *times, unsigned int count,
+		iSkeleton::iFrame *out) const;
+
+private:
+	//////////////////////////////////////
+	// inner struct for motion of a joint, by components
+	//
+	struct iTrack {
+		int order;
+		iFrameCount count;				// frames of the joint
+		iChunkVector<double> q[4];		// rotations (x, y, z, w)
+		iChunkVector<double> t[3];		// offsets
+		iChunkVector<double> s;			// scales
+		// slerp of the segment at cursor
+		double theta;
+		double invSin;
+	};
+	//
+	//////////////////////////////////////
+
+	unsigned int joints;
+	iFrameCount frames;
+	double frameTime;
+	iFrameCount cursor;				// segment whose slerps are cached, noCursor for none
+	std::vector<iTrack> tracks;
+
+	// locate a time, frame index and fraction
+	void locate(double time, iFrameCount &idx, double &u) const;
+};
+
+#endif	// #ifndef __ICLIPSAMPLER_H__
@@ -0,0 +1,286 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "idebug.h"
+#include "imocapdata.h"
+#include "iclipstream.h"
+
+using namespace std;
+using namespace imath;
+
+// magic number and version of clip files
+static const char clipMagic[4] = { 'I', 'M', 'C', 'P' };
+static const unsigned int clipVersion = 1;
+
+//-----------------------------------------------------------------------------
+// make a path for a clip
+//
+// Clips of earlier imports may still be read by their stream nodes, so an
+// existing file is never taken, a number is appended instead.
+//-----------------------------------------------------------------------------
+string iClipStream::makePath(const string &folder, const string &name)
+{
+	string base(folder);
+	if (!base.empty() && base[base.size() - 1] != '/' && base[base.size() - 1] != '\\') {
+		base += '/';
+	}
+	base += name;
+
+	string path(base + ".imc");
+	for (unsigned int i = 1; ; ++i) {
+		ifstream probe(path.c_str(), ios::in | ios::binary);
+		if (!probe.is_open()) break;
+		char suffix[32];
+		sprintf(suffix, "_%u.imc", i);
+		path = base + suffix;
+	}
+	return path;
+}
+
+//-----------------------------------------------------------------------------
+// save motion of a skeleton as a clip
+//-----------------------------------------------------------------------------
+int iClipStream::save(const string &path, iSkeleton &skel,
+	iFrameCount first, iFrameCount last, double interval, float scale)
+{
+	if (skel.empty()) {
+		ILOG4 ("Error: Skeleton is empty");
+		return MC_INVALID_SKELETON;
+	}
+	if (last < first) last = first;
+	if (last - first > ~0U) {
+		ILOG4 ("Error: " << last - first << " frames are more than a clip holds");
+		return MC_ILLEAGAL_DATA;
+	}
+
+	ofstream output(path.c_str(), ios::out | ios::binary | ios::trunc);
+	if (!output) {
+		ILOG4 ("Error: Cannot create clip file " << path);
+		return MC_INVALID_STREAM;
+	}
+
+	// header
+	const unsigned int count = skel.countJoints();
+	const unsigned int length = static_cast<unsigned int>(last - first);
+	output.write(clipMagic, sizeof(clipMagic));
+	output.write(reinterpret_cast<const char *>(&clipVersion), sizeof(clipVersion));
+	output.write(reinterpret_cast<const char *>(&count), sizeof(count));
+	output.write(reinterpret_cast<const char *>(&length), sizeof(length));
+	output.write(reinterpret_cast<const char *>(&interval), sizeof(interval));
+
+	// joint flags, not only root has translations in HTR files
+	unsigned int j;
+	for (j = 0; j < count; ++j) {
+		unsigned int flag = 0;
+		if (j == 0 || skel.getHaveTranslation()) flag |= MC_CF_TRANSLATION;
+		output.write(reinterpret_cast<const char *>(&flag), sizeof(flag));
+	}
+
+	// frames
+	vector<float> buffer(count * clipChannels);
+	for (iFrameCount i = first; i < last; ++i) {
+		float *value = &buffer[0];
+		for (j = 0; j < count; ++j, value += clipChannels) {
+			iSkeleton::iJoint *joint = skel.getNode(j).joint;
+			iVec ofs, rot;
+			joint->getOffset(ofs);
+			if (i < joint->motion.size()) {
+				const iSkeleton::iFrame &fm = joint->motion[i];
+				ofs += iVec(fm.offset);
+				rot = iVec(fm.rotation);
+			}
+			ofs *= scale;
+			value[0] = static_cast<float>(ofs.x);
+			value[1] = static_cast<float>(ofs.y);
+			value[2] = static_cast<float>(ofs.z);
+			value[3] = static_cast<float>(rot.x);
+			value[4] = static_cast<float>(rot.y);
+			value[5] = static_cast<float>(rot.z);
+		}
+		output.write(reinterpret_cast<const char *>(&buffer[0]),
+			static_cast<streamsize>(buffer.size() * sizeof(float)));
+	}
+
+	if (!output) {
+		ILOG4 ("Error: Cannot write clip file " << path);
+		return MC_INVALID_STREAM;
+	}
+	ILOG2 ("Clip saved: " << count << " joints, " << length << " frames");
+	return MC_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// open a clip
+//-----------------------------------------------------------------------------
+int iClipStream::open(const string &path)
+{
+	close();
+
+	input.open(path.c_str(), ios::in | ios::binary);
+	if (!input) {
+		ILOG4 ("Error: Cannot open clip file " << path);
+		return MC_INVALID_STREAM;
+	}
+
+	char magic[4];
+	unsigned int version = 0;
+	input.read(magic, sizeof(magic));
+	input.read(reinterpret_cast<char *>(&version), sizeof(version));
+	input.read(reinterpret_cast<char *>(&joints), sizeof(joints));
+	input.read(reinterpret_cast<char *>(&frames), sizeof(frames));
+	input.read(reinterpret_cast<char *>(&frameTime), sizeof(frameTime));
+	if (!input || memcmp(magic, clipMagic, sizeof(magic)) || version != clipVersion ||
+		joints == 0 || frameTime <= 0.0) {
+		ILOG4 ("Error: Illegal clip file " << path);
+		close();
+		return MC_ILLEAGAL_DATA;
+	}
+
+	// joints & frames are not limited but by the length of the file
+	const streamoff header = input.tellg();
+	input.seekg(0, ios::end);
+	const streamoff stored = static_cast<streamoff>(input.tellg()) - header;
+	const streamoff flagBytes = static_cast<streamoff>(joints) * sizeof(unsigned int);
+	const streamoff frameBytes = static_cast<streamoff>(joints) * clipChannels * sizeof(float);
+	if (!input || stored < flagBytes || (stored - flagBytes) / frameBytes < frames) {
+		ILOG4 ("Error: Truncated clip file " << path);
+		close();
+		return MC_ILLEAGAL_DATA;
+	}
+	input.seekg(header);
+
+	flags.resize(joints);
+	input.read(reinterpret_cast<char *>(&flags[0]),
+		static_cast<streamsize>(joints * sizeof(unsigned int)));
+	if (!input) {
+		ILOG4 ("Error: Illegal clip file " << path);
+		close();
+		return MC_ILLEAGAL_DATA;
+	}
+	dataOffset = input.tellg();
+
+	ILOG2 ("Clip opened: " << joints << " joints, " << frames << " frames");
+	return MC_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// close the clip
+//-----------------------------------------------------------------------------
+void iClipStream::close()
+{
+	if (input.is_open()) input.close();
+	input.clear();
+	joints = frames = 0;
+	frameTime = 0.0;
+	flags.clear();
+	for (unsigned int i = 0; i < clipCacheBlocks; ++i) {
+		cache[i].count = 0;
+		cache[i].data.clear();
+	}
+	stamp = 0;
+}
+
+//-----------------------------------------------------------------------------
+// load a block into the cache
+//-----------------------------------------------------------------------------
+iClipStream::iBlock *iClipStream::fetchBlock(unsigned int idx)
+{
+	const unsigned int first = idx - idx % clipBlockFrames;
+	iBlock *victim = &cache[0];
+	++stamp;
+
+	// hit ?
+	for (unsigned int i = 0; i < clipCacheBlocks; ++i) {
+		iBlock *block = &cache[i];
+		if (block->count != 0 && block->first == first) {
+			block->stamp = stamp;
+			return block;
+		}
+		if (block->stamp < victim->stamp) victim = block;
+	}
+
+	// miss, replace the least recently used one
+	const unsigned int stride = joints * clipChannels;
+	unsigned int count = frames - first;
+	if (count > clipBlockFrames) count = clipBlockFrames;
+
+	victim->data.resize(clipBlockFrames * stride);
+	input.clear();
+	input.seekg(dataOffset + static_cast<streamoff>(first) * stride * sizeof(float));
+	input.read(reinterpret_cast<char *>(&victim->data[0]),
+		static_cast<streamsize>(count * stride * sizeof(float)));
+	if (!input) {
+		ILOG4 ("Error: Cannot read frames from " << first);
+		victim->count = 0;
+		return NULL;
+	}
+	victim->first = first;
+	victim->count = count;
+	victim->stamp = stamp;
+	ILOG0 ("Block loaded @ " << first);
+	return victim;
+}
+
+//-----------------------------------------------------------------------------
+// get a frame
+//-----------------------------------------------------------------------------
+const float *iClipStream::getFrame(unsigned int idx)
+{
+	if (!isOpen() || idx >= frames) return NULL;
+	iBlock *block = fetchBlock(idx);
+	if (NULL == block) return NULL;
+	return &block->data[(idx - block->first) * joints * clipChannels];
+}
+
+//-----------------------------------------------------------------------------
+// evaluate all channels at the time
+//-----------------------------------------------------------------------------
+int iClipStream::evaluate(double time, float *out)
+{
+	if (!isOpen() || frames == 0) return MC_INVALID_STREAM;
+
+	// hold the first and the last frame outside of the clip
+	double position = time / frameTime;
+	if (position < 0.0) position = 0.0;
+	if (position > frames - 1) position = frames - 1;
+	const unsigned int idx = static_cast<unsigned int>(floor(position));
+	const float weight = static_cast<float>(position - idx);
+
+	const unsigned int count = joints * clipChannels;
+	const float *f0 = getFrame(idx);
+	if (NULL == f0) return MC_ILLEAGAL_DATA;
+	memcpy(out, f0, count * sizeof(float));
+	if (weight == 0.0F || idx + 1 >= frames) return MC_SUCCESS;
+
+	// f0 may be dropped from the cache by fetching f1
+	const float *f1 = getFrame(idx + 1);
+	if (NULL == f1) return MC_ILLEAGAL_DATA;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		float delta = f1[i] - out[i];
+		if (i % clipChannels >= 3) {
+			// rotations turn the short way round
+			if (delta > 180.0F) delta -= 360.0F;
+			else if (delta < -180.0F) delta += 360.0F;
+		}
+		out[i] += delta * weight;
+	}
+	return MC_SUCCESS;
+}
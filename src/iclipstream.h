@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __ICLIPSTREAM_H__
+#define __ICLIPSTREAM_H__
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "iskeleton.h"
+
+// channels of a joint in a clip (translateXYZ, rotateXYZ)
+const unsigned int clipChannels = Channel::MC_CH_COUNT;
+// frames per cached block
+const unsigned int clipBlockFrames = 64;
+// cached blocks per clip
+const unsigned int clipCacheBlocks = 4;
+
+///////////////////////////////////////////////////////////////////////////////
+// class for binary motion clips
+//
+// A clip stores the final channel values of every joint (in pre-order of
+// the skeleton), one frame after another, so that a single frame can be
+// fetched with one seek. Nothing here depends on Maya.
+//
+class iClipStream {
+public:
+	// joint flags
+	enum MC_CLIP_FLAG {
+		MC_CF_TRANSLATION = 0x01	// translation channels are animated
+	};
+
+	// constructor
+	iClipStream() : joints(0), frames(0), frameTime(0.0), dataOffset(0), stamp(0) {}
+	// destructor
+	~iClipStream() { close(); }
+
+	// a path in the folder for a clip of the name, which no file takes yet
+	static std::string makePath(const std::string &folder, const std::string &name);
+	// save motion of a skeleton as a clip, frames [first, last) which
+	// the 32-bit count of the header holds
+	static int save(const std::string &path, iSkeleton &skel,
+		iFrameCount first, iFrameCount last, double interval, float scale);
+
+	// open/close a clip
+	int open(const std::string &path);
+	void close();
+	bool isOpen() { return input.is_open(); }
+
+	// get parameters
+	unsigned int getJoints() { return joints; }
+	unsigned int getFrames() { return frames; }
+	double getFrameTime() { return frameTime; }
+	bool isTranslated(unsigned int joint) {
+		return (joint < joints) && (flags[joint] & MC_CF_TRANSLATION);
+	}
+
+	// get a frame (joints * clipChannels values), NULL if unavailable
+	const float *getFrame(unsigned int idx);
+	// evaluate all channels at the time (seconds from the first frame)
+	int evaluate(double time, float *out);
+
+private:
+	//////////////////////////////////////
+	// inner struct for cached blocks
+	//
+	struct iBlock {
+		unsigned int first;		// first frame in the block
+		unsigned int count;		// quantity of frames
+		unsigned int stamp;		// time of last access
+		std::vector<float> data;
+		iBlock() : first(0), count(0), stamp(0) {}
+	};
+	//
+	//////////////////////////////////////
+
+	std::ifstream input;
+	unsigned int joints;
+	unsigned int frames;
+	double frameTime;
+	std::vector<unsigned int> flags;
+	std::streamoff dataOffset;
+
+	// cache of recently sampled frames
+	iBlock cache[clipCacheBlocks];
+	unsigned int stamp;
+
+	// load a block into the cache
+	iBlock *fetchBlock(unsigned int idx);
+};
+
+#endif	// #ifndef __ICLIPSTREAM_H__
@@ -19,7 +19,9 @@
 
 #include <sstream>
 #include <cctype>	// for toupper
+#include <cstdlib>	// for strtod
 #include <string>
+#include <vector>
 #include <algorithm>
 
 const std::string spaceCharacters(" \t\r\n");
@@ -39,6 +41,18 @@ inline T fromString(const std::string &s, std::ios_base &(*f)(std::ios_base&) =
 	return t;
 }
 
+// numbers with fractions are read without any stream, so that no memory is
+// allocated for every value of a frame
+template<>
+inline double fromString<double>(const std::string &s, std::ios_base &(*)(std::ios_base&)) {
+	return strtod(s.c_str(), NULL);
+}
+
+template<>
+inline float fromString<float>(const std::string &s, std::ios_base &(*)(std::ios_base&)) {
+	return static_cast<float>(strtod(s.c_str(), NULL));
+}
+
 template<typename T>
 inline std::string toString(const T &t, std::ios_base &(*f)(std::ios_base&) = std::dec) {
 	ostringstream os;
@@ -84,6 +98,40 @@ inline void tokenizeString(const std::string &s, std::vector<std::string> &words
 	}
 }
 
+// in-place versions of the above, which keep the storage of strings
+inline void trimInPlace(std::string &s, const std::string &t = spaceCharacters) {
+	const std::string::size_type i(s.find_last_not_of(t));
+	if (i == std::string::npos) {
+		s.erase();
+		return;
+	}
+	s.erase(i + 1);
+	s.erase(0, s.find_first_not_of(t));
+}
+
+inline void uncommentInPlace(std::string &s, const std::string &t = commentCharacters) {
+	const std::string::size_type i(s.find_first_of(t));
+	if (i != std::string::npos) {
+		s.erase(i);
+		trimInPlace(s);
+	}
+}
+
+// words are assigned to the strings already in the vector, which is never
+// shrunk, return the quantity of words
+inline unsigned int tokenizeInto(const std::string &s, std::vector<std::string> &words, const std::string &t = spaceCharacters) {
+	unsigned int count = 0;
+	std::string::size_type lastPos = s.find_first_not_of(t);
+	while (std::string::npos != lastPos) {
+		std::string::size_type pos = s.find_first_of(t, lastPos);
+		if (std::string::npos == pos) pos = s.size();
+		if (count == words.size()) words.push_back(std::string());
+		words[count++].assign(s, lastPos, pos - lastPos);
+		lastPos = s.find_first_not_of(t, pos);
+	}
+	return count;
+}
+
 inline std::string uncommentString(const std::string &s, const std::string &t = commentCharacters) {
 	std::string d(s);
 	std::string::size_type i(d.find_first_of(t));
@@ -101,4 +149,15 @@ inline int compareNoncase(const std::string &s1, const std::string &s2) {
 	return d1.compare(d2);
 }
 
+inline int compareNoncase(const std::string &s1, const char *s2) {
+	std::string::size_type i = 0;
+	for (; i < s1.size() && '\0' != s2[i]; ++i) {
+		const int c1 = toupper(static_cast<unsigned char>(s1[i]));
+		const int c2 = toupper(static_cast<unsigned char>(s2[i]));
+		if (c1 != c2) return (c1 < c2) ? -1 : 1;
+	}
+	if (i < s1.size()) return 1;
+	return ('\0' != s2[i]) ? -1 : 0;
+}
+
 #endif	// #ifndef __ICONVERTER_H__
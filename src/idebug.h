@@ -19,16 +19,18 @@
 
 #ifdef __cplusplus
 
-#ifndef _DEBUG
+#include "itrace.h"
 
+#ifndef _DEBUG
 
+// messages go to the trace while it is recording (see itrace.h)
 #	define IASSERT(x)
-#	define ILOG(x)
-#	define ILOG0 ILOG
-#	define ILOG1 ILOG
-#	define ILOG2 ILOG
-#	define ILOG3 ILOG
-#	define ILOG4 ILOG
+#	define ILOG ITRACE_LOG1
+#	define ILOG0 ITRACE_LOG0
+#	define ILOG1 ITRACE_LOG1
+#	define ILOG2 ITRACE_LOG2
+#	define ILOG3 ITRACE_LOG3
+#	define ILOG4 ITRACE_LOG4
 
 
 #else	// else of _DEBUG
@@ -50,7 +52,7 @@
 // for other os
 #	define REQUIRE_IOSTREAM
 #	include <maya/MIOStream.h>
-#	define ILOG(X) { std::clog << "LOG -> " << __FUNCTION__ << "() = \t" << x << std::endl; }
+#	define ILOG(x) { std::clog << "LOG -> " << __FUNCTION__ << "() = \t" << x << std::endl; }
 
 #endif
 
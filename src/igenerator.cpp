@@ -0,0 +1,387 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "iskeleton.h"
+#include "igenerator.h"
+
+using namespace std;
+
+// joints in a spine
+static const unsigned int spineJoints = 4;
+// length of bones (cm)
+static const double boneLength = 10.0;
+
+//////////////////////////////////////
+// deterministic random numbers
+//
+class iRandom {
+	unsigned long state;
+public:
+	explicit iRandom(unsigned int seed) : state(seed * 2654435761UL + 1) {}
+	// uniform in [lo, hi)
+	double next(double lo, double hi) {
+		state = (state * 1103515245UL + 12345UL) & 0x7fffffffUL;
+		return lo + (hi - lo) * (state / 2147483648.0);
+	}
+};
+//
+//////////////////////////////////////
+
+//////////////////////////////////////
+// a channel over frames
+//
+struct iWave {
+	double base, amplitude, frequency, phase;
+	double at(unsigned int frame, double frameTime) const {
+		return base + amplitude * sin(phase + frequency * frame * frameTime);
+	}
+};
+//
+//////////////////////////////////////
+
+//////////////////////////////////////
+// writer of separated values
+//
+class iWriter {
+	ostream &out;
+	unsigned int spacing;
+	unsigned int column;
+public:
+	iWriter(ostream &os, unsigned int sp) : out(os), spacing(sp), column(0) {}
+	// a word, separated from the last one of the line
+	void word(const char *s) {
+		if (column > 0) {
+			switch (spacing) {
+			case iGeneratorParam::MC_GS_TABS: out << '\t'; break;
+			case iGeneratorParam::MC_GS_MIXED: out << ((column & 1) ? "  \t " : "\t  "); break;
+			default: out << ' '; break;
+			}
+		}
+		out << s;
+		++column;
+	}
+	void word(const string &s) { word(s.c_str()); }
+	void value(double v) {
+		char buf[32];
+		sprintf(buf, "%.4f", v);
+		word(buf);
+	}
+	void count(unsigned int n) {
+		char buf[16];
+		sprintf(buf, "%u", n);
+		word(buf);
+	}
+	// indent a new line
+	void indent(unsigned int depth) {
+		for (unsigned int i = 0; i < depth; ++i) {
+			out << ((iGeneratorParam::MC_GS_SPACES == spacing) ? "  " : "\t");
+		}
+	}
+	// end the line
+	void end() {
+		switch (spacing) {
+		case iGeneratorParam::MC_GS_CRLF: out << "\r\n"; break;
+		case iGeneratorParam::MC_GS_MIXED: out << " \t\r\n"; break;
+		default: out << '\n'; break;
+		}
+		column = 0;
+	}
+	void line(const char *s) { word(s); end(); }
+};
+//
+//////////////////////////////////////
+
+//////////////////////////////////////
+// synthetic skeleton
+//
+struct iGenJoint {
+	string name;
+	int parent;
+	vector<unsigned int> children;
+	double offset[3];
+	bool translated;
+	const char *order;			// BVH rotation channels
+	iWave waves[Channel::MC_CH_COUNT];
+};
+//
+//////////////////////////////////////
+
+static const char *const bvhOrders[] = {
+	"Zrotation Xrotation Yrotation", "Xrotation Yrotation Zrotation",
+	"Yrotation Zrotation Xrotation", "Zrotation Yrotation Xrotation"
+};
+
+//-----------------------------------------------------------------------------
+// build the skeleton
+//-----------------------------------------------------------------------------
+static void buildJoints(const iGeneratorParam &param, vector<iGenJoint> &joints)
+{
+	iRandom random(param.seed);
+	const unsigned int count = (param.joints > 0) ? param.joints : 1;
+	joints.resize(count);
+
+	for (unsigned int i = 0; i < count; ++i) {
+		iGenJoint &jot = joints[i];
+		char name[16];
+		sprintf(name, "J%04u", i);
+		jot.name = name;
+
+		// spines start at the root
+		jot.parent = (0 == i) ? -1 : ((1 == i % spineJoints) ? 0 : static_cast<int>(i) - 1);
+		if (jot.parent >= 0) joints[jot.parent].children.push_back(i);
+
+		jot.offset[0] = (0 == i) ? 0.0 : random.next(-2.0, 2.0);
+		jot.offset[1] = (0 == i) ? 90.0 : boneLength;
+		jot.offset[2] = (0 == i) ? 0.0 : random.next(-2.0, 2.0);
+		jot.translated = (0 == i) || (iGeneratorParam::MC_GL_FULL == param.layout);
+		jot.order = bvhOrders[(iGeneratorParam::MC_GL_ORDERS == param.layout) ? i % 4 : 0];
+
+		for (unsigned int c = 0; c < Channel::MC_CH_COUNT; ++c) {
+			iWave &w = jot.waves[c];
+			const bool rotation = (c >= Channel::MC_CH_RX);
+			w.base = rotation ? random.next(-20.0, 20.0) : ((0 == i) ? jot.offset[c] : 0.0);
+			w.amplitude = rotation ? random.next(5.0, 60.0) : ((0 == i) ? 50.0 : 0.5);
+			w.frequency = random.next(0.5, 6.0);
+			w.phase = random.next(0.0, 6.28318);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// write a BVH joint and its children
+//-----------------------------------------------------------------------------
+static void writeBvhJoint(iWriter &w, const vector<iGenJoint> &joints, unsigned int idx, unsigned int depth)
+{
+	const iGenJoint &jot = joints[idx];
+	w.indent(depth); w.word((0 == depth) ? "ROOT" : "JOINT"); w.word(jot.name); w.end();
+	w.indent(depth); w.line("{");
+	w.indent(depth + 1); w.word("OFFSET");
+	w.value(jot.offset[0]); w.value(jot.offset[1]); w.value(jot.offset[2]); w.end();
+	w.indent(depth + 1); w.word("CHANNELS");
+	if (jot.translated) {
+		w.count(6); w.word("Xposition Yposition Zposition");
+	} else {
+		w.count(3);
+	}
+	w.word(jot.order); w.end();
+
+	if (jot.children.empty()) {
+		w.indent(depth + 1); w.word("End"); w.word("Site"); w.end();
+		w.indent(depth + 1); w.line("{");
+		w.indent(depth + 2); w.word("OFFSET");
+		w.value(0.0); w.value(boneLength); w.value(0.0); w.end();
+		w.indent(depth + 1); w.line("}");
+	}
+	for (unsigned int i = 0; i < jot.children.size(); ++i) {
+		writeBvhJoint(w, joints, jot.children[i], depth + 1);
+	}
+	w.indent(depth); w.line("}");
+}
+
+//-----------------------------------------------------------------------------
+// write a BVH file
+//-----------------------------------------------------------------------------
+static void writeBvh(const iGeneratorParam &param, const vector<iGenJoint> &joints, iWriter &w)
+{
+	const double frameTime = 1.0 / param.frameRate;
+	w.line("HIERARCHY");
+	writeBvhJoint(w, joints, 0, 0);
+	w.line("MOTION");
+	w.word("Frames:"); w.count(param.frames); w.end();
+	w.word("Frame"); w.word("Time:"); w.value(frameTime); w.end();
+
+	// channels are in the order of the hierarchy
+	vector<unsigned int> order;
+	vector<unsigned int> stack(1, 0);
+	while (!stack.empty()) {
+		const unsigned int idx = stack.back();
+		stack.pop_back();
+		order.push_back(idx);
+		const vector<unsigned int> &children = joints[idx].children;
+		for (unsigned int i = static_cast<unsigned int>(children.size()); i > 0; --i) {
+			stack.push_back(children[i - 1]);
+		}
+	}
+
+	for (unsigned int f = 0; f < param.frames; ++f) {
+		for (unsigned int i = 0; i < order.size(); ++i) {
+			const iGenJoint &jot = joints[order[i]];
+			unsigned int c;
+			if (jot.translated) {
+				for (c = Channel::MC_CH_TX; c < Channel::MC_CH_RX; ++c) {
+					w.value(jot.waves[c].at(f, frameTime));
+				}
+			}
+			// rotation channels are written in the order of their names
+			for (const char *p = jot.order; *p; ++p) {
+				if (*p == 'X' || *p == 'Y' || *p == 'Z') {
+					c = Channel::MC_CH_RX + (*p - 'X');
+					w.value(jot.waves[c].at(f, frameTime));
+				}
+			}
+		}
+		w.end();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// write the header, hierarchy & base position of a HTR file
+//-----------------------------------------------------------------------------
+static void writeHtrHeader(const iGeneratorParam &param, const vector<iGenJoint> &joints,
+	unsigned int version, iWriter &w)
+{
+	w.line("[Header]");
+	w.word("FileType"); w.word("htr"); w.end();
+	w.word("DataType"); w.word("HTRS"); w.end();
+	w.word("FileVersion"); w.count(version); w.end();
+	w.word("NumSegments"); w.count(static_cast<unsigned int>(joints.size())); w.end();
+	w.word("NumFrames"); w.count(param.frames); w.end();
+	w.word("DataFrameRate"); w.count(param.frameRate); w.end();
+	w.word("EulerRotationOrder"); w.word("ZYX"); w.end();
+	w.word("CalibrationUnits"); w.word("cm"); w.end();
+	w.word("RotationUnits"); w.word("Degrees"); w.end();
+	w.word("GlobalAxisofGravity"); w.word("Y"); w.end();
+	w.word("BoneLengthAxis"); w.word("Y"); w.end();
+	w.word("ScaleFactor"); w.count(1); w.end();
+
+	unsigned int i;
+	w.line("[SegmentNames&Hierarchy]");
+	w.line("#CHILD PARENT");
+	for (i = 0; i < joints.size(); ++i) {
+		w.word(joints[i].name);
+		w.word((joints[i].parent < 0) ? string("GLOBAL") : joints[joints[i].parent].name);
+		w.end();
+	}
+
+	w.line("[BasePosition]");
+	w.line("#SegmentName Tx Ty Tz Rx Ry Rz BoneLength");
+	for (i = 0; i < joints.size(); ++i) {
+		w.word(joints[i].name);
+		for (unsigned int c = 0; c < 3; ++c) w.value(joints[i].offset[c]);
+		for (unsigned int c = 0; c < 3; ++c) w.value(0.0);
+		w.value(boneLength);
+		w.end();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// write a HTR file
+//-----------------------------------------------------------------------------
+static void writeHtr(const iGeneratorParam &param, const vector<iGenJoint> &joints, unsigned int version, iWriter &w)
+{
+	const double frameTime = 1.0 / param.frameRate;
+	writeHtrHeader(param, joints, version, w);
+
+	unsigned int c;
+	if (1 == version) {
+		// a section of frames for every joint
+		for (unsigned int i = 0; i < joints.size(); ++i) {
+			const iGenJoint &jot = joints[i];
+			w.line(("[" + jot.name + "]").c_str());
+			for (unsigned int f = 0; f < param.frames; ++f) {
+				w.count(f + 1);
+				for (c = 0; c < Channel::MC_CH_COUNT; ++c) {
+					w.value((c < Channel::MC_CH_RX && !jot.translated) ? 0.0 : jot.waves[c].at(f, frameTime));
+				}
+				w.value(1.0);
+				w.end();
+			}
+		}
+	} else {
+		// a section of joints for every frame
+		w.line("#Beginning of Data.");
+		for (unsigned int f = 0; f < param.frames; ++f) {
+			char title[24];
+			sprintf(title, "%u:", f + 1);
+			w.word("Frame"); w.word(title); w.end();
+			for (unsigned int i = 0; i < joints.size(); ++i) {
+				const iGenJoint &jot = joints[i];
+				sprintf(title, "%u:", i + 1);
+				w.word(title);
+				for (c = 0; c < Channel::MC_CH_COUNT; ++c) {
+					w.value((c < Channel::MC_CH_RX && !jot.translated) ? 0.0 : jot.waves[c].at(f, frameTime));
+				}
+				w.value(boneLength);
+				w.end();
+			}
+		}
+	}
+	w.line("[EndOfFile]");
+}
+
+//-----------------------------------------------------------------------------
+// parse names of enumerations
+//-----------------------------------------------------------------------------
+bool iGeneratorParam::setFormat(const string &name)
+{
+	if (name == "bvh") format = MC_GF_BVH;
+	else if (name == "htr" || name == "htr1") format = MC_GF_HTR1;
+	else if (name == "htr2") format = MC_GF_HTR2;
+	else return false;
+	return true;
+}
+
+bool iGeneratorParam::setLayout(const string &name)
+{
+	if (name == "root") layout = MC_GL_ROOT;
+	else if (name == "full") layout = MC_GL_FULL;
+	else if (name == "orders") layout = MC_GL_ORDERS;
+	else return false;
+	return true;
+}
+
+bool iGeneratorParam::setSpacing(const string &name)
+{
+	if (name == "spaces") spacing = MC_GS_SPACES;
+	else if (name == "tabs") spacing = MC_GS_TABS;
+	else if (name == "crlf") spacing = MC_GS_CRLF;
+	else if (name == "mixed") spacing = MC_GS_MIXED;
+	else return false;
+	return true;
+}
+
+const char *iGeneratorParam::getFormatName() const
+{
+	switch (format) {
+	case MC_GF_HTR1: return "htr";
+	case MC_GF_HTR2: return "htr2";
+	}
+	return "bvh";
+}
+
+//-----------------------------------------------------------------------------
+// generateMocap
+//-----------------------------------------------------------------------------
+int generateMocap(const iGeneratorParam &param, ostream &out)
+{
+	if (0 == param.frameRate) return MC_ILLEAGAL_DATA;
+
+	vector<iGenJoint> joints;
+	buildJoints(param, joints);
+
+	iWriter w(out, param.spacing);
+	switch (param.format) {
+	case iGeneratorParam::MC_GF_BVH: writeBvh(param, joints, w); break;
+	case iGeneratorParam::MC_GF_HTR1: writeHtr(param, joints, 1, w); break;
+	case iGeneratorParam::MC_GF_HTR2: writeHtr(param, joints, 2, w); break;
+	default: return MC_ILLEAGAL_DATA;
+	}
+	return out ? MC_SUCCESS : MC_INVALID_STREAM;
+}
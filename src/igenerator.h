@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __IGENERATOR_H__
+#define __IGENERATOR_H__
+
+#include <iostream>
+#include <string>
+
+///////////////////////////////////////////////////////////////////////////////
+// parameters of synthetic mocap files
+//
+struct iGeneratorParam {
+	// file formats
+	enum MC_GEN_FORMAT { MC_GF_BVH, MC_GF_HTR1, MC_GF_HTR2 };
+	// channels of joints (BVH only, HTR always has all of them)
+	enum MC_GEN_LAYOUT {
+		MC_GL_ROOT,			// root translated, joints rotated in one order
+		MC_GL_FULL,			// every joint translated & rotated
+		MC_GL_ORDERS		// root translated, rotation orders vary by joints
+	};
+	// white spaces between values
+	enum MC_GEN_SPACING {
+		MC_GS_SPACES,		// single spaces, LF
+		MC_GS_TABS,			// tabs, LF
+		MC_GS_CRLF,			// single spaces, CR LF
+		MC_GS_MIXED			// runs of spaces & tabs, trailing blanks, CR LF
+	};
+
+	unsigned int format;
+	unsigned int joints;
+	unsigned int frames;
+	unsigned int layout;
+	unsigned int spacing;
+	unsigned int frameRate;
+	unsigned int seed;			// same seed, same file
+
+	iGeneratorParam() : format(MC_GF_BVH), joints(24), frames(1000), layout(MC_GL_ROOT),
+		spacing(MC_GS_SPACES), frameRate(120), seed(1) {}
+
+	// parse names of enumerations, false if unknown
+	bool setFormat(const std::string &name);
+	bool setLayout(const std::string &name);
+	bool setSpacing(const std::string &name);
+	// name of the format
+	const char *getFormatName() const;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// generator of synthetic mocap files
+//
+// Joints form spines of four hanging off the root, every channel is a
+// sine wave whose amplitude, frequency and phase come from the seed, so
+// files are reproducible on every platform. Nothing here depends on Maya.
+//
+// write a file to the stream, return a MCDATA_RESULT value
+int generateMocap(const iGeneratorParam &param, std::ostream &out);
+
+#endif	// #ifndef __IGENERATOR_H__
@@ -0,0 +1,247 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+
+#include "idebug.h"
+#include "irotation.h"
+#include "iparallel.h"
+#include "ikinematics.h"
+
+using namespace std;
+using namespace imath;
+
+///////////////////////////////////////////////////////////////////////////////
+// job solving a block of frames
+//
+class iKinematicsTask : public iTask {
+	iKinematics &kine;
+public:
+	iKinematicsTask(iKinematics &solver) : kine(solver) {}
+	void run(unsigned int idx) {
+		const unsigned int begin = idx * kineBlockFrames;
+		unsigned int end = begin + kineBlockFrames;
+		if (end > kine.getFrames()) end = kine.getFrames();
+		kine.solveBlock(begin, end);
+	}
+};
+
+//-----------------------------------------------------------------------------
+// solve
+//-----------------------------------------------------------------------------
+int iKinematics::solve(iSkeleton &skel, unsigned int first, unsigned int last,
+	double scale, unsigned int threads)
+{
+	if (skel.empty()) return MC_INVALID_SKELETON;
+
+	if (last > skel.getFrames()) last = static_cast<unsigned int>(skel.getFrames());
+	if (first > last) first = last;
+
+	skeleton = &skel;
+	joints = skel.countJoints();
+	frames = last - first;
+	firstFrame = first;
+	proportion = scale;
+
+	// constant parts of joints
+	//
+	links.resize(joints);
+	for (unsigned int j = 0; j < joints; ++j) {
+		iSkeleton::iNode &node = skel.getNode(j);
+		iLink &link = links[j];
+		link.joint = node.joint;
+		link.parent = node.parent;
+		link.order = skel.getRotOrder(node.joint);
+		if (!Rotation::isOrderValid(link.order)) return MC_ILLEAGAL_DATA;
+		link.translated = (0 == node.depth) || skel.getHaveTranslation();
+		node.joint->getOffset(link.offset);
+
+		iVec base;
+		node.joint->getRotation(base);
+		eulerToQuaternion(link.order, 1, &base.x, &base.y, &base.z,
+			&link.orient[0], &link.orient[1], &link.orient[2], &link.orient[3]);
+	}
+
+	world.resize(joints * MC_KC_COUNT);
+	for (unsigned int c = 0; c < world.size(); ++c) world[c].resize(frames);
+
+	// blocks of frames are independent
+	//
+	const unsigned int blocks = (frames + kineBlockFrames - 1) / kineBlockFrames;
+	iKinematicsTask task(*this);
+	if (!parallelFor(blocks, task, threads)) return MC_CANCELLED;
+	ILOG1("Kinematics of " << joints << " joints x " << frames << " frames solved");
+
+	return MC_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// solveBlock
+//-----------------------------------------------------------------------------
+void iKinematics::solveBlock(unsigned int begin, unsigned int end)
+{
+	const unsigned int count = end - begin;
+	if (0 == count) return;
+
+	// scratch of the block: rotation, offset & scale of parent
+	double rx[kineBlockFrames], ry[kineBlockFrames], rz[kineBlockFrames];
+	double tx[kineBlockFrames], ty[kineBlockFrames], tz[kineBlockFrames];
+	double ps[kineBlockFrames];
+	double *c[MC_KC_COUNT];
+	unsigned int i;
+
+	for (unsigned int j = 0; j < joints; ++j) {
+		const iLink &link = links[j];
+		const iSkeleton::iMotion &motion = link.joint->motion;
+		for (unsigned int k = 0; k < MC_KC_COUNT; ++k) {
+			c[k] = &world[j * MC_KC_COUNT + k][begin];
+		}
+
+		// gather frames into the scratch by runs within chunks, missing
+		// frames stand still
+		//
+		const size_t f0 = firstFrame + begin;
+		const unsigned int stored = (f0 < motion.size()) ?
+			static_cast<unsigned int>(min<size_t>(count, motion.size() - f0)) : 0;
+		for (i = 0; i < stored; ) {
+			const iSkeleton::iFrame *fm = &motion[f0 + i];
+			const unsigned int run = min<unsigned int>(stored - i,
+				static_cast<unsigned int>(chunkSize - ((f0 + i) & (chunkSize - 1))));
+			for (const unsigned int e = i + run; i < e; ++i, ++fm) {
+				rx[i] = fm->rotation.x; ry[i] = fm->rotation.y; rz[i] = fm->rotation.z;
+				tx[i] = fm->offset.x; ty[i] = fm->offset.y; tz[i] = fm->offset.z;
+			}
+		}
+		for (i = stored; i < count; ++i) {
+			rx[i] = ry[i] = rz[i] = 0.0;
+			tx[i] = ty[i] = tz[i] = 0.0;
+		}
+		if (!link.translated) {
+			for (i = 0; i < count; ++i) tx[i] = ty[i] = tz[i] = 0.0;
+		}
+		if (link.parent >= 0) {
+			const iSkeleton::iMotion &pm = links[link.parent].joint->motion;
+			const unsigned int scaled = (f0 < pm.size()) ?
+				static_cast<unsigned int>(min<size_t>(count, pm.size() - f0)) : 0;
+			for (i = 0; i < scaled; ) {
+				const iSkeleton::iFrame *fm = &pm[f0 + i];
+				const unsigned int run = min<unsigned int>(scaled - i,
+					static_cast<unsigned int>(chunkSize - ((f0 + i) & (chunkSize - 1))));
+				for (const unsigned int e = i + run; i < e; ++i, ++fm) ps[i] = fm->scale;
+			}
+			for (i = scaled; i < count; ++i) ps[i] = 1.0;
+		}
+
+		// local rotation of the frame, then everything else in one pass:
+		// world rotation = parent * orient * local, world position =
+		// parent position + parent rotation of the stretched offset
+		//
+		double *qx = c[MC_KC_QX], *qy = c[MC_KC_QY], *qz = c[MC_KC_QZ], *qw = c[MC_KC_QW];
+		double *wx = c[MC_KC_TX], *wy = c[MC_KC_TY], *wz = c[MC_KC_TZ];
+		eulerToQuaternion(link.order, count, rx, ry, rz, qx, qy, qz, qw);
+
+		const double ox = link.orient[0], oy = link.orient[1];
+		const double oz = link.orient[2], ow = link.orient[3];
+		const double bx = link.offset.x, by = link.offset.y, bz = link.offset.z;
+		if (link.parent < 0) {
+			for (i = 0; i < count; ++i) {
+				const double x = qx[i], y = qy[i], z = qz[i], w = qw[i];
+				qw[i] = ow * w - ox * x - oy * y - oz * z;
+				qx[i] = ow * x + ox * w + oy * z - oz * y;
+				qy[i] = ow * y + oy * w + oz * x - ox * z;
+				qz[i] = ow * z + oz * w + ox * y - oy * x;
+				wx[i] = (bx + tx[i]) * proportion;
+				wy[i] = (by + ty[i]) * proportion;
+				wz[i] = (bz + tz[i]) * proportion;
+			}
+			continue;
+		}
+
+		const unsigned int pc = link.parent * MC_KC_COUNT;
+		const double *px = &world[pc + MC_KC_QX][begin], *py = &world[pc + MC_KC_QY][begin];
+		const double *pz = &world[pc + MC_KC_QZ][begin], *pw = &world[pc + MC_KC_QW][begin];
+		const double *pt[3] = {&world[pc + MC_KC_TX][begin],
+			&world[pc + MC_KC_TY][begin], &world[pc + MC_KC_TZ][begin]};
+		for (i = 0; i < count; ++i) {
+			// orient * local
+			const double x = qx[i], y = qy[i], z = qz[i], w = qw[i];
+			const double lw = ow * w - ox * x - oy * y - oz * z;
+			const double lx = ow * x + ox * w + oy * z - oz * y;
+			const double ly = ow * y + oy * w + oz * x - ox * z;
+			const double lz = ow * z + oz * w + ox * y - oy * x;
+
+			// parent * that
+			const double ax = px[i], ay = py[i], az = pz[i], aw = pw[i];
+			qw[i] = aw * lw - ax * lx - ay * ly - az * lz;
+			qx[i] = aw * lx + ax * lw + ay * lz - az * ly;
+			qy[i] = aw * ly + ay * lw + az * lx - ax * lz;
+			qz[i] = aw * lz + az * lw + ax * ly - ay * lx;
+
+			// offset stretched by the proportion & the scale of the parent,
+			// turned by the parent: v + w * t + u x t with t = 2 * (u x v)
+			const double k = proportion * ps[i];
+			const double vx = (bx + tx[i]) * k, vy = (by + ty[i]) * k, vz = (bz + tz[i]) * k;
+			const double cx = 2.0 * (ay * vz - az * vy);
+			const double cy = 2.0 * (az * vx - ax * vz);
+			const double cz = 2.0 * (ax * vy - ay * vx);
+			wx[i] = pt[0][i] + vx + aw * cx + (ay * cz - az * cy);
+			wy[i] = pt[1][i] + vy + aw * cy + (az * cx - ax * cz);
+			wz[i] = pt[2][i] + vz + aw * cz + (ax * cy - ay * cx);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// getTransform
+//-----------------------------------------------------------------------------
+void iKinematics::getTransform(unsigned int joint, unsigned int frame, iQua &rot, iVec &pos)
+{
+	IASSERT(joint < joints && frame < frames);
+	rot.v.x = getComponent(joint, MC_KC_QX)[frame];
+	rot.v.y = getComponent(joint, MC_KC_QY)[frame];
+	rot.v.z = getComponent(joint, MC_KC_QZ)[frame];
+	rot.n = getComponent(joint, MC_KC_QW)[frame];
+	pos.x = getComponent(joint, MC_KC_TX)[frame];
+	pos.y = getComponent(joint, MC_KC_TY)[frame];
+	pos.z = getComponent(joint, MC_KC_TZ)[frame];
+}
+
+//-----------------------------------------------------------------------------
+// getMatrix
+//-----------------------------------------------------------------------------
+void iKinematics::getMatrix(unsigned int joint, unsigned int frame, iMat &m)
+{
+	iQua rot;
+	iVec pos;
+	getTransform(joint, frame, rot, pos);
+
+	// column vectors, the position is in the last column
+	const double x = rot.v.x, y = rot.v.y, z = rot.v.z, w = rot.n;
+	m.clear();
+	m[0] = 1.0 - 2.0 * (y * y + z * z);
+	m[1] = 2.0 * (x * y - w * z);
+	m[2] = 2.0 * (x * z + w * y);
+	m[3] = pos.x;
+	m[4] = 2.0 * (x * y + w * z);
+	m[5] = 1.0 - 2.0 * (x * x + z * z);
+	m[6] = 2.0 * (y * z - w * x);
+	m[7] = pos.y;
+	m[8] = 2.0 * (x * z - w * y);
+	m[9] = 2.0 * (y * z + w * x);
+	m[10] = 1.0 - 2.0 * (x * x + y * y);
+	m[11] = pos.z;
+	m[15] = 1.0;
+}
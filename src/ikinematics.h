@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __IKINEMATICS_H__
+#define __IKINEMATICS_H__
+
+#include <vector>
+
+#include "iskeleton.h"
+
+// frames solved by a job at one time, chunks of components hold whole blocks
+const unsigned int kineBlockFrames = 256;
+
+///////////////////////////////////////////////////////////////////////////////
+// class for forward kinematics over whole clips
+//
+// World rotations (unit quaternions) and world positions of every joint are
+// kept per joint and per component over frames (structure of arrays). Joints
+// are in pre-order of the skeleton, so parents always come first. Local
+// transforms follow the joints rebuilt in Maya: rotation of the frame, then
+// the base rotation (joint orient), then the offset. HTR scale factors
+// stretch the offsets of the children. Components are chunked like motion,
+// so that they may be spilled as well.
+//
+class iKinematics {
+public:
+	// components of a world transform
+	enum MC_KINE_COMPONENT {
+		MC_KC_QX, MC_KC_QY, MC_KC_QZ, MC_KC_QW,
+		MC_KC_TX, MC_KC_TY, MC_KC_TZ,
+		MC_KC_COUNT
+	};
+
+	// constructor
+	iKinematics() : joints(0), frames(0), skeleton(NULL) {}
+
+	// solve frames [first, last) of the skeleton, with offsets multiplied
+	// by proportion (rotations are in the orders of joints)
+	int solve(iSkeleton &skel, unsigned int first, unsigned int last,
+		double proportion = 1.0, unsigned int threads = 0);
+
+	// get parameters
+	unsigned int getJoints() { return joints; }
+	unsigned int getFrames() { return frames; }
+
+	// get a component of a joint over all frames
+	const iChunkVector<double> &getComponent(unsigned int joint, unsigned int kc) {
+		return world[joint * MC_KC_COUNT + kc];
+	}
+	// get the world transform of a joint at a frame
+	void getTransform(unsigned int joint, unsigned int frame, imath::iQua &rot, imath::iVec &pos);
+	void getMatrix(unsigned int joint, unsigned int frame, imath::iMat &m);
+
+	// solve frames [begin, end) (relative to the first frame)
+	void solveBlock(unsigned int begin, unsigned int end);
+
+private:
+	//////////////////////////////////////
+	// inner struct for constant parts of joints
+	//
+	struct iLink {
+		iSkeleton::iJoint *joint;
+		int parent;				// index of parent, -1 for root
+		int order;				// rotation order
+		bool translated;		// offsets of frames are used
+		imath::iVec offset;		// base offset
+		double orient[4];		// base rotation (x, y, z, w)
+	};
+	//
+	//////////////////////////////////////
+
+	unsigned int joints;
+	unsigned int frames;
+	unsigned int firstFrame;
+	double proportion;
+	iSkeleton *skeleton;
+	std::vector<iLink> links;
+	std::vector< iChunkVector<double> > world;	// joints * MC_KC_COUNT components
+};
+
+#endif	// #ifndef __IKINEMATICS_H__
@@ -11,6 +11,15 @@
 #include <iostream>
 #include <string>
 #include <cmath>
+#include <cstring>
+#include <limits>
+
+// SSE2 kernels for float and double, unless IMATH_NO_SIMD is defined
+#if !defined (IMATH_NO_SIMD) && (defined (__SSE2__) || defined (_M_X64) || \
+	(defined (_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#	define IMATH_SSE2
+#	include <emmintrin.h>
+#endif
 
 namespace imath {
 
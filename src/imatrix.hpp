@@ -14,6 +14,72 @@
 template <typename T>
 class iVector;
 
+////////////////////////////////////////////////////////////////////////////
+// kernels for products of 4x4 row-major arrays, c = a * b
+// (c must not be a or b)
+//
+// scalar kernel, for any type and as the reference of the others
+template <typename T>
+struct iMatrixScalarKernel {
+	static inline void multiply(const T *a, const T *b, T *c) {
+		for (unsigned int row = 0; row < 4; row ++) {
+			const T *ar = a + row * 4;
+			T *cr = c + row * 4;
+			for (unsigned int col = 0; col < 4; col ++) {
+				cr[col] = ar[0] * b[col] + ar[1] * b[4 + col] +
+					ar[2] * b[8 + col] + ar[3] * b[12 + col];
+			}
+		}
+	}
+};
+
+template <typename T>
+struct iMatrixKernel : public iMatrixScalarKernel<T> {};
+
+#if defined (IMATH_SSE2)
+// a row of c is a sum of the rows of b weighted by a row of a, which is
+// loaded once and spread by shuffles, the four terms summed in pairs
+template <>
+struct iMatrixKernel<float> {
+	static inline void multiply(const float *a, const float *b, float *c) {
+		const __m128 b0 = _mm_loadu_ps(b);
+		const __m128 b1 = _mm_loadu_ps(b + 4);
+		const __m128 b2 = _mm_loadu_ps(b + 8);
+		const __m128 b3 = _mm_loadu_ps(b + 12);
+		for (unsigned int row = 0; row < 4; row ++) {
+			const __m128 ar = _mm_loadu_ps(a + row * 4);
+			const __m128 s01 = _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(ar, ar, 0x00), b0),
+				_mm_mul_ps(_mm_shuffle_ps(ar, ar, 0x55), b1));
+			const __m128 s23 = _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(ar, ar, 0xaa), b2),
+				_mm_mul_ps(_mm_shuffle_ps(ar, ar, 0xff), b3));
+			_mm_storeu_ps(c + row * 4, _mm_add_ps(s01, s23));
+		}
+	}
+};
+
+// rows of b in halves, loaded once, and the four terms summed in pairs
+template <>
+struct iMatrixKernel<double> {
+	static inline void multiply(const double *a, const double *b, double *c) {
+		const __m128d b0 = _mm_loadu_pd(b), b1 = _mm_loadu_pd(b + 2);
+		const __m128d b2 = _mm_loadu_pd(b + 4), b3 = _mm_loadu_pd(b + 6);
+		const __m128d b4 = _mm_loadu_pd(b + 8), b5 = _mm_loadu_pd(b + 10);
+		const __m128d b6 = _mm_loadu_pd(b + 12), b7 = _mm_loadu_pd(b + 14);
+		for (unsigned int row = 0; row < 4; row ++) {
+			const double *ar = a + row * 4;
+			const __m128d s0 = _mm_set1_pd(ar[0]), s1 = _mm_set1_pd(ar[1]);
+			const __m128d s2 = _mm_set1_pd(ar[2]), s3 = _mm_set1_pd(ar[3]);
+			const __m128d lo = _mm_add_pd(_mm_add_pd(_mm_mul_pd(s0, b0), _mm_mul_pd(s1, b2)),
+				_mm_add_pd(_mm_mul_pd(s2, b4), _mm_mul_pd(s3, b6)));
+			const __m128d hi = _mm_add_pd(_mm_add_pd(_mm_mul_pd(s0, b1), _mm_mul_pd(s1, b3)),
+				_mm_add_pd(_mm_mul_pd(s2, b5), _mm_mul_pd(s3, b7)));
+			_mm_storeu_pd(c + row * 4, lo);
+			_mm_storeu_pd(c + row * 4 + 2, hi);
+		}
+	}
+};
+#endif
+
 ////////////////////////////////////////////////////////////////////////////
 // class for 4x4 matrices
 template <typename T>
@@ -40,15 +106,18 @@ public:
 
 	// access elements
 	T& operator()(unsigned int row, unsigned col) {
-		if ((row > 3) && (col > 3)) throw badIndex("Matrix subscript out of bounds");
+		if ((row > 3) || (col > 3)) throw badIndex("Matrix subscript out of bounds");
 		return m[row * 4 + col];
 	}
 
 	T operator()(unsigned int row, unsigned col) const {
-		if ((row > 3) && (col > 3)) throw badIndex("const Matrix subscript out of bounds");
+		if ((row > 3) || (col > 3)) throw badIndex("const Matrix subscript out of bounds");
 		return m[row * 4 + col];
 	}
 
+	// raw elements, row by row
+	const T *data() const { return m; }
+
 	T& operator[](unsigned int idx) {
 		if (idx > 15)	throw badIndex("Matrix subscript out of bounds");
 		return m[idx];
@@ -60,31 +129,21 @@ public:
 	}
 
 	// addition
-	iMatrix<T> operator+(const iMatrix<T> &m1) {
+	iMatrix<T> operator+(const iMatrix<T> &m1) const {
 		iMatrix<T> m2;
 		for (unsigned int i = 0; i < 16; i ++) m2[i] = m[i] + m1[i];
 		return m2;
 	}
 
 	// multiplication with another 4x4 matrix
-	iMatrix<T> operator*(const iMatrix<T> &m1) {
+	iMatrix<T> operator*(const iMatrix<T> &m1) const {
 		iMatrix<T> m2;
-		unsigned baseIdx;
-		for (unsigned int row = 0; row < 4; row ++) {
-			baseIdx = row * 4;
-			for (unsigned int col = 0; col < 4; col ++) {
-				m2(row, col) =
-					m[baseIdx + 0] * m1(0, col) +
-					m[baseIdx + 1] * m1(1, col) +
-					m[baseIdx + 2] * m1(2, col) +
-					m[baseIdx + 3] * m1(3, col);
-			}
-		}
+		iMatrixKernel<T>::multiply(m, m1.m, m2.m);
 		return m2;
 	}
 
 	// multiplication with a vector
-	iVector<T> operator*(const iVector<T> &v1) {
+	iVector<T> operator*(const iVector<T> &v1) const {
 		iVector<T> v2;
 		v2.x = v1.x * m[0] + v1.y * m[1] + v1.z * m[2] + m[3];
 		v2.y = v1.x * m[4] + v1.y * m[5] + v1.z * m[6] + m[7];
@@ -99,7 +158,7 @@ public:
 	}
 
 
-	friend std::ostream& operator<<(std::ostream &out, iMatrix<T> &temp) {
+	friend std::ostream& operator<<(std::ostream &out, const iMatrix<T> &temp) {
 
 		temp.output(out);
 		return out;
@@ -107,7 +166,7 @@ public:
 
 private:
 	// overriding standard output operator
-	void output(std::ostream &out) {
+	void output(std::ostream &out) const {
 		unsigned int idx = 0;
 		out << "[";
 		for (unsigned int row = 0; row < 4; row ++) {
@@ -115,7 +174,7 @@ private:
 				out << "\t" << m[idx ++];
 			}
 			if (3 == row) out << "\t]";
-			out << endl;
+			out << std::endl;
 		}
 	}
 };
@@ -0,0 +1,270 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <maya/MGlobal.h>
+#include <maya/MEventMessage.h>
+#include <maya/MSceneMessage.h>
+#include <maya/MProgressWindow.h>
+
+#include "idebug.h"
+#include "mstatusext.h"
+#include "imocapasync.h"
+
+imyAsyncImport *imyAsyncImport::active = NULL;
+
+//-----------------------------------------------------------------------------
+// constructor
+//-----------------------------------------------------------------------------
+imyAsyncImport::imyAsyncImport(const MString &file, const imocapImport::imocapParam &param) :
+	filename(file), paramBlock(param), cancelling(NULL), scheduler(*this, *this),
+	callbackId(0), newId(0), openId(0), progressing(false), shown(iScheduler::MC_SS_IDLE)
+{
+	data.dgModifier = &dgMod;
+	data.report = &report;
+	startTime = getWallTime();
+}
+
+//-----------------------------------------------------------------------------
+// destructor
+//-----------------------------------------------------------------------------
+imyAsyncImport::~imyAsyncImport()
+{
+	// members go after the job has been joined by the scheduler
+}
+
+//-----------------------------------------------------------------------------
+// start
+//-----------------------------------------------------------------------------
+MStatus imyAsyncImport::start(const MString &filename, const imocapImport::imocapParam &param,
+	const MString &nspace)
+{
+	MStatus stat;
+	MS_ENTRANCE	// Entry for critical zone
+
+	if (NULL != active) {
+		MGlobal::displayError("Another mocap file is being imported, please wait.");
+		MS_CHECK(MStatus::kFailure);
+	}
+
+	imyAsyncImport *task = new imyAsyncImport(filename, param);
+	task->data.myNamespace = nspace;
+
+	// Time & selection are those of the moment of the import
+	stat = imocapImport::captureScene(param, false, task->data);
+	if (!stat.error()) {
+		task->callbackId = MEventMessage::addEventCallback("idle", idleCallback, task, &stat);
+	}
+	if (!stat.error()) {
+		task->newId = MSceneMessage::addCallback(MSceneMessage::kBeforeNew, sceneCallback, task, &stat);
+	}
+	if (!stat.error()) {
+		task->openId = MSceneMessage::addCallback(MSceneMessage::kBeforeOpen, sceneCallback, task, &stat);
+	}
+	if (stat.error()) {
+		if (0 != task->callbackId) MMessage::removeCallback(task->callbackId);
+		if (0 != task->newId) MMessage::removeCallback(task->newId);
+		delete task;
+		MS_CHECK(stat);
+	}
+	active = task;
+
+	if (MProgressWindow::reserve()) {
+		task->progressing = true;
+		MProgressWindow::setTitle("Importing Mocap File");
+		MProgressWindow::setProgressStatus("Reading " + filename);
+		MProgressWindow::setProgressRange(0, 100);
+		MProgressWindow::setProgress(0);
+		MProgressWindow::setInterruptable(true);
+		MProgressWindow::startProgress();
+	}
+	task->scheduler.start();
+	ILOG1 ("Import started in the background");
+
+	MS_EXIT		// Exit for emergency
+	MS_RETURN	// Return for emergency
+}
+
+//-----------------------------------------------------------------------------
+// abort
+//-----------------------------------------------------------------------------
+void imyAsyncImport::abort()
+{
+	if (NULL == active) return;
+	ILOG1 ("Import in the background aborted");
+	active->scheduler.cancel();
+	// every pass of the job polls the flag, so the wait is for one step of
+	// it at most; the commits made so far are undone once cancelled
+	active->scheduler.wait();
+	active->finish();
+}
+
+//-----------------------------------------------------------------------------
+// work
+//-----------------------------------------------------------------------------
+int imyAsyncImport::work(iCancelFlag &cancel)
+{
+	cancelling = &cancel;
+	int result = imocapImport::loadMocapFile(filename, skel, &report, this,
+		paramBlock.memoryBudget, paramBlock.outOfCore, paramBlock.spillFolder.asChar());
+	if (MC_SUCCESS != result) return result;
+	setProgress(0.8);
+	if (cancel.isCancelled()) return MC_CANCELLED;
+
+	status = imocapImport::prepareRebuild(skel, paramBlock, data, &cancel);
+	if (cancel.isCancelled()) return MC_CANCELLED;
+	if (status.error()) return MC_FATAL_ERROR;
+	setProgress(0.9);
+
+	// commits only set keys made here
+	if (!data.onlyBones && !data.streaming) {
+		result = bakeKeys(skel, &data, asyncKeyFrames, &cancel);
+		if (MC_SUCCESS != result) return result;
+	}
+	setProgress(1.0);
+
+	return MC_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// update
+//-----------------------------------------------------------------------------
+bool imyAsyncImport::update(double done)
+{
+	// loading takes the most of the work
+	setProgress(0.8 * done);
+	return !cancelling->isCancelled();
+}
+
+//-----------------------------------------------------------------------------
+// begin
+//-----------------------------------------------------------------------------
+int imyAsyncImport::begin()
+{
+	status = imocapImport::beginRebuild(skel, data);
+	return status.error() ? MC_FATAL_ERROR : MC_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// countUnits
+//-----------------------------------------------------------------------------
+unsigned int imyAsyncImport::countUnits()
+{
+	// blocks of keys of a joint, the first one with the joint
+	return skel.countJoints() * data.keyBlockCount;
+}
+
+//-----------------------------------------------------------------------------
+// commit
+//-----------------------------------------------------------------------------
+int imyAsyncImport::commit(unsigned int idx)
+{
+	ITRACE_SCOPE("commit");
+	const unsigned int joint = idx / data.keyBlockCount;
+	const unsigned int block = idx % data.keyBlockCount;
+	if (0 == block) {
+		status = rebuildNode(skel.getNode(joint), joint, &data);
+	} else {
+		iPhaseTimer timer(data.report, "keys");
+		status = keyJoint(joint, block, &data);
+	}
+	return status.error() ? MC_FATAL_ERROR : MC_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// end
+//-----------------------------------------------------------------------------
+int imyAsyncImport::end()
+{
+	status = imocapImport::endRebuild(data);
+	return status.error() ? MC_FATAL_ERROR : MC_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// rollback
+//-----------------------------------------------------------------------------
+void imyAsyncImport::rollback()
+{
+	imocapImport::abortRebuild(data);
+}
+
+//-----------------------------------------------------------------------------
+// idleCallback
+//-----------------------------------------------------------------------------
+void imyAsyncImport::idleCallback(void *clientData)
+{
+	imyAsyncImport *task = static_cast<imyAsyncImport *>(clientData);
+
+	if (task->progressing && MProgressWindow::isCancelled()) {
+		task->scheduler.cancel();
+	}
+	const int state = task->scheduler.idle(asyncSliceTime);
+
+	if (task->progressing) {
+		if (state != task->shown && iScheduler::MC_SS_COMMITTING == state) {
+			MProgressWindow::setProgressStatus("Creating joints...");
+		}
+		MProgressWindow::setProgress(static_cast<int>(100.0 * task->scheduler.getProgress()));
+	}
+	task->shown = state;
+
+	if (task->scheduler.isFinished()) task->finish();
+}
+
+//-----------------------------------------------------------------------------
+// sceneCallback
+//-----------------------------------------------------------------------------
+void imyAsyncImport::sceneCallback(void *clientData)
+{
+	// joints half made must not leak into the next scene
+	if (clientData == active) abort();
+}
+
+//-----------------------------------------------------------------------------
+// finish
+//-----------------------------------------------------------------------------
+void imyAsyncImport::finish()
+{
+	switch (scheduler.getState()) {
+	case iScheduler::MC_SS_DONE:
+		MGlobal::displayInfo("Mocap file has been imported. Enjoy it pls.");
+		break;
+	case iScheduler::MC_SS_CANCELLED:
+		MGlobal::displayWarning("Import of the mocap file was cancelled.");
+		break;
+	default:
+		if (status.error()) {
+			MGlobal::displayError(status.errorString());
+		} else {
+			MGlobal::displayError("Cannot import " + filename);
+		}
+		break;
+	}
+
+	if (paramBlock.trace.length() > 0) {
+		stopTrace();
+		imocapImport::writeTrace(paramBlock.trace);
+	}
+	const MStatus done = (iScheduler::MC_SS_DONE == scheduler.getState()) ?
+		MStatus(MStatus::kSuccess) : MStatus(MStatus::kFailure);
+	imocapImport::closeReport(report, paramBlock, getWallTime() - startTime, done);
+
+	if (progressing) MProgressWindow::endProgress();
+	MMessage::removeCallback(callbackId);
+	MMessage::removeCallback(newId);
+	MMessage::removeCallback(openId);
+	active = NULL;
+	delete this;
+}
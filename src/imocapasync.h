@@ -0,0 +1,87 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __IMOCAPASYNC_H__
+#define __IMOCAPASYNC_H__
+
+#include <maya/MMessage.h>
+
+#include "imocapimport.h"
+#include "imocapdata.h"
+#include "ischeduler.h"
+
+// main thread's time given to an import on every idle event (second)
+const double asyncSliceTime = 0.05;
+// frames of keys set by one commit, so that long takes keep slices short
+const unsigned int asyncKeyFrames = 1000;
+
+///////////////////////////////////////////////////////////////////////////////
+// class for imports in the background
+//
+// The file is loaded, its motion prepared and its keys baked in a thread of
+// its own, while Maya stays responsive. Joints are then created and keyed by
+// blocks of frames in short slices on idle events, with a progress window
+// able to cancel the import. Only one import runs at a time, and it is
+// aborted before a new or opened scene replaces the one it builds in.
+//
+class imyAsyncImport : public iJob, public iCommit, public iProgress {
+public:
+	// start an import, it deletes itself when finished
+	static MStatus start(const MString &filename, const imocapImport::imocapParam &param,
+		const MString &nspace);
+	// cancel the import in progress and wait for it
+	static void abort();
+	// whether an import is in progress
+	static bool isRunning() { return (NULL != active); }
+
+	// the job
+	virtual int work(iCancelFlag &cancel);
+	// the commits
+	virtual int begin();
+	virtual unsigned int countUnits();
+	virtual int commit(unsigned int idx);
+	virtual int end();
+	virtual void rollback();
+	// progress of loading
+	virtual bool update(double done);
+
+private:
+	imyAsyncImport(const MString &file, const imocapImport::imocapParam &param);
+	virtual ~imyAsyncImport();
+
+	static imyAsyncImport *active;
+	static void idleCallback(void *clientData);
+	static void sceneCallback(void *clientData);
+	void finish();
+
+	MString filename;
+	imocapImport::imocapParam paramBlock;
+	iSkeleton skel;
+	imocapImport::imyCallbackData data;
+	MDGModifier dgMod;
+	MStatus status;				// of the stage which failed
+	iCancelFlag *cancelling;	// flag of the running job
+	iImportReport report;		// phases of the import
+	double startTime;			// wall time the import started
+	iScheduler scheduler;
+	MCallbackId callbackId;
+	MCallbackId newId;			// scene is to be replaced
+	MCallbackId openId;
+	bool progressing;			// progress window is ours
+	int shown;					// state shown by the progress window
+};
+
+#endif	// #ifndef __IMOCAPASYNC_H__
@@ -0,0 +1,284 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <maya/MArgDatabase.h>
+#include <maya/MGlobal.h>
+
+#include "idebug.h"
+#include "mstatusext.h"
+#include "ibenchmark.h"
+#include "isuite.h"
+#include "imocapasync.h"
+#include "imocapbenchmark.h"
+
+using namespace std;
+
+const char *imocapBenchmarkCmd::commandName = "imocapBenchmark";
+
+static const char *formatFlag = "-fmt";
+static const char *formatLongFlag = "-format";
+static const char *jointsFlag = "-j";
+static const char *jointsLongFlag = "-joints";
+static const char *framesFlag = "-fr";
+static const char *framesLongFlag = "-frames";
+static const char *layoutFlag = "-l";
+static const char *layoutLongFlag = "-layout";
+static const char *spacingFlag = "-sp";
+static const char *spacingLongFlag = "-spacing";
+static const char *threadsFlag = "-t";
+static const char *threadsLongFlag = "-threads";
+static const char *repeatFlag = "-r";
+static const char *repeatLongFlag = "-repeat";
+static const char *seedFlag = "-sd";
+static const char *seedLongFlag = "-seed";
+static const char *outputFlag = "-o";
+static const char *outputLongFlag = "-output";
+static const char *recordFlag = "-rec";
+static const char *recordLongFlag = "-record";
+static const char *baselineFlag = "-b";
+static const char *baselineLongFlag = "-baseline";
+static const char *noiseFlag = "-n";
+static const char *noiseLongFlag = "-noise";
+static const char *resultFlag = "-res";
+static const char *resultLongFlag = "-result";
+static const char *suiteFlag = "-su";
+static const char *suiteLongFlag = "-suite";
+
+//-----------------------------------------------------------------------------
+// split a list like "bvh,htr" or "1,2,4"
+//-----------------------------------------------------------------------------
+static void splitList(const string &text, vector<string> &items)
+{
+	string::size_type pos = 0;
+	while (pos < text.size()) {
+		string::size_type end = text.find(',', pos);
+		if (string::npos == end) end = text.size();
+		const string item(text.substr(pos, end - pos));
+		if (!item.empty()) items.push_back(item);
+		pos = end + 1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// creator
+//-----------------------------------------------------------------------------
+void *imocapBenchmarkCmd::creator()
+{
+	return new imocapBenchmarkCmd();
+}
+
+//-----------------------------------------------------------------------------
+// newSyntax
+//-----------------------------------------------------------------------------
+MSyntax imocapBenchmarkCmd::newSyntax()
+{
+	MSyntax syntax;
+	syntax.addFlag(formatFlag, formatLongFlag, MSyntax::kString);
+	syntax.addFlag(jointsFlag, jointsLongFlag, MSyntax::kUnsigned);
+	syntax.addFlag(framesFlag, framesLongFlag, MSyntax::kUnsigned);
+	syntax.addFlag(layoutFlag, layoutLongFlag, MSyntax::kString);
+	syntax.addFlag(spacingFlag, spacingLongFlag, MSyntax::kString);
+	syntax.addFlag(threadsFlag, threadsLongFlag, MSyntax::kString);
+	syntax.addFlag(repeatFlag, repeatLongFlag, MSyntax::kUnsigned);
+	syntax.addFlag(seedFlag, seedLongFlag, MSyntax::kUnsigned);
+	syntax.addFlag(outputFlag, outputLongFlag, MSyntax::kString);
+	syntax.addFlag(recordFlag, recordLongFlag, MSyntax::kString);
+	syntax.addFlag(baselineFlag, baselineLongFlag, MSyntax::kString);
+	syntax.addFlag(noiseFlag, noiseLongFlag, MSyntax::kDouble);
+	syntax.addFlag(resultFlag, resultLongFlag, MSyntax::kString);
+	syntax.addFlag(suiteFlag, suiteLongFlag, MSyntax::kString);
+	return syntax;
+}
+
+//-----------------------------------------------------------------------------
+// doIt
+//-----------------------------------------------------------------------------
+MStatus imocapBenchmarkCmd::doIt(const MArgList &args)
+{
+	MStatus stat;
+	MS_ENTRANCE	// Entry for critical zone
+
+	MArgDatabase argData(syntax(), args, &stat); MS_CHECK(stat);
+	iBenchmarkParam param;
+	MString text;
+	vector<string> formats, items;
+	unsigned int i;
+
+	// the file
+	//
+	if (argData.isFlagSet(formatFlag)) {
+		MS_CHECK(argData.getFlagArgument(formatFlag, 0, text));
+		splitList(text.asChar(), formats);
+		for (i = 0; i < formats.size(); ++i) {
+			if (!param.file.setFormat(formats[i])) {
+				displayError("Unknown format " + MString(formats[i].c_str()));
+				MS_CHECK(MStatus::kFailure);
+			}
+		}
+		MS_CHECK_RELAY	// Relay the emergency
+	}
+	if (formats.empty()) formats.push_back(param.file.getFormatName());
+	param.file.setFormat(formats[0]);
+	if (argData.isFlagSet(layoutFlag)) {
+		MS_CHECK(argData.getFlagArgument(layoutFlag, 0, text));
+		if (!param.file.setLayout(text.asChar())) {
+			displayError("Unknown layout " + text);
+			MS_CHECK(MStatus::kFailure);
+		}
+	}
+	if (argData.isFlagSet(spacingFlag)) {
+		MS_CHECK(argData.getFlagArgument(spacingFlag, 0, text));
+		if (!param.file.setSpacing(text.asChar())) {
+			displayError("Unknown spacing " + text);
+			MS_CHECK(MStatus::kFailure);
+		}
+	}
+	if (argData.isFlagSet(jointsFlag)) {
+		MS_CHECK(argData.getFlagArgument(jointsFlag, 0, param.file.joints));
+	}
+	if (argData.isFlagSet(framesFlag)) {
+		MS_CHECK(argData.getFlagArgument(framesFlag, 0, param.file.frames));
+	}
+	if (argData.isFlagSet(seedFlag)) {
+		MS_CHECK(argData.getFlagArgument(seedFlag, 0, param.file.seed));
+	}
+
+	// write the file only
+	//
+	if (argData.isFlagSet(outputFlag)) {
+		MString path;
+		MS_CHECK(argData.getFlagArgument(outputFlag, 0, path));
+		ofstream out(path.asChar(), ios::out | ios::binary);
+		if (!out || generateMocap(param.file, out) != MC_SUCCESS) {
+			displayError("Cannot write file " + path);
+			MS_CHECK(MStatus::kFailure);
+		}
+		setResult(path);
+		break;
+	}
+
+	// the benchmark
+	//
+	if (argData.isFlagSet(threadsFlag)) {
+		MS_CHECK(argData.getFlagArgument(threadsFlag, 0, text));
+		splitList(text.asChar(), items);
+		for (i = 0; i < items.size(); ++i) {
+			param.threads.push_back(static_cast<unsigned int>(atoi(items[i].c_str())));
+		}
+	}
+	if (argData.isFlagSet(repeatFlag)) {
+		MS_CHECK(argData.getFlagArgument(repeatFlag, 0, param.repeat));
+	}
+	// the pool is restarted with other counts of threads
+	if (imyAsyncImport::isRunning()) {
+		displayError("A background import is running");
+		MS_CHECK(MStatus::kFailure);
+	}
+
+	// every format, unless only suites are run
+	//
+	ostringstream out;
+	iBenchmarkMetrics metrics;
+	if (argData.isFlagSet(formatFlag) || !argData.isFlagSet(suiteFlag)) {
+		for (i = 0; i < formats.size(); ++i) {
+			param.file.setFormat(formats[i]);
+			if (runBenchmark(param, out, &metrics) != MC_SUCCESS) {
+				MGlobal::displayWarning("Some files could not be parsed");
+			}
+		}
+	}
+
+	// suites of the core modules
+	//
+	unsigned int failures = 0;
+	if (argData.isFlagSet(suiteFlag)) {
+		MS_CHECK(argData.getFlagArgument(suiteFlag, 0, text));
+		vector<string> suites;
+		if (text == "all") {
+			getSuiteNames(suites);
+		} else {
+			splitList(text.asChar(), suites);
+		}
+		MString scratch;
+		MS_CHECK(MGlobal::executeCommand("internalVar -userTmpDir", scratch));
+		for (i = 0; i < suites.size(); ++i) {
+			failures += runSuite(suites[i], scratch.asChar(), out, &metrics);
+		}
+	}
+
+	if (argData.isFlagSet(recordFlag)) {
+		MString path;
+		MS_CHECK(argData.getFlagArgument(recordFlag, 0, path));
+		if (writeMetrics(path.asChar(), metrics) != MC_SUCCESS) {
+			displayError("Cannot write baseline " + path);
+			MS_CHECK(MStatus::kFailure);
+		}
+	}
+
+	// the gate against a baseline
+	//
+	if (argData.isFlagSet(baselineFlag)) {
+		MString path;
+		double noise = 0.1;
+		iBenchmarkMetrics baseline;
+		MS_CHECK(argData.getFlagArgument(baselineFlag, 0, path));
+		if (argData.isFlagSet(noiseFlag)) {
+			MS_CHECK(argData.getFlagArgument(noiseFlag, 0, noise));
+		}
+		if (readMetrics(path.asChar(), baseline) != MC_SUCCESS) {
+			displayError("Cannot read baseline " + path);
+			MS_CHECK(MStatus::kFailure);
+		}
+
+		ostringstream verdict;
+		const unsigned int regressions = compareMetrics(baseline, metrics, noise, verdict);
+		out << verdict.str();
+		if (argData.isFlagSet(resultFlag)) {
+			MS_CHECK(argData.getFlagArgument(resultFlag, 0, path));
+			ofstream file(path.asChar());
+			if (!(file << verdict.str())) {
+				displayError("Cannot write result " + path);
+				MS_CHECK(MStatus::kFailure);
+			}
+		}
+		if (regressions > 0) {
+			MString message("Performance regressed on ");
+			message += static_cast<int>(regressions);
+			message += " metrics";
+			displayError(message);
+			MGlobal::displayInfo(out.str().c_str());
+			MS_CHECK(MStatus::kFailure);
+		}
+	}
+	if (failures > 0) {
+		MString message;
+		message += static_cast<int>(failures);
+		message += " checks of the suites failed";
+		displayError(message);
+		MGlobal::displayInfo(out.str().c_str());
+		MS_CHECK(MStatus::kFailure);
+	}
+
+	setResult(MString(out.str().c_str()));
+
+	MS_EXIT		// Exit for emergency
+	MS_RETURN	// Return for emergency
+}
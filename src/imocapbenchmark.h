@@ -0,0 +1,52 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __IMOCAPBENCHMARK_H__
+#define __IMOCAPBENCHMARK_H__
+
+#define REQUIRE_IOSTREAM
+
+#include <maya/MPxCommand.h>
+#include <maya/MSyntax.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// command benchmarking the import stages on synthetic files
+//
+// imocapBenchmark -format "bvh" -joints 60 -frames 20000 -threads "1,2,4"
+//										: a table of throughputs
+// imocapBenchmark -format "htr" -output "a.htr"
+//										: write the synthetic file only
+// imocapBenchmark -format "bvh,htr" -record "a.baseline"
+//										: save metrics as a baseline
+// imocapBenchmark -format "bvh,htr" -baseline "a.baseline" -noise 0.1
+//		-result "a.json"				: fail if any metric regresses
+// imocapBenchmark -suite "clip"		: check core modules headlessly, "all"
+//										  for every suite
+//
+// other flags: -layout (root/full/orders), -spacing (spaces/tabs/crlf/mixed),
+// -repeat and -seed.
+//
+class imocapBenchmarkCmd : public MPxCommand {
+public:
+	virtual MStatus doIt(const MArgList &args);
+
+	static void *creator();
+	static MSyntax newSyntax();
+
+	static const char *commandName;
+};
+
+#endif	// #ifndef __IMOCAPBENCHMARK_H__
@@ -14,6 +14,8 @@
 //
 ////////////////////////////////////////////////////////////////////////////
 
+#include <new>
+
 #include "idebug.h"
 #include "imocapdata.h"
 
@@ -40,7 +42,47 @@ int iMocapData::attach(istream *in, iSkeleton *sk)
 //-----------------------------------------------------------------------------
 // load file
 //-----------------------------------------------------------------------------
-int iMocapData::load()
+int iMocapData::load(iImportReport *report)
+{
+	const iAllocCount allocs = getAllocCount();
+	const double begin = getWallTime();
+	motionBegin = 0.0;
+	int result;
+	try {
+		result = parsing();
+	} catch (const std::bad_alloc &) {
+		// a header may tell more frames than the memory holds
+		ILOG4 ("Error: Out of memory");
+		result = MC_OUT_OF_MEMORY;
+	}
+	const double end = getWallTime();
+	const iAllocCount endAllocs = getAllocCount();
+
+	// a file without motion is all hierarchy
+	if (motionBegin < begin) {
+		motionBegin = end;
+		motionAllocs = endAllocs;
+	}
+	traceSpan("hierarchy", begin, motionBegin);
+	traceSpan("motion", motionBegin, end);
+	if (NULL != report) {
+		report->addPhase("hierarchy", motionBegin - begin, motionAllocs - allocs);
+		report->addPhase("motion", end - motionBegin, endAllocs - motionAllocs);
+		report->stages.insert(report->stages.end(), stageStats.begin(), stageStats.end());
+	}
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+// check the motion against the memory budget
+//-----------------------------------------------------------------------------
+bool iMocapData::isOverBudget(unsigned int joints, iFrameCount frames)
 {
-	return parsing();
+	if (memoryBudget <= 0.0) return false;
+	const double bytes = static_cast<double>(joints) * static_cast<double>(frames) * sizeof(iSkeleton::iFrame);
+	if (bytes <= memoryBudget) return false;
+	ILOG4 ("Error: " << joints << " joints x " << frames << " frames take " <<
+		bytes / (1024.0 * 1024.0) << " MB, over the budget of " <<
+		memoryBudget / (1024.0 * 1024.0) << " MB");
+	return true;
 }
@@ -24,6 +24,8 @@
 
 #include "iskeleton.h"
 #include "iconverter.h"
+#include "ipipeline.h"
+#include "ireport.h"
 
 using namespace std;
 
@@ -36,14 +38,12 @@ const string replacementOfSpace("_");
 
 // max words in joint name
 const unsigned int maxWordsJointName = 10;
-// max number of joints
-const unsigned int maxNumJoints = 1000;
 // max frame rate
 const unsigned int maxFrameRate = 1000;
-// max number of frames
-const unsigned int maxNumFrames = 100000;
 // motion translation threshold
 const double motionThreshold = 0.001;
+// frames between two calls of the progress
+const unsigned int progressStride = 256;
 
 ///////////////////////////////////////////////////////////////////////////////
 // class for frames
@@ -66,6 +66,19 @@ const double motionThreshold = 0.001;
 //	vector<iFrame> frames;
 //};
 
+///////////////////////////////////////////////////////////////////////////////
+// interface of progress callbacks of loads
+//
+// update() is called from the thread calling load(), every progressStride
+// frames or so, and a load ends with MC_CANCELLED once it returns false.
+//
+class iProgress {
+public:
+	virtual ~iProgress() {}
+	// fraction of the motion loaded (0 ... 1), false to cancel
+	virtual bool update(double done) = 0;
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // base class for mocap data
 //
@@ -75,13 +88,37 @@ protected:
 	iSkeleton *skeleton;
 public:
 	// constructor
-	iMocapData() : input(NULL), skeleton(NULL) {}
-	iMocapData(istream *in, iSkeleton *sk) : input(in), skeleton(sk) {}
+	iMocapData() : input(NULL), skeleton(NULL), progress(NULL), memoryBudget(0.0), motionBegin(0.0) {}
+	iMocapData(istream *in, iSkeleton *sk) : input(in), skeleton(sk), progress(NULL),
+		memoryBudget(0.0), motionBegin(0.0) {}
+	// destructor, parsers are deleted through the base
+	virtual ~iMocapData() {}
 	// attach input stream and skeleton
 	int attach(istream *in, iSkeleton *sk);
-	// load mocap data
-	int load();
+	// progress of loads, NULL for none
+	void setProgress(iProgress *prog) { progress = prog; }
+	// memory the motion may take (bytes), 0 for no limit
+	void setMemoryBudget(double bytes) { memoryBudget = bytes; }
+	// load mocap data, phases are added to the report if any
+	int load(iImportReport *report = NULL);
+	// statistics of pipelined stages of the last load
+	const vector<iStageStats> &getStageStats() const { return stageStats; }
 protected:
+	vector<iStageStats> stageStats;
+	iProgress *progress;
+	double memoryBudget;
+	double motionBegin;		// time the motion section was reached
+	iAllocCount motionAllocs;	// allocations when it was reached
+	// parsers call it once the hierarchy is done and room is made for the
+	// frames the header tells, so that the motion counts what each frame costs
+	void markMotion() { motionBegin = getWallTime(); motionAllocs = getAllocCount(); }
+	// tell the progress about the done fraction of the load, true if cancelled
+	bool isCancelled(double done) {
+		if (NULL == progress) return false;
+		return !progress->update(done);
+	}
+	// parsers call it before making room for the frames, true if over the budget
+	bool isOverBudget(unsigned int joints, iFrameCount frames);
 	virtual int parsing() { return 0; };
 };
 
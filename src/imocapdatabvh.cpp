@@ -14,11 +14,120 @@
 //
 ////////////////////////////////////////////////////////////////////////////
 
+#include <cctype>
+#include <cstdlib>
+
 #include "idebug.h"
 #include "imocapdatabvh.h"
 
 using namespace imath;
 
+// bytes of text read at a time from the motion section
+const unsigned int motionChunkBytes = 64 * 1024;
+// batches waiting between two stages
+const unsigned int motionPipeDepth = 4;
+// batches in flight, every pipe full and one in every stage
+const unsigned int motionBatches = motionPipeDepth * 2 + 3;
+// characters between words
+static const string wordDelimiters(spaceCharacters + "{}");
+
+///////////////////////////////////////////////////////////////////////////////
+// a chunk of the motion section, as text and as values
+//
+struct iBvhBatch {
+	vector<char> text;			// ends with a NUL
+	vector<iMotionReal> values;
+	bool last;					// nothing follows
+	bool bad;					// text which is not a number was met
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// stages reading & decoding the motion section
+//
+// Batches go from the reader to the decoder and to the parser, which gives
+// them back to the reader, so no memory is allocated after the first turn.
+//
+struct iBvhPipeline {
+	istream *input;
+	iPipe<iBvhBatch> text;		// reader to decoder
+	iPipe<iBvhBatch> values;	// decoder to parser
+	iPipe<iBvhBatch> spare;		// parser to reader
+	iStageStats readStats;
+	iStageStats decodeStats;
+
+	iBvhPipeline(istream *in) : input(in), text(motionPipeDepth), values(motionPipeDepth),
+		spare(motionBatches), readStats("read"), decodeStats("decode") {}
+	void abort() {
+		text.abort();
+		values.abort();
+		spare.abort();
+	}
+};
+
+//-----------------------------------------------------------------------------
+// reader stage
+//-----------------------------------------------------------------------------
+static THREAD_PROC readerProc(void *arg)
+{
+	iBvhPipeline &pipe = *static_cast<iBvhPipeline *>(arg);
+	ITRACE_SCOPE("read");
+	const double start = getWallTime();
+	for (;;) {
+		iBvhBatch *batch;
+		if (!pipe.spare.pop(batch, pipe.readStats)) break;
+
+		vector<char> &text = batch->text;
+		text.resize(motionChunkBytes);
+		pipe.input->read(&text[0], motionChunkBytes);
+		text.resize(static_cast<size_t>(pipe.input->gcount()));
+		// no number is split between two chunks
+		int c;
+		while ((c = pipe.input->get()) != istream::traits_type::eof() && !isspace(c)) {
+			text.push_back(static_cast<char>(c));
+		}
+		text.push_back('\0');
+
+		// the batch belongs to the decoder once pushed
+		const bool last = !pipe.input->good();
+		batch->last = last;
+		if (!pipe.text.push(batch, pipe.readStats) || last) break;
+	}
+	pipe.readStats.seconds = getWallTime() - start;
+	return THREAD_RETURN;
+}
+
+//-----------------------------------------------------------------------------
+// decoder stage
+//-----------------------------------------------------------------------------
+static THREAD_PROC decoderProc(void *arg)
+{
+	iBvhPipeline &pipe = *static_cast<iBvhPipeline *>(arg);
+	ITRACE_SCOPE("decode");
+	const double start = getWallTime();
+	for (;;) {
+		iBvhBatch *batch;
+		if (!pipe.text.pop(batch, pipe.decodeStats)) break;
+
+		vector<iMotionReal> &values = batch->values;
+		values.clear();
+		const char *p = &batch->text[0];
+		char *end;
+		for (;;) {
+			const double v = strtod(p, &end);
+			if (end == p) break;
+			values.push_back(static_cast<iMotionReal>(v));
+			p = end;
+		}
+		while (isspace(static_cast<unsigned char>(*p))) ++p;
+		batch->bad = ('\0' != *p);
+
+		const bool last = batch->last;
+		if (!pipe.values.push(batch, pipe.decodeStats) || last) break;
+	}
+	pipe.decodeStats.seconds = getWallTime() - start;
+	return THREAD_RETURN;
+}
+
 //-----------------------------------------------------------------------------
 // attach
 //-----------------------------------------------------------------------------
@@ -33,6 +142,15 @@ int iMocapDataBvh::iTokenizerBvh::attach(istream *in)
 	return MC_SUCCESS;
 }
 
+//-----------------------------------------------------------------------------
+// add a word of the current line, into a string of a former line if any
+//-----------------------------------------------------------------------------
+void iMocapDataBvh::iTokenizerBvh::pushWord(string::size_type pos, string::size_type len)
+{
+	if (count == words.size()) words.push_back(string());
+	words[count++].assign(textLine, pos, len);
+}
+
 //-----------------------------------------------------------------------------
 // getWord
 //-----------------------------------------------------------------------------
@@ -44,12 +162,10 @@ int iMocapDataBvh::iTokenizerBvh::getWord(string &oneword)
 		return MC_INVALID_STREAM;
 	}
 
-	if (iter == words.end()) {
+	if (next == count) {
 		// get a line from file and parse it
-		const string delimiter(spaceCharacters + "{}");
-		string textLine;
 		string::size_type prevPos, curPos;
-		words.clear();
+		count = next = 0;
 		prevPos = curPos = 0;
 
 		// if EOF then return
@@ -61,11 +177,11 @@ int iMocapDataBvh::iTokenizerBvh::getWord(string &oneword)
 		// retrieve a line from stream
 		getline(*input, textLine);
 		// trim it
-		textLine = trimString(textLine);
+		trimInPlace(textLine);
 
-		while ((curPos = textLine.find_first_of(delimiter, curPos)) != string::npos) {
+		while ((curPos = textLine.find_first_of(wordDelimiters, curPos)) != string::npos) {
 			// push the last word
-			if (curPos != prevPos) words.push_back(textLine.substr(prevPos, curPos - prevPos));
+			if (curPos != prevPos) pushWord(prevPos, curPos - prevPos);
 			// trim leading spaces
 //			curPos = textLine.find_first_not_of(spaceCharacters, curPos);
 			while (curPos != string::npos && 
@@ -77,28 +193,134 @@ int iMocapDataBvh::iTokenizerBvh::getWord(string &oneword)
 					textLine[curPos] == '}' ||
 					textLine[curPos] == ':'
 				)) {
-				words.push_back(textLine.substr(curPos, 1));
+				pushWord(curPos, 1);
 				++curPos;
 			}
 			// save current position
 			prevPos = curPos;
 		}
 		// process the final word
-		if (prevPos != textLine.length()) words.push_back(textLine.substr(prevPos));
-
-		iter = words.begin();
+		if (prevPos != textLine.length()) pushWord(prevPos, textLine.length() - prevPos);
 	}
 	
-	if (iter != words.end()) {
-		// get a word from queue
-		oneword = *iter;
-		++iter;
+	if (next != count) {
+		// get a word from queue, copied rather than shared with it
+		const string &w = words[next++];
+		oneword.assign(w.data(), w.size());
 		return MC_SUCCESS;
 	}
 
 	return MC_EOF;
 }
 
+//-----------------------------------------------------------------------------
+// pipeMotion
+//-----------------------------------------------------------------------------
+int iMocapDataBvh::pipeMotion(const vector<iChannelLink> &links, iFrameCount frameCount)
+{
+	// where every value of a frame goes
+	//
+	vector<iChannelSlot> slots;
+	iSkeleton::iJoint *lastJoint = NULL;
+	for (vector<iChannelLink>::const_iterator iter = links.begin(); iter != links.end(); ++iter) {
+		iSkeleton::iJoint *jot = skeleton->getJoint((*iter).jointName);
+		IASSERT(NULL != jot);
+		if (NULL == jot) return MC_FATAL_ERROR;
+		for (unsigned int j = 1; j < 4; ++j) {
+			iChannelSlot slot;
+			slot.joint = jot;
+			slot.first = (1 == j) && (jot != lastJoint);
+			slot.rotation = ('R' == (*iter).typeOrder[0]);
+			slot.axis = (*iter).typeOrder[j];
+			slots.push_back(slot);
+		}
+		lastJoint = jot;
+	}
+	if (slots.empty()) return MC_FATAL_ERROR;
+
+	// start stages
+	//
+	iBvhPipeline pipe(input);
+	vector<iBvhBatch> batches(motionBatches);
+	unsigned int i;
+	for (i = 0; i < motionBatches; ++i) pipe.spare.tryPush(&batches[i]);
+
+	// nothing is taken from the stream until the reader runs
+	iThread reader, decoder;
+	if (!startThread(decoder, decoderProc, &pipe)) return MC_FATAL_ERROR;
+	if (!startThread(reader, readerProc, &pipe)) {
+		pipe.abort();
+		joinThread(decoder);
+		return MC_FATAL_ERROR;
+	}
+
+	// store values of frames
+	//
+	iStageStats storeStats("store");
+	ITRACE_SCOPE("store");
+	const double start = getWallTime();
+	const size_t count = slots.size();
+	size_t slot = 0;
+	iFrameCount frame = 0;
+	int result = MC_EOF;
+	while (frame < frameCount) {
+		iBvhBatch *batch;
+		if (!pipe.values.pop(batch, storeStats)) break;
+		const vector<iMotionReal> &values = batch->values;
+		for (i = 0; i < values.size() && frame < frameCount; ++i) {
+			const iChannelSlot &s = slots[slot];
+			if (s.first) s.joint->motion.push_back(iSkeleton::iFrame());
+			iSkeleton::iFrameVec &v = s.rotation ? s.joint->motion.back().rotation : s.joint->motion.back().offset;
+			switch (s.axis) {
+			case 'X': v.x = values[i]; break;
+			case 'Y': v.y = values[i]; break;
+			case 'Z': v.z = values[i]; break;
+			}
+			if (++slot == count) {
+				slot = 0;
+				++frame;
+			}
+		}
+		const bool bad = batch->bad, last = batch->last;
+		pipe.spare.push(batch, storeStats);
+
+		if (frame >= frameCount) break;
+		if (isCancelled(static_cast<double>(frame) / static_cast<double>(frameCount))) {
+			ILOG3 ("Warning: Cancelled at frame " << frame);
+			result = MC_CANCELLED;
+			break;
+		}
+		if (bad) {
+			ILOG4 ("Error: Illeagal value in frame " << frame);
+			result = MC_ILLEAGAL_DATA;
+			break;
+		}
+		if (last) {
+			ILOG3 ("Warning: Only " << frame << " of " << frameCount << " frames");
+			break;
+		}
+	}
+	storeStats.seconds = getWallTime() - start;
+
+	// the rest of the file is of no use
+	pipe.abort();
+	joinThread(reader);
+	joinThread(decoder);
+
+	stageStats.clear();
+	stageStats.push_back(pipe.readStats);
+	stageStats.push_back(pipe.decodeStats);
+	stageStats.push_back(storeStats);
+	for (i = 0; i < stageStats.size(); ++i) {
+		const iStageStats &s = stageStats[i];
+		ILOG2 ("Stage " << s.name << " : " << s.batches << " batches, " << s.stalls << " stalls, "
+			<< s.starves << " starves, peak " << s.peak << ", mean " << s.occupancy << ", "
+			<< s.seconds << "s");
+	}
+
+	return result;
+}
+
 //-----------------------------------------------------------------------------
 // parse mocap data
 //-----------------------------------------------------------------------------
@@ -118,7 +340,7 @@ int iMocapDataBvh::parsing()
 	enum MC_BVH_STAGE { MC_BVH_STAGE_NONE, MC_BVH_STAGE_SKELETON, MC_BVH_STAGE_MOTION };
 	MC_BVH_STAGE stage = MC_BVH_STAGE_NONE;
 
-	unsigned int frameCount = 0;	// quantity of frames
+	iFrameCount frameCount = 0;		// quantity of frames
 	float frameTime = 0;			// time of frame
 
 	iTokenizerBvh tokenBvh(input);
@@ -197,7 +419,7 @@ int iMocapDataBvh::parsing()
 					// joint name
 					MC_GET_WORD;
 					// if it is not left embrace
-					for (int i = 0; (i < maxWordsJointName) && word.compare("{"); ++i) {
+					for (unsigned int i = 0; (i < maxWordsJointName) && word.compare("{"); ++i) {
 						if (jointName.empty()) {
 							jointName = word;
 						} else {
@@ -319,13 +541,13 @@ int iMocapDataBvh::parsing()
 			// get quantity of frame
 			if (!word.compare("FRAMES:")) {
 				MC_GET_WORD;
-				frameCount = fromString<unsigned int>(word);
+				frameCount = fromString<iFrameCount>(word);
 			} else if (!word.compare("FRAMES")) {
 				MC_GET_WORD;
 				if (!word.compare(":")) {
 					MC_GET_WORD;
 				}
-				frameCount = fromString<unsigned int>(word);
+				frameCount = fromString<iFrameCount>(word);
 			} else {
 				result = MC_ILLEAGAL_DATA;
 				break;
@@ -388,9 +610,53 @@ int iMocapDataBvh::parsing()
 				skeleton->setRotOrder(Rotation::getOrderFromString(order));
 				ILOG1("RotationOrder = " << order << " (" << skeleton->getRotOrder() << ")");
 			}
+			// and every joint keeps its own one
+			for (vector<iChannelLink>::iterator iter = chanLinks.begin();
+				iter != chanLinks.end(); ++iter) {
+				if ('R' != (*iter).typeOrder[0]) continue;
+				iSkeleton::iJoint *jot = skeleton->getJoint((*iter).jointName);
+				if (NULL != jot) {
+					jot->setRotOrder(Rotation::getOrderFromString((*iter).typeOrder.substr(1)));
+				}
+			}
 			//================================================
-			
-			for (unsigned int i = 0; i < frameCount; ++i) {
+
+			// the whole take must fit in the budget before room is made for it
+			{
+				unsigned int moving = 0;
+				iSkeleton::iJoint *previous = NULL;
+				for (vector<iChannelLink>::iterator iter = chanLinks.begin();
+					iter != chanLinks.end(); ++iter) {
+					iSkeleton::iJoint *jot = skeleton->getJoint((*iter).jointName);
+					if (jot != previous) ++moving;
+					previous = jot;
+				}
+				if (isOverBudget(moving, frameCount)) {
+					result = MC_OUT_OF_MEMORY;
+					break;
+				}
+			}
+
+			// room for all frames, chunks keep growing if the header tells too few
+			for (vector<iChannelLink>::iterator iter = chanLinks.begin();
+				iter != chanLinks.end(); ++iter) {
+				iSkeleton::iJoint *jot = skeleton->getJoint((*iter).jointName);
+				if (NULL != jot) jot->motion.reserve(frameCount);
+			}
+			markMotion();
+
+			// frames on lines of their own are read by concurrent stages
+			if (tokenBvh.isLineDone() && !chanLinks.empty()) {
+				result = pipeMotion(chanLinks, frameCount);
+				if (MC_FATAL_ERROR != result) break;
+				result = MC_SUCCESS;
+			}
+			for (iFrameCount i = 0; i < frameCount; ++i) {
+				if (0 == i % progressStride && isCancelled(static_cast<double>(i) / static_cast<double>(frameCount))) {
+					ILOG3 ("Warning: Cancelled at frame " << i);
+					result = MC_CANCELLED;
+					break;
+				}
 				ILOG1 (i << " " << horizontalLine);
 				iSkeleton::iJoint *jot, *lastJoint = NULL;
 				vector<iChannelLink>::iterator iter;
@@ -398,7 +664,7 @@ int iMocapDataBvh::parsing()
 					ILOG0 ((*iter).jointName);
 
 					iSkeleton::iFrame frame;
-					const string order((*iter).typeOrder);
+					const string &order((*iter).typeOrder);
 
 					// make sure joint exist !!!
 					jot = skeleton->getJoint((*iter).jointName);
@@ -408,9 +674,9 @@ int iMocapDataBvh::parsing()
 						for (unsigned int j = 1; j < 4; ++j) {
 							MC_GET_WORD;
 							switch(order[j]) {
-							case 'X': frame.offset.x = fromString<float>(word); break;
-							case 'Y': frame.offset.y = fromString<float>(word); break;
-							case 'Z': frame.offset.z = fromString<float>(word); break;
+							case 'X': frame.offset.x = fromString<iMotionReal>(word); break;
+							case 'Y': frame.offset.y = fromString<iMotionReal>(word); break;
+							case 'Z': frame.offset.z = fromString<iMotionReal>(word); break;
 							}
 							ILOG0 ((*iter).jointName << " offset = " << frame.offset);
 						}
@@ -418,9 +684,9 @@ int iMocapDataBvh::parsing()
 						for (unsigned int j = 1; j < 4; ++j) {
 							MC_GET_WORD;
 							switch(order[j]) {
-							case 'X': frame.rotation.x = fromString<float>(word); break;
-							case 'Y': frame.rotation.y = fromString<float>(word); break;
-							case 'Z': frame.rotation.z = fromString<float>(word); break;
+							case 'X': frame.rotation.x = fromString<iMotionReal>(word); break;
+							case 'Y': frame.rotation.y = fromString<iMotionReal>(word); break;
+							case 'Z': frame.rotation.z = fromString<iMotionReal>(word); break;
 							}
 							ILOG0 ((*iter).jointName << " rotation = " << frame.rotation);
 						}
@@ -473,3 +739,18 @@ int iMocapDataBvh::parsing()
 
 	return result;
 }
+
+//-----------------------------------------------------------------------------
+// count words by the tokenizer alone
+//-----------------------------------------------------------------------------
+int iMocapDataBvh::countWords(istream *in, unsigned long &count)
+{
+	iTokenizerBvh tokenBvh(in);
+	string word;
+	int result;
+
+	count = 0;
+	while ((result = tokenBvh.getWord(word)) == MC_SUCCESS) ++count;
+
+	return (MC_EOF == result) ? MC_SUCCESS : result;
+}
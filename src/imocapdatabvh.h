@@ -28,19 +28,27 @@
 class iMocapDataBvh : public iMocapData {
 public:
 	iMocapDataBvh(istream *in, iSkeleton *sk) : iMocapData(in, sk) {}
+
+	// count words of a stream by the tokenizer alone (for benchmarks)
+	static int countWords(istream *in, unsigned long &count);
 private:
 	//////////////////////////////////////
 	// inner class for file parsing
 	//
 	class iTokenizerBvh {
 		istream *input;
-		vector<string> words;
-		vector<string>::iterator iter;
+		string textLine;		// kept to reuse its storage
+		vector<string> words;	// the first count are of the current line
+		unsigned int count;
+		unsigned int next;
+		void pushWord(string::size_type pos, string::size_type len);
 	public:
-		iTokenizerBvh() : input(NULL), iter(words.begin()) {}
-		iTokenizerBvh(istream *in) : input(in), iter(words.begin()) {}
+		iTokenizerBvh() : input(NULL), count(0), next(0) {}
+		iTokenizerBvh(istream *in) : input(in), count(0), next(0) {}
 		int attach(istream *in);
 		int getWord(string &oneword);
+		// whether words of the current line are used up
+		bool isLineDone() { return next == count; }
 	};
 	//
 	//////////////////////////////////////
@@ -54,8 +62,23 @@ private:
 	};
 	//
 	//////////////////////////////////////
+
+	//////////////////////////////////////
+	// inner struct for a value of a frame
+	//
+	struct iChannelSlot {
+		iSkeleton::iJoint *joint;
+		bool first;				// first value of the joint in a frame
+		bool rotation;			// or offset
+		char axis;				// 'X', 'Y' or 'Z'
+	};
+	//
+	//////////////////////////////////////
+
 	// parse mocap data
 	int parsing();
+	// read, decode & store frames by concurrent stages
+	int pipeMotion(const vector<iChannelLink> &links, iFrameCount frameCount);
 };
 
 #endif	// #ifndef __IMOCAPDATABVH_H__
@@ -14,11 +14,94 @@
 //
 ////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+
 #include "idebug.h"
 #include "imocapdatahtr.h"
 
 using namespace imath;
 
+// lines read at a time from the motion section
+const unsigned int motionChunkLines = 1024;
+// batches waiting between the reader and the parser
+const unsigned int motionPipeDepth = 4;
+// batches in flight, the pipe full and one in every stage
+const unsigned int motionBatches = motionPipeDepth + 2;
+
+///////////////////////////////////////////////////////////////////////////////
+// lines of the motion section, as words
+//
+struct iHtrBatch {
+	vector<vector<string> > lines;	// words of a line in the first counts[i]
+	vector<unsigned int> counts;
+	unsigned int size;				// lines of the batch
+	bool last;						// nothing follows
+
+	iHtrBatch() : lines(motionChunkLines), counts(motionChunkLines), size(0), last(false) {}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// stages reading & parsing the motion section
+//
+// Batches go from the reader to the parser, which gives them back, and the
+// words of lines are swapped rather than copied, so no memory is allocated
+// after the first turns.
+//
+struct iHtrPipeline {
+	istream *input;
+	iPipe<iHtrBatch> lines;		// reader to parser
+	iPipe<iHtrBatch> spare;		// parser to reader
+	iStageStats readStats;
+	iStageStats parseStats;
+	vector<iHtrBatch> batches;
+	double start;				// wall time the parser started
+
+	iHtrPipeline(istream *in) : input(in), lines(motionPipeDepth), spare(motionBatches),
+		readStats("read"), parseStats("parse"), batches(motionBatches), start(getWallTime()) {
+		for (unsigned int i = 0; i < motionBatches; ++i) spare.tryPush(&batches[i]);
+	}
+	void abort() {
+		lines.abort();
+		spare.abort();
+	}
+};
+
+//-----------------------------------------------------------------------------
+// reader stage
+//-----------------------------------------------------------------------------
+static THREAD_PROC readerProc(void *arg)
+{
+	iHtrPipeline &pipe = *static_cast<iHtrPipeline *>(arg);
+	ITRACE_SCOPE("read");
+	const double start = getWallTime();
+	string textLine;
+	for (;;) {
+		iHtrBatch *batch;
+		if (!pipe.spare.pop(batch, pipe.readStats)) break;
+
+		// as the tokenizer does it line by line
+		batch->size = 0;
+		batch->last = false;
+		while (batch->size < motionChunkLines) {
+			if (pipe.input->eof()) {
+				batch->last = true;
+				break;
+			}
+			getline(*pipe.input, textLine);
+			trimInPlace(textLine);
+			uncommentInPlace(textLine);
+			batch->counts[batch->size] = tokenizeInto(textLine, batch->lines[batch->size]);
+			++batch->size;
+		}
+
+		// the batch belongs to the parser once pushed
+		const bool last = batch->last;
+		if (!pipe.lines.push(batch, pipe.readStats) || last) break;
+	}
+	pipe.readStats.seconds = getWallTime() - start;
+	return THREAD_RETURN;
+}
+
 //-----------------------------------------------------------------------------
 // attach
 //-----------------------------------------------------------------------------
@@ -36,13 +119,14 @@ int iMocapDataHtr::iTokenizerHtr::attach(istream *in)
 //-----------------------------------------------------------------------------
 // getWord
 //-----------------------------------------------------------------------------
-int iMocapDataHtr::iTokenizerHtr::getWords(vector<string> &words)
+int iMocapDataHtr::iTokenizerHtr::getWords(vector<string> &words, unsigned int &count)
 {
 	// check input stream and skeleton
 	if (NULL == input) {
 		ILOG4 ("Error: Invalid stream");
 		return MC_INVALID_STREAM;
 	}
+	if (NULL != pipe) return takeWords(words, count);
 
 	// if EOF then return
 	if (input->eof()) {
@@ -52,24 +136,102 @@ int iMocapDataHtr::iTokenizerHtr::getWords(vector<string> &words)
 
 	// retrieve a line from stream
 	//
-	string textLine;
 	getline(*input, textLine);
 	
 	// trim it
 	//
-	textLine = trimString(textLine);
+	trimInPlace(textLine);
 	
 	// get rid of comment
 	//
-	textLine = uncommentString(textLine);
+	uncommentInPlace(textLine);
 
 	// tokenize it
-	words.clear();
-	tokenizeString(textLine, words);
+	count = tokenizeInto(textLine, words);
 
 	return MC_SUCCESS;
 }
 
+//-----------------------------------------------------------------------------
+// words of the next line read ahead
+//-----------------------------------------------------------------------------
+int iMocapDataHtr::iTokenizerHtr::takeWords(vector<string> &words, unsigned int &count)
+{
+	while (NULL == batch || next == batch->size) {
+		if (NULL != batch) {
+			const bool last = batch->last;
+			pipe->spare.push(batch, pipe->parseStats);
+			batch = NULL;
+			if (last) {
+				ILOG0 ("End Of File");
+				return MC_EOF;
+			}
+		}
+		if (!pipe->lines.pop(batch, pipe->parseStats)) return MC_EOF;
+		next = 0;
+	}
+
+	// the strings of the caller are left to the reader for later lines
+	words.swap(batch->lines[next]);
+	count = batch->counts[next++];
+	return MC_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// startPipe
+//-----------------------------------------------------------------------------
+bool iMocapDataHtr::iTokenizerHtr::startPipe()
+{
+	if (NULL == input || NULL != pipe) return false;
+
+	pipe = new iHtrPipeline(input);
+	if (!startThread(reader, readerProc, pipe)) {
+		ILOG3 ("Warning: Cannot start a thread reading ahead");
+		delete pipe;
+		pipe = NULL;
+		return false;
+	}
+	batch = NULL;
+	next = 0;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// stopPipe
+//-----------------------------------------------------------------------------
+void iMocapDataHtr::iTokenizerHtr::stopPipe(vector<iStageStats> *stats)
+{
+	if (NULL == pipe) return;
+
+	// the rest of the file is of no use
+	pipe->abort();
+	joinThread(reader);
+	pipe->parseStats.seconds = getWallTime() - pipe->start;
+	if (NULL != stats) {
+		stats->clear();
+		stats->push_back(pipe->readStats);
+		stats->push_back(pipe->parseStats);
+		for (unsigned int i = 0; i < stats->size(); ++i) {
+			const iStageStats &s = (*stats)[i];
+			ILOG2 ("Stage " << s.name << " : " << s.batches << " batches, " << s.stalls << " stalls, "
+				<< s.starves << " starves, peak " << s.peak << ", mean " << s.occupancy << ", "
+				<< s.seconds << "s");
+		}
+	}
+	delete pipe;
+	pipe = NULL;
+	batch = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// room for the frames of joints, as many as the header tells
+//-----------------------------------------------------------------------------
+static void reserveFrames(vector<iSkeleton::iJoint *> &joints, iFrameCount frames)
+{
+	if (0 == frames) return;
+	for (unsigned int i = 0; i < joints.size(); ++i) joints[i]->motion.reserve(frames);
+}
+
 //-----------------------------------------------------------------------------
 // parse mocap data
 //-----------------------------------------------------------------------------
@@ -93,16 +255,18 @@ int iMocapDataHtr::parsing()
 		MC_HTR_STAGE_BASE, MC_HTR_STAGE_FRAMES, MC_HTR_STAGE_FINISH };
 	MC_HTR_STAGE stage = MC_HTR_STAGE_NONE;
 
-	unsigned int frameCount = 0;	// quantity of frames
-	float frameTime = 0;			// time of frame
+	size_t records = 0;				// frames of joints stored
+	double recordCount = 1.0;		// of all joints, beyond 32 bits in long takes
 
 	vector<string> words;
+	unsigned int wordCount = 0;
 	iTokenizerHtr tokenHtr(input);
 	unsigned int argsCount = 0;
 
 	// variables
 	iSkeleton::iJoint *joint;
-	iVec offset, rotation, rootOffset;
+	iVec offset, rotation;
+	iSkeleton::iFrameVec rootOffset;
 	float length = 0.0;
 	iSkeleton::iFrame frame;
 	bool haveTranslation = false;
@@ -118,7 +282,7 @@ int iMocapDataHtr::parsing()
 	int htrVersion = 1;
 	int htrSegments = 0;
 	int htrFrameRate = 60;
-	int htrFrames = 0;
+	iFrameCount htrFrames = 0;
 	int htrOrder = Rotation::MC_RO_ZYX;
 	bool htrRotationUnits = true;	// true for degrees, false for radians
 
@@ -128,16 +292,14 @@ int iMocapDataHtr::parsing()
 	// parsering loop
 	//
 	while ((stage != MC_HTR_STAGE_FINISH) &&
-		((result = tokenHtr.getWords(words)) == MC_SUCCESS)) {
+		((result = tokenHtr.getWords(words, wordCount)) == MC_SUCCESS)) {
 
 		// empty line
-		if (words.empty()) continue;
+		if (0 == wordCount) continue;
 
 		// get the first word
-		vector<string>::iterator iter = words.begin();
-		const string title(*iter);
-		++iter;
-		argsCount = static_cast<int>(words.size() - 1);
+		const string &title(words[0]);
+		argsCount = wordCount - 1;
 
 		///////////////////////////////
 		// lay these codes temporarily
@@ -193,15 +355,15 @@ int iMocapDataHtr::parsing()
 					ILOG4 ("Error: Unsupported file version in Header");
 					break;
 				}
-				if (htrFrameRate < 1 && htrFrameRate > maxFrameRate) {
+				if (htrFrameRate < 1 && htrFrameRate > static_cast<int>(maxFrameRate)) {
 					ILOG4 ("Error: Illegal frame rate in Header");
 					break;
 				}
-				if (htrSegments < 1 && htrSegments > maxNumJoints) {
+				if (htrSegments < 0) {
 					ILOG4 ("Error: Illegal number of segments in Header");
 					break;
 				}
-				if (htrOrder == Rotation::MC_RO_NONE) {
+				if (htrOrder == static_cast<int>(Rotation::MC_RO_NONE)) {
 					ILOG4 ("Error: Unsupported rotation order in Header");
 					break;
 				}
@@ -253,7 +415,9 @@ int iMocapDataHtr::parsing()
 				htrSegments = fromString<int>(words[1]);
 				ILOG2 ("Info: Gotta Header.NumSegments - " << htrSegments);
 			} else if (!compareNoncase(title, "NumFrames")) {
-				htrFrames = fromString<int>(words[1]);
+				// a negative count tells nothing
+				const long long told = fromString<long long>(words[1]);
+				htrFrames = (told > 0) ? static_cast<iFrameCount>(told) : 0;
 				ILOG2 ("Info: Gotta Header.NumFrames - " << htrFrames);
 			} else if (!compareNoncase(title, "EulerRotationOrder")) {
 				htrOrder = Rotation::getOrderFromString(words[1]);
@@ -352,6 +516,14 @@ int iMocapDataHtr::parsing()
 					int frameNo = fromString<int>(s.erase(s.length() - 1));
 					if ((*(words[1].rbegin()) == ':') && (frameNo == 1)) {
 						stage = MC_HTR_STAGE_FRAMES;
+						recordCount = max(1.0, static_cast<double>(htrSegments) * static_cast<double>(htrFrames));
+						if (isOverBudget(static_cast<unsigned int>(jointIndex.size()), htrFrames)) {
+							result = MC_OUT_OF_MEMORY;
+							break;
+						}
+						reserveFrames(jointIndex, htrFrames);
+						markMotion();
+						tokenHtr.startPipe();
 						ILOG0 ("Goto Motion Section (HTR 2)");
 						continue;
 					}
@@ -367,6 +539,14 @@ int iMocapDataHtr::parsing()
 						break;
 					}
 					stage = MC_HTR_STAGE_FRAMES;
+					recordCount = max(1.0, static_cast<double>(htrSegments) * static_cast<double>(htrFrames));
+					if (isOverBudget(static_cast<unsigned int>(jointIndex.size()), htrFrames)) {
+						result = MC_OUT_OF_MEMORY;
+						break;
+					}
+					reserveFrames(jointIndex, htrFrames);
+					markMotion();
+					tokenHtr.startPipe();
 					ILOG0 ("Goto Motion Section (HTR 1)");
 					continue;
 				}
@@ -417,88 +597,33 @@ int iMocapDataHtr::parsing()
 			if (!compareNoncase(title, "[EndOfFile]")) {
 				stage = MC_HTR_STAGE_FINISH;
 				ILOG0 ("The end of sections");
-
-				// assign values to variables in skeleton
-				//
-				float frameTime = 1.0F / htrFrameRate;
-				skeleton->setFrames(htrFrames);
-				skeleton->setFrameTime(frameTime);
-				skeleton->setRotOrder(htrOrder);
-				skeleton->setHaveTranslation(haveTranslation);
-				// now, okay!
-
 				continue;
 			}
 			// todo: retrieve motion data
 			//
 			if (htrVersion == 2) {
 				// HTR Version 2
-				// check arguments
-				if (compareNoncase(title, "Frame")) {
-					string s = title;
-					int frameNo = fromString<int>(s.erase(s.length() - 1));
-					if ((*(title.rbegin()) == ':') && (frameNo <= htrFrames)) {
-						// We ignore the number of frames...just increase it by 1
-						//
-						ILOG1 ("Frame " << frameNo << " starts...");
-						continue;
-					} else {
+				// segments of a frame follow 'Frame n:'
+				//
+				if (!compareNoncase(title, "Frame")) {
+					if (argsCount != 1 || *(words[1].rbegin()) != ':' ||
+						fromString<iFrameCount>(words[1].substr(0, words[1].length() - 1)) > htrFrames) {
 						result = MC_ILLEAGAL_DATA;
 						ILOG4 ("Error: The number of frame (HTR 2) is out of bound or syntex is incorrect");
 						break;
 					}
+					ILOG1 ("Frame " << words[1] << " starts...");
+					continue;
 				}
-				if (argsCount != 3 || argsCount != 4) {
-					result = MC_ILLEAGAL_DATA;
-					ILOG4 ("Error: The number of arguments in Frames (HTR 2) was invalid");
-					break;
-				}
-				// get the number of bones
+				// segments are numbered from 1 in the order of BasePosition
 				//
-				string s = words[0];
-				int boneNo = fromString<int>(s.erase(s.length() - 1));
-				//ILOG2 ("bone no.= " << boneNo)
-				if ((*(words[0].rbegin()) != ':') || (boneNo < 0) || (boneNo >= static_cast<int>(jointIndex.size()))) {
+				int boneNo = fromString<int>(title.substr(0, title.length() - 1));
+				if ((*(title.rbegin()) != ':') || (boneNo < 1) || (boneNo > static_cast<int>(jointIndex.size()))) {
 					result = MC_ILLEAGAL_DATA;
 					ILOG4 ("Error: The number of bone (HTR 2) in the frames is out of bound or syntex is incorrect");
 					break;
 				}
-				// assign
-				//
-				if (boneNo == 0) {
-					// translation of root
-					rootOffset.x = fromString<float>(words[1]) * htrProportion * htrScaleFactor;
-					rootOffset.y = fromString<float>(words[2]) * htrProportion * htrScaleFactor;
-					rootOffset.z = fromString<float>(words[3]) * htrProportion * htrScaleFactor;
-				} else {
-					currentJoint = jointIndex[boneNo - 1];
-					// set rotation
-					if (htrRotationUnits) {
-						// degrees
-						frame.rotation.x = fromString<float>(words[1]);
-						frame.rotation.y = fromString<float>(words[2]);
-						frame.rotation.z = fromString<float>(words[3]);
-					} else {
-						// radians
-						frame.rotation.x = toDegrees(fromString<float>(words[1]));
-						frame.rotation.y = toDegrees(fromString<float>(words[2]));
-						frame.rotation.z = toDegrees(fromString<float>(words[3]));
-					}
-					if (skeleton->isRoot(currentJoint))	{
-						frame.offset = rootOffset;
-					} else {
-						frame.offset = iVec(0.0, 0.0, 0.0);
-					}
-					// set the length of bone
-					// which is elastic in some circumstances
-					//
-					frame.offset.y += fromString<float>(words[4]) * htrProportion * htrScaleFactor;
-					frame.scale = 1.0;
-
-					currentJoint->motion.push_back(frame);
-					ILOG0 (currentJoint->getName() << " offset = " << frame.offset << " rotation = " << frame.rotation << " scale = " << frame.scale);
-				}
-
+				currentJoint = jointIndex[boneNo - 1];
 			} else {
 				// HTR Version 1 (default)
 				// check arguments
@@ -514,48 +639,55 @@ int iMocapDataHtr::parsing()
 						break;
 					}
 				}
-				if (argsCount != 7) {
-					result = MC_ILLEAGAL_DATA;
-					ILOG4 ("Error: The number of arguments in Frames (HTR 1) was invalid");
-					break;
-				}
-
-				// get frame data
-				if (currentJoint  == NULL) {
-					result = MC_ILLEAGAL_DATA;
-					ILOG4 ("Error: The current joint in Frames was invalid");
-					break;
-				}
-				// offsets
-				frame.offset.x = fromString<float>(words[1]) * htrProportion * htrScaleFactor;
-				frame.offset.y = fromString<float>(words[2]) * htrProportion * htrScaleFactor;
-				frame.offset.z = fromString<float>(words[3]) * htrProportion * htrScaleFactor;
-				
-				if (currentJoint != skeleton->getJoint(firstJointName)) {
-					haveTranslation = haveTranslation ||
-						(abs(frame.offset.x) > motionThreshold) ||
-						(abs(frame.offset.y) > motionThreshold) ||
-						(abs(frame.offset.z) > motionThreshold);
-				}
+			}
+			// both versions give a joint the same values, but version 2 ends
+			// with the length of the bone instead of its scale
+			//
+			if (argsCount != 7) {
+				result = MC_ILLEAGAL_DATA;
+				ILOG4 ("Error: The number of arguments in Frames was invalid");
+				break;
+			}
 
-				// rotations
-				if (htrRotationUnits) {
-					// degrees
-					frame.rotation.x = fromString<float>(words[4]);
-					frame.rotation.y = fromString<float>(words[5]);
-					frame.rotation.z = fromString<float>(words[6]);
-				} else {
-					// radians
-					frame.rotation.x = toDegrees(fromString<float>(words[4]));
-					frame.rotation.y = toDegrees(fromString<float>(words[5]));
-					frame.rotation.z = toDegrees(fromString<float>(words[6]));
-				}
-				// scale
-				frame.scale = fromString<float>(words[7]);
-				// append it
-				currentJoint->motion.push_back(frame);
-				ILOG0 (currentJoint->getName() << " offset = " << frame.offset << " rotation = " << frame.rotation << " scale = " << frame.scale);
+			// get frame data
+			if (currentJoint  == NULL) {
+				result = MC_ILLEAGAL_DATA;
+				ILOG4 ("Error: The current joint in Frames was invalid");
+				break;
+			}
+			// offsets
+			frame.offset.x = fromString<iMotionReal>(words[1]) * htrProportion * htrScaleFactor;
+			frame.offset.y = fromString<iMotionReal>(words[2]) * htrProportion * htrScaleFactor;
+			frame.offset.z = fromString<iMotionReal>(words[3]) * htrProportion * htrScaleFactor;
+			
+			if (currentJoint != skeleton->getJoint(firstJointName)) {
+				haveTranslation = haveTranslation ||
+					(abs(frame.offset.x) > motionThreshold) ||
+					(abs(frame.offset.y) > motionThreshold) ||
+					(abs(frame.offset.z) > motionThreshold);
+			}
 
+			// rotations
+			if (htrRotationUnits) {
+				// degrees
+				frame.rotation.x = fromString<iMotionReal>(words[4]);
+				frame.rotation.y = fromString<iMotionReal>(words[5]);
+				frame.rotation.z = fromString<iMotionReal>(words[6]);
+			} else {
+				// radians
+				frame.rotation.x = toDegrees(fromString<iMotionReal>(words[4]));
+				frame.rotation.y = toDegrees(fromString<iMotionReal>(words[5]));
+				frame.rotation.z = toDegrees(fromString<iMotionReal>(words[6]));
+			}
+			// scale, the length of version 2 is in the offsets of the children
+			frame.scale = (htrVersion == 2) ? 1.0F : fromString<iMotionReal>(words[7]);
+			// append it
+			currentJoint->motion.push_back(frame);
+			ILOG0 (currentJoint->getName() << " offset = " << frame.offset << " rotation = " << frame.rotation << " scale = " << frame.scale);
+			if (0 == ++records % progressStride && isCancelled(records / recordCount)) {
+				ILOG3 ("Warning: Cancelled");
+				result = MC_CANCELLED;
+				break;
 			}
 			break;
 
@@ -576,7 +708,43 @@ int iMocapDataHtr::parsing()
 
 	}
 
+	// the frames are read ahead by a stage of their own
+	tokenHtr.stopPipe(&stageStats);
+
+	// some writers end the frames by the end of file
+	if (MC_EOF == result && MC_HTR_STAGE_FRAMES == stage) {
+		ILOG3 ("Warning: No [EndOfFile] after the frames");
+		stage = MC_HTR_STAGE_FINISH;
+		result = MC_SUCCESS;
+	}
+
 	// finnaly
 	//
+	if (MC_SUCCESS == result && MC_HTR_STAGE_FINISH == stage) {
+		// assign values to variables in skeleton
+		//
+		float frameTime = 1.0F / htrFrameRate;
+		skeleton->setFrames(htrFrames);
+		skeleton->setFrameTime(frameTime);
+		skeleton->setRotOrder(htrOrder);
+		skeleton->setHaveTranslation(haveTranslation);
+		// now, okay!
+	}
 	return result;
 }
+
+//-----------------------------------------------------------------------------
+// count words by the tokenizer alone
+//-----------------------------------------------------------------------------
+int iMocapDataHtr::countWords(istream *in, unsigned long &count)
+{
+	iTokenizerHtr tokenHtr(in);
+	vector<string> words;
+	unsigned int wordCount;
+	int result;
+
+	count = 0;
+	while ((result = tokenHtr.getWords(words, wordCount)) == MC_SUCCESS) count += wordCount;
+
+	return (MC_EOF == result) ? MC_SUCCESS : result;
+}
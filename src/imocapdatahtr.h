@@ -19,23 +19,43 @@
 
 #include "imocapdata.h"
 
+struct iHtrPipeline;
+struct iHtrBatch;
+
 ///////////////////////////////////////////////////////////////////////////////
 // class for HTR mocap files
 //
 class iMocapDataHtr : public iMocapData {
 public:
 	iMocapDataHtr(istream *in, iSkeleton *sk) : iMocapData(in, sk) {}
+
+	// count words of a stream by the tokenizer alone (for benchmarks)
+	static int countWords(istream *in, unsigned long &count);
 private:
 	//////////////////////////////////////
 	// inner class for file parsing
 	//
 	class iTokenizerHtr {
 		istream *input;
+		string textLine;		// kept to reuse its storage
+		iHtrPipeline *pipe;		// lines read ahead by a thread, NULL for none
+		iHtrBatch *batch;		// lines being given out
+		unsigned int next;		// next line of the batch
+		iThread reader;
+		int takeWords(vector<string> &words, unsigned int &count);
 	public:
-		iTokenizerHtr() : input(NULL) {}
-		iTokenizerHtr(istream *in) : input(in) {}
+		iTokenizerHtr() : input(NULL), pipe(NULL), batch(NULL), next(0) {}
+		iTokenizerHtr(istream *in) : input(in), pipe(NULL), batch(NULL), next(0) {}
+		~iTokenizerHtr() { stopPipe(); }
 		int attach(istream *in);
-		int getWords(vector<string> &words);
+		// words of the next line go to the first count strings, the rest
+		// are left from former lines to be reused
+		int getWords(vector<string> &words, unsigned int &count);
+		// read & tokenize lines ahead in a thread of its own from now on,
+		// false if they are still read in the calling thread
+		bool startPipe();
+		// stop reading ahead, statistics of the stages go to stats if any
+		void stopPipe(vector<iStageStats> *stats = NULL);
 	};
 	//
 	//////////////////////////////////////
@@ -15,8 +15,10 @@
 ////////////////////////////////////////////////////////////////////////////
 
 // To keep compatibility with maya 5.0
+#include <cstdio>
 #include <fstream>
 #include <ctime>
+#include <algorithm>
 
 #define REQUIRE_IOSTREAM
 
@@ -32,12 +34,19 @@
 #include <maya/MMatrix.h>
 #include <maya/MSelectionList.h>
 #include <maya/MItSelectionList.h>
+#include <maya/MPlugArray.h>
+#include <maya/MComputation.h>
 
 #include "idebug.h"
 #include "mstatusext.h"
 #include "imocapdatabvh.h"
 #include "imocapdatahtr.h"
 #include "imocapimport.h"
+#include "imocapstreamnode.h"
+#include "iclipstream.h"
+#include "ichannel.h"
+#include "iparallel.h"
+#include "imocapasync.h"
 
 using namespace std;
 using namespace imath;
@@ -51,11 +60,44 @@ using namespace imath;
 //							: or on the new created skeleton
 // float	scale			: Determine the actual size of skeletons
 // uint		rotationOrder	: The roation order of every bones
-// uint		startFrame		: The start frame of motion section
-// uint		endFrame		: The end frame of motion section
+// uint64	startFrame		: The start frame of motion section
+// uint64	endFrame		: The end frame of motion section
 //							  ( value 0x80000000 for the whole section )
+// double	frameTime		: Resample motion at the interval (second),
+//							  0 for the rate of the file; frames above
+//							  count at this rate
+// bool		stream			: Drive joints by a stream node reading a clip
+//							  file instead of baking keys
+// string	clipFolder		: Folder of clip files, empty for the data
+//							  folder of the project (or the temporary
+//							  folder of the user when it is read-only)
+// bool		eulerFilter		: Remove flips and wraps of rotations
+// bool		reduce			: Keep only the keys needed to stay within
+//							  the tolerances below (linear tangents)
+// double	rotationTolerance	: Maximal error of rotations (degree)
+// double	translationTolerance: Maximal error of translations (cm)
+// uint		threads			: Threads working on an import, 0 for one
+//							  per processor
+// double	memoryBudget	: Memory the motion of a file may take (MB),
+//							  0 for no limit
+// bool		outOfCore		: Spill motion over the budget to a temporary
+//							  file instead of refusing the file
+// string	spillFolder		: Folder of the spill file, empty for the
+//							  temporary folder of the system
+// bool		async			: Load the file in the background and create
+//							  joints on idle events (import only)
+// string	trace			: Record the import and write a Chrome trace
+//							  (JSON) to the path, empty for none
+// bool		report			: Write timings and rates of the import as
+//							  JSON beside the mocap file (.report.json)
 ///////////////////////////////////////////////////////////////////////////////
 
+// Attributes of joints for channels
+static const char *const channelAttributes[Channel::MC_CH_COUNT] = {
+	"translateX", "translateY", "translateZ",
+	"rotateX", "rotateY", "rotateZ"
+};
+
 // To keep compatibility with Mac OSX
 #if defined (OSMac_CFM_)
 #	define USING_MAC_CORE_LIB 1
@@ -75,6 +117,21 @@ using namespace imath;
 extern "C" int strcasecmp (const char *, const char *);
 #endif
 
+// Report of the last import
+iImportReport imocapImport::lastReport;
+
+///////////////////////////////////////////////////////////////////////////////
+// progress of loads in the main thread, cancelled by the Esc key
+//
+class imyInterrupt : public iProgress {
+public:
+	imyInterrupt() { computation.beginComputation(); }
+	virtual ~imyInterrupt() { computation.endComputation(); }
+	virtual bool update(double /*done*/) { return !computation.isInterruptRequested(); }
+private:
+	MComputation computation;
+};
+
 //-----------------------------------------------------------------------------
 // constructor
 //-----------------------------------------------------------------------------
@@ -163,14 +220,62 @@ MStatus imocapImport::reader(
 				paramBlock.rotationOrder = Rotation::getOrderFromString(order);
 				ILOG2("Gotta param 'rotationOrder' = " << paramBlock.rotationOrder);
 			} else if (theOption[0] == "startFrame") {
-				paramBlock.startFrame = theOption[1].asUnsigned();
+				paramBlock.startFrame = fromString<iFrameCount>(theOption[1].asChar());
 				ILOG2("Gotta param 'startFrame' = " << paramBlock.startFrame);
 			} else if (theOption[0] == "endFrame") {
-				paramBlock.endFrame = theOption[1].asUnsigned();
+				paramBlock.endFrame = fromString<iFrameCount>(theOption[1].asChar());
 				ILOG2("Gotta param 'endFrame' = " << paramBlock.endFrame);
+			} else if (theOption[0] == "frameTime") {
+				paramBlock.frameTime = theOption[1].asDouble();
+				ILOG2("Gotta param 'frameTime' = " << paramBlock.frameTime);
+			} else if (theOption[0] == "stream") {
+				paramBlock.stream = (theOption[1].toLowerCase() == "true");
+				ILOG2("Gotta param 'stream' = " << paramBlock.stream);
+			} else if (theOption[0] == "clipFolder") {
+				paramBlock.clipFolder = theOption[1];
+				ILOG2("Gotta param 'clipFolder' = " << paramBlock.clipFolder);
+			} else if (theOption[0] == "eulerFilter") {
+				paramBlock.eulerFilter = (theOption[1].toLowerCase() == "true");
+				ILOG2("Gotta param 'eulerFilter' = " << paramBlock.eulerFilter);
+			} else if (theOption[0] == "reduce") {
+				paramBlock.reduce = (theOption[1].toLowerCase() == "true");
+				ILOG2("Gotta param 'reduce' = " << paramBlock.reduce);
+			} else if (theOption[0] == "rotationTolerance") {
+				paramBlock.rotationTolerance = theOption[1].asDouble();
+				ILOG2("Gotta param 'rotationTolerance' = " << paramBlock.rotationTolerance);
+			} else if (theOption[0] == "translationTolerance") {
+				paramBlock.translationTolerance = theOption[1].asDouble();
+				ILOG2("Gotta param 'translationTolerance' = " << paramBlock.translationTolerance);
+			} else if (theOption[0] == "threads") {
+				paramBlock.threads = theOption[1].asUnsigned();
+				ILOG2("Gotta param 'threads' = " << paramBlock.threads);
+			} else if (theOption[0] == "memoryBudget") {
+				paramBlock.memoryBudget = theOption[1].asDouble();
+				ILOG2("Gotta param 'memoryBudget' = " << paramBlock.memoryBudget);
+			} else if (theOption[0] == "outOfCore") {
+				paramBlock.outOfCore = (theOption[1].toLowerCase() == "true");
+				ILOG2("Gotta param 'outOfCore' = " << paramBlock.outOfCore);
+			} else if (theOption[0] == "spillFolder") {
+				paramBlock.spillFolder = theOption[1];
+				ILOG2("Gotta param 'spillFolder' = " << paramBlock.spillFolder);
+			} else if (theOption[0] == "async") {
+				paramBlock.async = (theOption[1].toLowerCase() == "true");
+				ILOG2("Gotta param 'async' = " << paramBlock.async);
+			} else if (theOption[0] == "trace") {
+				paramBlock.trace = theOption[1];
+				ILOG2("Gotta param 'trace' = " << paramBlock.trace);
+			} else if (theOption[0] == "report") {
+				paramBlock.report = (theOption[1].toLowerCase() == "true");
+				ILOG2("Gotta param 'report' = " << paramBlock.report);
 			}
 		}
 
+		// All parallel stages share the pool of the plug-in
+		startPool(paramBlock.threads);
+
+		// Events before this are of no interest, a running import keeps its trace
+		if (paramBlock.trace.length() > 0 && !imyAsyncImport::isRunning()) startTrace();
+
 		// Who can tell me how to obtain the default namespace??
 		{
 			//myNamespace = "Reference";
@@ -183,8 +288,19 @@ MStatus imocapImport::reader(
 		}
 
 
+		// Maya stays responsive, joints are created later on idle events
+		if (paramBlock.async && mode != kOpenAccessMode) {
+#			if defined (OSMac_)
+				MString mocapFilename(osxFilename);
+#			else
+				MString mocapFilename(filename);
+#			endif
+			return imyAsyncImport::start(mocapFilename, paramBlock, myNamespace);
+		}
+
 		//MGlobal::displayInfo("Don't disturb me. I'm working...");
-		clock_t time = clock();
+		const double time = getWallTime();
+		lastReport.clear();
 
 		// To keep compatibility with Mac OSX
 #		if defined (OSMac_)
@@ -193,8 +309,13 @@ MStatus imocapImport::reader(
 			stat = importMocapFile(filename, (mode == kOpenAccessMode));
 #		endif
 
+		if (paramBlock.trace.length() > 0) {
+			stopTrace();
+			writeTrace(paramBlock.trace);
+		}
+		closeReport(lastReport, paramBlock, getWallTime() - time, stat);
+
 		if (!stat.error()) {
-			//MGlobal::displayInfo(MString("Elapsed time : ") + ((static_cast<float>(clock()) - time) / CLOCKS_PER_SEC) + "s");
 			MGlobal::displayInfo("Mocap file has been imported. Enjoy it pls.");
 			ILOG2 (horizontalLine);
 			ILOG2 (" Mission accomplished");
@@ -215,8 +336,8 @@ MStatus imocapImport::reader(
 //-----------------------------------------------------------------------------
 MPxFileTranslator::MFileKind imocapImport::identifyFile(
 	const MFileObject& fileName,
-	const char* buffer,
-	short size
+	const char* /*buffer*/,
+	short /*size*/
 ) const
 {
 	MString filename(fileName.name());
@@ -239,7 +360,7 @@ MPxFileTranslator::MFileKind imocapImport::identifyFile(
 //-----------------------------------------------------------------------------
 // Recognition
 //-----------------------------------------------------------------------------
-imocapImport::MC_FILE_TYPE imocapImport::recognition(MString filename) const
+imocapImport::MC_FILE_TYPE imocapImport::recognition(MString filename)
 {
 	const int len = filename.length() - 1;
 	const int pos = filename.rindex('.');
@@ -270,62 +391,147 @@ imocapImport::MC_FILE_TYPE imocapImport::recognition(MString filename) const
 MStatus imocapImport::importMocapFile(const MString filename, const bool isOpen)
 {
     MS_ENTRANCE	// Entry for critical zone
+	ITRACE_SCOPE("import");
+
+	// perparing for importion
+	iSkeleton skel;
+	int result;
+	{
+		imyInterrupt interrupt;
+		result = loadMocapFile(filename, skel, &lastReport, &interrupt, paramBlock.memoryBudget,
+			paramBlock.outOfCore, paramBlock.spillFolder.asChar());
+	}
+	if (MC_CANCELLED == result) {
+		MGlobal::displayWarning("Import of the mocap file was cancelled.");
+	}
+	if (MC_OUT_OF_MEMORY == result) {
+		MGlobal::displayError("Motion of the mocap file is over the memory budget.");
+	}
+	if (result != MC_SUCCESS) {
+		MS_CHECK(MStatus::kFailure);
+	}
 
-	const MC_FILE_TYPE type = recognition(filename);
+	MS_CHECK(rebuildSkeleton(skel, isOpen));
 
-	if (type != MC_FT_UNKNOWN) {
-	
-		ifstream fileMocap(filename.asChar());
-		if (fileMocap) {
-			// perparing for importion
-			iSkeleton skel;
-			iMocapData *dataMocap = NULL;
-
-			switch (type) {
-			case MC_FT_BVH:
-				ILOG1 ("Importing a BVH file...");
-				dataMocap = new iMocapDataBvh(&fileMocap, &skel);
-				break;
-			case MC_FT_HTR:
-				ILOG1 ("Importing a HTR file...");
-				dataMocap = new iMocapDataHtr(&fileMocap, &skel);
-				break;
-			default:
-				ILOG4 ("Error: More file type will be supported in the future...");
-				fileMocap.close();
-				MS_CHECK(MStatus::kFailure);
-				break;
-			}
+	MS_EXIT		// Exit for emergency
+	MS_RETURN	// Return for emergency
+}
 
-			if (dataMocap->load() != MC_SUCCESS) {
-				ILOG4 ("Error: load failed!");
-				// delete imocapData object
-				if (!dataMocap) {
-					delete dataMocap;
-					dataMocap = NULL;
-				}
-				fileMocap.close();
-				MS_CHECK(MStatus::kFailure);
-			} else {
-				ILOG2 ("load ok!");
-			}
-			// delete imocapData object
-			if (!dataMocap) {
-				delete dataMocap;
-				dataMocap = NULL;
-			}
-			fileMocap.close();
-				
-			MS_CHECK(rebuildSkeleton(skel, isOpen));
+//-----------------------------------------------------------------------------
+// loadMocapFile
+//-----------------------------------------------------------------------------
+int imocapImport::loadMocapFile(const MString filename, iSkeleton &skel, iImportReport *report,
+	iProgress *progress, double memoryBudget, bool outOfCore, const string &spillFolder)
+{
+	ITRACE_SCOPE("load");
+	if (NULL != report) {
+		report->file = filename.asChar();
+		report->result = MC_INVALID_STREAM;
+	}
+
+	ifstream fileMocap;
+	MC_FILE_TYPE type;
+	{
+		iPhaseTimer timer(report, "open");
+		type = recognition(filename);
+		if (MC_FT_UNKNOWN == type) {
+			ILOG4 ("Error: Unknown file type...");
+			return MC_INVALID_STREAM;
 		}
 
+		fileMocap.open(filename.asChar());
+		if (!fileMocap) {
+			ILOG4 ("Error: Cannot open the file");
+			return MC_INVALID_STREAM;
+		}
+
+		// size of the file for the rates
+		if (NULL != report) {
+			fileMocap.seekg(0, ios::end);
+			report->bytes = static_cast<double>(fileMocap.tellg());
+			fileMocap.seekg(0, ios::beg);
+		}
+	}
+
+	iMocapData *dataMocap = NULL;
+	switch (type) {
+	case MC_FT_BVH:
+		ILOG1 ("Importing a BVH file...");
+		dataMocap = new iMocapDataBvh(&fileMocap, &skel);
+		break;
+	case MC_FT_HTR:
+		ILOG1 ("Importing a HTR file...");
+		dataMocap = new iMocapDataHtr(&fileMocap, &skel);
+		break;
+	default:
+		ILOG4 ("Error: More file type will be supported in the future...");
+		return MC_INVALID_STREAM;
+	}
+
+	// over the budget, motion is either refused or spilled to a file; the
+	// spill budget is the process's, so it is given back after the load
+	const double budget = memoryBudget * 1024.0 * 1024.0;
+	double lastBudget;
+	string lastFolder;
+	getSpillBudget(lastBudget, lastFolder);
+	setSpillBudget(outOfCore ? budget : 0.0, spillFolder);
+	dataMocap->setProgress(progress);
+	dataMocap->setMemoryBudget(outOfCore ? 0.0 : budget);
+	const int result = dataMocap->load(report);
+	setSpillBudget(lastBudget, lastFolder);
+	if (result != MC_SUCCESS) {
+		ILOG4 ("Error: load failed!");
 	} else {
-		ILOG4 ("Error: Unknown file type...");
-		MS_CHECK(MStatus::kFailure);
+		ILOG2 ("load ok!");
+	}
+	if (NULL != report) {
+		report->result = result;
+		report->joints = skel.countJoints();
+		report->frames = skel.getFrames();
+		iMemoryUse use;
+		skel.measureMemory(use);
+		report->noteMemory(use);
 	}
+	delete dataMocap;
+	fileMocap.close();
 
-	MS_EXIT		// Exit for emergency
-	MS_RETURN	// Return for emergency
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+// writeTrace
+//-----------------------------------------------------------------------------
+void imocapImport::writeTrace(const MString &path)
+{
+	if (writeChromeTrace(path.asChar()) == MC_SUCCESS) {
+		MGlobal::displayInfo("Trace of the import has been written to " + path);
+	} else {
+		MGlobal::displayWarning("Cannot write trace file " + path);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// closeReport
+//-----------------------------------------------------------------------------
+void imocapImport::closeReport(iImportReport &report, const imocapParam &param, double seconds, const MStatus &stat)
+{
+	report.seconds = seconds;
+	report.peakMemory = getPeakMemory();
+	if (stat.error() && MC_SUCCESS == report.result) report.result = MC_FATAL_ERROR;
+	if (&report != &lastReport) lastReport = report;
+
+	MString held = MString("Elapsed time : ") + seconds + "s, memory held : "
+		+ report.memory.getTotal() / 1048576.0 + "MB";
+	if (report.memory.spilled > 0.0) {
+		held += MString(" (") + report.memory.spilled / 1048576.0 + "MB spilled)";
+	}
+	MGlobal::displayInfo(held);
+	if (param.report && report.file.size() > 0) {
+		const MString path = MString(report.file.c_str()) + ".report.json";
+		if (report.write(path.asChar()) != MC_SUCCESS) {
+			MGlobal::displayWarning("Cannot write report file " + path);
+		}
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -335,6 +541,105 @@ MStatus imocapImport::rebuildSkeleton(iSkeleton &skel, const bool isOpen)
 {
     MS_ENTRANCE	// Entry for critical zone
 
+	imyCallbackData data;
+	MDGModifier dgMod;
+	data.myNamespace = myNamespace;
+	data.dgModifier = &dgMod;
+	data.report = &lastReport;
+
+	MS_CHECK(captureScene(paramBlock, isOpen, data));
+	MS_CHECK(prepareRebuild(skel, paramBlock, data));
+	MS_CHECK(beginRebuild(skel, data));
+
+	// Start rebuilding...
+	{
+		ITRACE_SCOPE("rebuild");
+		imySkeletonVisitor visitor(data);
+		skel.traverse(visitor);
+	}
+	MS_CHECK(data.result)
+
+	MS_CHECK(endRebuild(data));
+
+	MS_EXIT		// Exit for emergency
+	MS_RETURN	// Return for emergency
+}
+
+//-----------------------------------------------------------------------------
+// captureScene
+//-----------------------------------------------------------------------------
+MStatus imocapImport::captureScene(const imocapParam &param, const bool isOpen, imyCallbackData &data)
+{
+    MS_ENTRANCE	// Entry for critical zone
+
+	data.onlyBones	= param.bonesOnly;
+	data.injection	= param.merge;
+	data.proportion	= param.scale;
+	data.clipFolder	= param.clipFolder;
+
+	// Get current time or...
+	//
+	if (!isOpen) {
+		data.currentTime = MAnimControl::currentTime();
+	} else {
+		data.injection = false;	// It's impossible!
+	}
+
+	// Import Bones Only Mode is prefered !!!
+	if (data.onlyBones) {
+		ILOG1(">>> Into Bones Only Mode...");
+		data.injection = false;
+	} else {
+		ILOG1(">>> Into Normal Mode...");
+	}
+
+	// Get selection
+    if (data.injection) {
+		ILOG1(">>> Into Merge Mode...");
+
+		data.onlyBones = false;	// It's impossible!
+
+		MSelectionList selection;
+		MS_CHECK(MGlobal::getActiveSelectionList(selection));
+		MItSelectionList iter(selection, MFn::kJoint);
+		//for ( ; !iter.isDone(); iter.next()) {
+		//}
+		// Only one selection is needed
+		if (!iter.isDone()) {
+			MS_CHECK(iter.getDagPath(data.dagPath));
+			ILOG2("We gotta the selection!");
+		} else {
+			ILOG4("Error: No joint was selected");
+			MGlobal::displayError("You should select the root joint firstly!");
+			MS_CHECK(MStatus::kInvalidParameter);
+		}
+	}
+
+	MS_EXIT		// Exit for emergency
+	MS_RETURN	// Return for emergency
+}
+
+//-----------------------------------------------------------------------------
+// checkCancel
+//-----------------------------------------------------------------------------
+static MStatus checkCancel(iCancelFlag *cancel)
+{
+	if (NULL != cancel && cancel->isCancelled()) {
+		ILOG1 ("Preparation of the rebuild cancelled");
+		return MStatus::kFailure;
+	}
+	return MStatus::kSuccess;
+}
+
+//-----------------------------------------------------------------------------
+// prepareRebuild
+//-----------------------------------------------------------------------------
+MStatus imocapImport::prepareRebuild(iSkeleton &skel, const imocapParam &param, imyCallbackData &data,
+	iCancelFlag *cancel)
+{
+    MS_ENTRANCE	// Entry for critical zone
+	iPhaseTimer timer(data.report, "conversion");
+
 	if (skel.empty()) {
 		ILOG4 ("Error: Skeleton is empty");
 		MS_CHECK(MStatus::kInvalidParameter);
@@ -346,145 +651,470 @@ MStatus imocapImport::rebuildSkeleton(iSkeleton &skel, const bool isOpen)
 	ILOG2 (" Skeleton & Animation Rebuilding...");
 	ILOG2 (horizontalLine);
 
-	imyCallbackData data;
-	iSkeleton::iJoint *jot;
-	
 	skel.goTop();
-	if ((jot = skel.getJoint()) == NULL) {
+	if (skel.getJoint() == NULL) {
 		ILOG4 ("Error: Internal error");
 		MS_CHECK(MStatus::kInvalidParameter);
 	}
 	
 	// Prepare for callback data
 	//
-	data.myNamespace = myNamespace;
 	data.haveTranslation = skel.getHaveTranslation();
 
-	data.onlyBones	= paramBlock.bonesOnly;
-	data.injection	= paramBlock.merge;
-	data.proportion	= paramBlock.scale;
-
-	if (Rotation::MC_RO_NONE == paramBlock.rotationOrder) {
+	if (Rotation::MC_RO_NONE == param.rotationOrder) {
 		data.order = skel.getRotOrder();
 	} else {
-		data.order = paramBlock.rotationOrder;
+		// Re-express rotations instead of relabeling them
+		data.order = param.rotationOrder;
+		if (skel.convertRotOrder(data.order, 0, cancel) != MC_SUCCESS) {
+			ILOG4 ("Error: Cannot convert rotation order");
+			MS_CHECK(MStatus::kInvalidParameter);
+		}
 	}
 	ILOG2("Rotation order = " << data.order);
+	MS_CHECK(checkCancel(cancel));
 
-	// Assign variable 'frameBegin'
-	if (IM_INT_DEFAULT == paramBlock.startFrame) {
+	// Assign variable 'frameBegin', in frames of the file
+	if (IM_INT_DEFAULT == param.startFrame) {
 		data.frameBegin = 0;
 	} else {
-		data.frameBegin = paramBlock.startFrame;
+		data.frameBegin = param.startFrame;
 	}
-	ILOG2("Start frame = " << data.frameBegin);
 
 	// Assign variable 'frames'
-	unsigned int n = skel.getFrames();
-	if (IM_INT_DEFAULT == paramBlock.endFrame) {
+	const iFrameCount n = skel.getFrames();
+	if (IM_INT_DEFAULT == param.endFrame) {
 		data.frameEnd = n;
 	} else {
-		if (paramBlock.endFrame > n) {
+		if (param.endFrame > n) {
 			data.frameEnd = n;
 		} else {
-			data.frameEnd = paramBlock.endFrame;
+			data.frameEnd = param.endFrame;
+		}
+	}
+
+	// Resample instead of stretching keys, so that the take keeps its length,
+	// only the range is resampled and it is all that is left
+	if (IM_DOUBLE_DEFAULT != param.frameTime && !data.onlyBones && data.frameBegin < data.frameEnd) {
+		ILOG1(">>> Resampling motion...");
+		if (skel.resample(param.frameTime, data.frameBegin, data.frameEnd, 0, cancel) != MC_SUCCESS) {
+			ILOG4 ("Error: Cannot resample motion");
+			MS_CHECK(MStatus::kInvalidParameter);
 		}
+		data.frameBegin = 0;
+		data.frameEnd = skel.getFrames();
 	}
+	ILOG2("Start frame = " << data.frameBegin);
 	ILOG2("End frame = " << data.frameEnd);
 
 	// Assign variable 'interval'
-	if (IM_DOUBLE_DEFAULT == paramBlock.frameTime) {
-		data.interval = skel.getFrameTime();
-	} else {
-		data.interval = paramBlock.frameTime;
-	}
+	data.interval = skel.getFrameTime();
 	ILOG2("Frame time = " << data.interval);
+	MS_CHECK(checkCancel(cancel));
 
-	// Get current time or...
-	//
-	if (!isOpen) {
-		data.currentTime = MAnimControl::currentTime();
-	} else {
-		data.injection = false;	// It's impossible!
+	// Flips of rotations would be interpolated the long way round
+	if (param.eulerFilter && !data.onlyBones) {
+		ILOG1(">>> Filtering rotations...");
+		if (skel.filterRotations(0, cancel) != MC_SUCCESS) {
+			ILOG4 ("Error: Cannot filter rotations");
+			MS_CHECK(MStatus::kInvalidParameter);
+		}
 	}
 
-	// Import Bones Only Mode is prefered !!!
-	if (data.onlyBones) {
-		ILOG1(">>> Into Bones Only Mode...");
-		data.injection = false;
-	} else {
-		ILOG1(">>> Into Normal Mode...");
-	}
+	MS_CHECK(checkCancel(cancel));
 
-	// Get selection
-    if (data.injection) {
-		ILOG1(">>> Into Merge Mode...");
+	// Streaming or baking keys
+	data.streaming = param.stream && !data.onlyBones;
 
-		data.onlyBones = false;	// It's impossible!
+	// Reduce keys of all channels before baking them
+	data.reducing = param.reduce && !data.onlyBones && !data.streaming;
+	if (data.reducing) {
+		ILOG1(">>> Into Reduction Mode...");
+		data.rotationTolerance = param.rotationTolerance;
+		data.translationTolerance = param.translationTolerance;
+		if (reduceMotion(skel, &data, cancel) != MC_SUCCESS) {
+			ILOG4 ("Error: Cannot reduce keys");
+			MS_CHECK(MStatus::kFailure);
+		}
+	}
 
-		MSelectionList selection;
-		MS_CHECK(MGlobal::getActiveSelectionList(selection));
-		MItSelectionList iter(selection, MFn::kJoint);
-		//for ( ; !iter.isDone(); iter.next()) {
-		//}
-		// Only one selection is needed
-		if (!iter.isDone()) {
-			MS_CHECK(iter.getDagPath(data.dagPath));
-			ILOG2("We gotta the selection!");
-		} else {
-			ILOG4("Error: No joint was selected");
-			MGlobal::displayError("You should select the root joint firstly!");
-			MS_CHECK(MStatus::kInvalidParameter);
+	// Memory held once converted, reduced keys included
+	if (NULL != data.report) {
+		iMemoryUse use;
+		skel.measureMemory(use);
+		use.caches += data.keyLists.capacity() * sizeof(iKeyList);
+		for (unsigned int i = 0; i < data.keyLists.size(); ++i) {
+			use.caches += data.keyLists[i].capacity() * sizeof(iKeyList::value_type);
 		}
+		data.report->noteMemory(use);
 	}
-    
+
+	MS_EXIT		// Exit for emergency
+	MS_RETURN	// Return for emergency
+}
+
+//-----------------------------------------------------------------------------
+// beginRebuild
+//-----------------------------------------------------------------------------
+MStatus imocapImport::beginRebuild(iSkeleton &skel, imyCallbackData &data)
+{
+    MS_ENTRANCE	// Entry for critical zone
+	ITRACE_SCOPE("begin");
+
+	// Tables of handles
+	data.joints.assign(skel.countJoints(), MObject::kNullObj);
+	data.created.clear();
+	if (!data.onlyBones) {
+		data.curves.assign(skel.countJoints() * Channel::MC_CH_COUNT, MObject::kNullObj);
+	}
+
+	if (data.streaming) {
+		ILOG1(">>> Into Stream Mode...");
+		MS_CHECK(createStreamNode(skel, &data));
+	}
+
 	data.result = MStatus::kSuccess;
-	// Start rebuilding...
-	jot->preOrder(skeletonCallback, &data);
-	MS_CHECK(data.result)
+	data.curvesSaved = data.keysSaved = data.keysReduced = 0;
+	data.keysSet = 0.0;
+
+	MS_EXIT		// Exit for emergency
+	MS_RETURN	// Return for emergency
+}
+
+//-----------------------------------------------------------------------------
+// endRebuild
+//-----------------------------------------------------------------------------
+MStatus imocapImport::endRebuild(imyCallbackData &data)
+{
+    MS_ENTRANCE	// Entry for critical zone
+	ITRACE_SCOPE("end");
+
+	// Report constant channels which have been set statically
+	if (data.curvesSaved > 0) {
+		ILOG2("Constant channels : " << data.curvesSaved << " curves, " << data.keysSaved << " keys saved");
+		MGlobal::displayInfo(MString("Constant channels set statically : ")
+			+ data.curvesSaved + " curves and " + toString(data.keysSaved).c_str() + " keys saved.");
+	}
+	if (data.reducing) {
+		ILOG2("Key reduction : " << data.keysReduced << " keys removed");
+		MGlobal::displayInfo(MString("Key reduction : ") + toString(data.keysReduced).c_str() + " keys removed.");
+	}
+
+	// Make connections to the stream node
+	if (data.streaming) {
+		MS_CHECK(data.dgModifier->doIt());
+	}
 
 	MS_EXIT		// Exit for emergency
 	MS_RETURN	// Return for emergency
 }
 
 //-----------------------------------------------------------------------------
-// callBack
+// abortRebuild
+//-----------------------------------------------------------------------------
+void imocapImport::abortRebuild(imyCallbackData &data)
+{
+	ITRACE_SCOPE("abort");
+
+	// Latest first, joints go with the transform above them. Keys replaced
+	// on curves of existing joints are not restored.
+	for (size_t i = data.created.size(); i > 0; --i) {
+		if (data.created[i - 1].isNull()) continue;
+		if (MGlobal::deleteNode(data.created[i - 1]) != MS::kSuccess) {
+			ILOG3 ("Warning: Cannot delete a node of the import");
+		}
+	}
+	ILOG1 ("Rebuild undone, " << data.created.size() << " nodes deleted");
+	data.created.clear();
+	data.joints.assign(data.joints.size(), MObject::kNullObj);
+	data.curves.assign(data.curves.size(), MObject::kNullObj);
+	data.streamNode = MObject::kNullObj;
+
+	// Connections queued on the modifier are never made, the clip goes too
+	if (data.clipFilename.length() > 0) {
+		remove(data.clipFilename.asChar());
+		data.clipFilename = "";
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Job fitting keys of a channel
+//-----------------------------------------------------------------------------
+class imyReduceTask : public iTask {
+	iSkeleton &skel;
+	imocapImport::imyCallbackData &data;
+public:
+	imyReduceTask(iSkeleton &skobj, imocapImport::imyCallbackData &mdata) : skel(skobj), data(mdata) {}
+	void run(unsigned int idx) {
+		const unsigned int c = idx % Channel::MC_CH_COUNT;
+		iSkeleton::iNode &node = skel.getNode(idx / Channel::MC_CH_COUNT);
+		iSkeleton::iJoint *item = node.joint;
+
+		// Translations of non-root joints are not keyed in BVH files
+		if (c < Channel::MC_CH_RX && node.depth != 0 && !data.haveTranslation) return;
+
+		iFrameCount endFrame = data.frameEnd;
+		if (endFrame > item->motion.size()) {
+			endFrame = item->motion.size();
+		}
+		if (data.frameBegin >= endFrame) return;
+
+		iVec baseOffset;
+		item->getOffset(baseOffset);
+
+		vector<double> samples(static_cast<size_t>(endFrame - data.frameBegin));
+		double value[Channel::MC_CH_COUNT];
+		for (iFrameCount i = data.frameBegin; i < endFrame; ++i) {
+			getChannelValues(baseOffset, item->motion[i], data.proportion, value);
+			samples[i - data.frameBegin] = value[c];
+		}
+
+		const double tolerance = (c < Channel::MC_CH_RX) ?
+			data.translationTolerance : data.rotationTolerance;
+		reduceKeys(&samples[0], static_cast<unsigned int>(samples.size()),
+			tolerance, data.keyLists[idx]);
+	}
+};
+
+//-----------------------------------------------------------------------------
+// reduceMotion
+//-----------------------------------------------------------------------------
+int reduceMotion(iSkeleton &skel, imocapImport::imyCallbackData *mdata, iCancelFlag *cancel)
+{
+	// Channels are independent, so they are fitted in parallel
+	//
+	ITRACE_SCOPE("reduce");
+	const unsigned int count = skel.countJoints() * Channel::MC_CH_COUNT;
+	mdata->keyLists.assign(count, iKeyList());
+
+	imyReduceTask task(skel, *mdata);
+	if (!parallelFor(count, task, 0, cancel)) return MC_CANCELLED;
+	ILOG1("Keys of " << count << " channels reduced");
+
+	return MC_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Job baking keys of a joint
+//-----------------------------------------------------------------------------
+class imyBakeTask : public iTask {
+	iSkeleton &skel;
+	imocapImport::imyCallbackData &data;
+public:
+	imyBakeTask(iSkeleton &skobj, imocapImport::imyCallbackData &mdata) : skel(skobj), data(mdata) {}
+	void run(unsigned int idx) {
+		iSkeleton::iNode &node = skel.getNode(idx);
+		iSkeleton::iJoint *item = node.joint;
+
+		// not only root has translations in HTR files
+		const bool translated = (node.depth == 0 || data.haveTranslation);
+		const unsigned int firstChannel = translated ? Channel::MC_CH_TX : Channel::MC_CH_RX;
+		const unsigned int base = idx * Channel::MC_CH_COUNT;
+
+		iFrameCount endFrame = data.frameEnd;
+		if (endFrame > item->motion.size()) {
+			endFrame = item->motion.size();
+		}
+
+		iVec baseOffset;
+		item->getOffset(baseOffset);
+		const MTime frameTime(data.interval, MTime::kSeconds);
+		double value[Channel::MC_CH_COUNT];
+		unsigned int c;
+
+		imyKeyBlock *blocks = &data.keyBlocks[base * data.keyBlockCount];
+		for (unsigned int b = 0; b < data.keyBlockCount; ++b) {
+			imyKeyBlock *keys = blocks + b * Channel::MC_CH_COUNT;
+			const iFrameCount first = data.frameBegin + static_cast<iFrameCount>(b) * data.keyFrames;
+			if (first >= endFrame) break;
+			const iFrameCount last = (endFrame - first < data.keyFrames) ? endFrame : first + data.keyFrames;
+
+			if (data.reducing) {
+				// Only the fitted keys within the block
+				for (c = firstChannel; c < Channel::MC_CH_COUNT; ++c) {
+					const iKeyList &fitted = data.keyLists[base + c];
+					iKeyList::const_iterator k = lower_bound(fitted.begin(), fitted.end(), first - data.frameBegin);
+					iKeyList::const_iterator end = lower_bound(k, fitted.end(), last - data.frameBegin);
+					const unsigned int n = static_cast<unsigned int>(end - k);
+					keys[c].times.setLength(n);
+					keys[c].values.setLength(n);
+					for (unsigned int i = 0; i < n; ++i, ++k) {
+						getChannelValues(baseOffset, item->motion[data.frameBegin + *k], data.proportion, value);
+						keys[c].times[i] = data.currentTime + frameTime * static_cast<double>(*k);
+						keys[c].values[i] = value[c];
+					}
+				}
+				continue;
+			}
+
+			const unsigned int n = static_cast<unsigned int>(last - first);
+			for (c = firstChannel; c < Channel::MC_CH_COUNT; ++c) {
+				keys[c].times.setLength(n);
+				keys[c].values.setLength(n);
+			}
+			for (unsigned int i = 0; i < n; ++i) {
+				getChannelValues(baseOffset, item->motion[first + i], data.proportion, value);
+				const MTime time = data.currentTime + frameTime * static_cast<double>(first + i - data.frameBegin);
+				for (c = firstChannel; c < Channel::MC_CH_COUNT; ++c) {
+					keys[c].times[i] = time;
+					keys[c].values[i] = value[c];
+				}
+			}
+		}
+	}
+};
+
+//-----------------------------------------------------------------------------
+// bakeKeys
+//-----------------------------------------------------------------------------
+int bakeKeys(iSkeleton &skel, imocapImport::imyCallbackData *mdata, unsigned int frames,
+	iCancelFlag *cancel)
+{
+	// Values & times of keys are worked out away from the main thread, which
+	// then only sets them by blocks of frames
+	//
+	ITRACE_SCOPE("bake");
+	const unsigned int count = skel.countJoints();
+	const iFrameCount total = (mdata->frameBegin < mdata->frameEnd) ? mdata->frameEnd - mdata->frameBegin : 0;
+	mdata->keyFrames = (frames > 0) ? frames : 1;
+	mdata->keyBlockCount = (total > 0) ? static_cast<unsigned int>((total + mdata->keyFrames - 1) / mdata->keyFrames) : 1;
+	mdata->keyBlocks.assign(count * mdata->keyBlockCount * Channel::MC_CH_COUNT, imyKeyBlock());
+
+	imyBakeTask task(skel, *mdata);
+	if (!parallelFor(count, task, 0, cancel)) return MC_CANCELLED;
+	ILOG1("Keys of " << count << " joints baked in " << mdata->keyBlockCount << " blocks");
+
+	return MC_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// getClipFolders
 //-----------------------------------------------------------------------------
-void skeletonCallback(iSkeleton::iJoint *item, iSkeleton::iJoint::icallbackData *data)
+static void getClipFolders(const MString &option, MStringArray &folders)
+{
+	// The folder of the option first
+	if (option.length() > 0) folders.append(option);
+
+	// Then the data folder of the project
+	MString folder;
+	if (MGlobal::executeCommand("workspace -query -rootDirectory", folder) == MS::kSuccess &&
+		folder.length() > 0) {
+		MGlobal::executeCommand("sysFile -makeDir \"" + folder + "data\"");
+		folders.append(folder + "data");
+	}
+
+	// The temporary folder of the user at last, capture shares may be read-only
+	if (MGlobal::executeCommand("internalVar -userTmpDir", folder) == MS::kSuccess &&
+		folder.length() > 0) {
+		folders.append(folder);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// createStreamNode
+//-----------------------------------------------------------------------------
+MStatus imocapImport::createStreamNode(iSkeleton &skel, imyCallbackData *mdata)
 {
 	MStatus stat;
-	imocapImport::imyCallbackData *mdata = dynamic_cast<imocapImport::imyCallbackData*>(data);
+	MS_ENTRANCE
+	iPhaseTimer timer(mdata->report, "clip");
 
-	if (NULL == mdata) {
-		ILOG4 ("Error: dynamic_cast failed");
-		return;
+	// Create the stream node
+	//
+	MFnDependencyNode mfnNode;
+	mdata->streamNode = mfnNode.create(imocapStreamNode::id, &stat); MS_CHECK(stat);
+	mdata->created.push_back(mdata->streamNode);
+	mfnNode.setName(mdata->myNamespace + "_stream", &stat); MS_CHECK(stat);
+
+	// Save the motion as a clip of its own, named after the node, so that
+	// imports of the same file never overwrite clips of earlier ones
+	//
+	MStringArray folders;
+	getClipFolders(mdata->clipFolder, folders);
+	mdata->clipFilename = "";
+	for (unsigned int i = 0; i < folders.length() && 0 == mdata->clipFilename.length(); ++i) {
+		const string path = iClipStream::makePath(folders[i].asChar(), mfnNode.name().asChar());
+		ILOG1("Save clip to " << path);
+		if (iClipStream::save(path, skel, mdata->frameBegin, mdata->frameEnd,
+			mdata->interval, mdata->proportion) == MC_SUCCESS) {
+			mdata->clipFilename = path.c_str();
+		}
+	}
+	if (0 == mdata->clipFilename.length()) {
+		MGlobal::displayError("Cannot write clip file of " + mfnNode.name());
+		MGlobal::deleteNode(mdata->streamNode);
+		mdata->created.pop_back();
+		mdata->streamNode = MObject::kNullObj;
+		MS_CHECK(MStatus::kFailure);
 	}
 
-	//bool injection;
-	
-	MS_ENTRANCE	// Entry for critical zone
-	MS_CHECK(mdata->result)	// Something wrong?
+	MPlug plug = mfnNode.findPlug(imocapStreamNode::clipFile, &stat); MS_CHECK(stat);
+	MS_CHECK(plug.setValue(mdata->clipFilename));
+	plug = mfnNode.findPlug(imocapStreamNode::startTime, &stat); MS_CHECK(stat);
+	MS_CHECK(plug.setValue(mdata->currentTime));
+
+	// Drive it by the scene time
+	//
+	MSelectionList list;
+	MObject timeNode;
+	MS_CHECK(list.add("time1"));
+	MS_CHECK(list.getDependNode(0, timeNode));
+	MPlug timePlug = MFnDependencyNode(timeNode).findPlug("outTime", &stat); MS_CHECK(stat);
+	plug = mfnNode.findPlug(imocapStreamNode::time, &stat); MS_CHECK(stat);
+	MS_CHECK(mdata->dgModifier->connect(timePlug, plug));
+
+	MS_EXIT
+	MS_RETURN
+}
+
+//-----------------------------------------------------------------------------
+// rebuildNode
+//-----------------------------------------------------------------------------
+MStatus rebuildNode(iSkeleton::iNode &node, unsigned int idx, imocapImport::imyCallbackData *mdata)
+{
+	mdata->level = node.depth;
+	mdata->jointIndex = idx;
+	mdata->parentIndex = node.parent;
+	return rebuildJoint(node.joint, mdata);
+}
+
+//-----------------------------------------------------------------------------
+// rebuildJoint
+//-----------------------------------------------------------------------------
+MStatus rebuildJoint(iSkeleton::iJoint *item, imocapImport::imyCallbackData *mdata)
+{
+	MStatus stat;
+	ILOG1 ("Visit joint " << item->getName() << " @ level " << mdata->getLevel());
 
+	MS_ENTRANCE	// Entry for critical zone
 
 	// To create or seek the joint
 	MObject joint;
+	bool animate = false;
 	if (mdata->injection) {
 		ILOG1("Seek the joint...");
-		if (!mdata->onlyBones && seekJoint(item, mdata, joint) == MStatus::kSuccess) {
-			// To animate the joint
-			MS_CHECK(animateJoint(item, mdata, joint));
-		}
+		iPhaseTimer timer(mdata->report, "joints");
+		animate = !mdata->onlyBones && seekJoint(item, mdata, joint) == MStatus::kSuccess;
 	} else {
 		ILOG1("Create the joint...");
+		iPhaseTimer timer(mdata->report, "joints");
 		MS_CHECK(createJoint(item, mdata, joint));
-		if (!mdata->onlyBones) {
+		animate = !mdata->onlyBones;
+	}
+
+	if (animate) {
+		iPhaseTimer timer(mdata->report, "keys");
+		if (mdata->streaming) {
+			// To connect the joint to stream node
+			MS_CHECK(streamJoint(mdata, joint));
+		} else {
 			// To animate the joint
 			MS_CHECK(animateJoint(item, mdata, joint));
 		}
 	}
 
 	MS_EXIT	// Exit for emergency
-	MS_STORE(mdata->result)
+	MS_RETURN	// Return for emergency
 }
 
 //-----------------------------------------------------------------------------
@@ -496,7 +1126,10 @@ MStatus createJoint(iSkeleton::iJoint *item, imocapImport::imyCallbackData *mdat
 	MS_ENTRANCE	// Entry for critical zone
 
 	float scale = mdata->proportion;
-	unsigned int rotationOrder = Rotation::getReversedOrder(mdata->order);
+	// Every joint may have its own order (BVH channels)
+	int sourceOrder = item->getRotOrder();
+	if (!Rotation::isOrderValid(sourceOrder)) sourceOrder = mdata->order;
+	unsigned int rotationOrder = Rotation::getReversedOrder(sourceOrder);
 	// Get information of the joint
 	iVec off;
 	item->getOffset(off);
@@ -509,25 +1142,18 @@ MStatus createJoint(iSkeleton::iJoint *item, imocapImport::imyCallbackData *mdat
 		//
 		MFnTransform mfnTrans;
 		parent = mfnTrans.create(MObject::kNullObj, &stat); MS_CHECK(stat);
+		mdata->created.push_back(parent);
 		mfnTrans.setName(mdata->myNamespace, &stat); MS_CHECK(stat);
 	} else {
 		// Get the object of parent joint
-		imocapImport::imyAccessory *pacc = dynamic_cast<imocapImport::imyAccessory*>
-			((item->getFather())->getAccessory());
-		IASSERT(NULL != pacc);
-		parent = pacc->obj;
+		parent = mdata->joints[mdata->parentIndex];
 		IASSERT(MObject::kNullObj != parent);
 	}
 
 	// Create a new joint
 	MFnIkJoint mfnJoint;
 	joint = mfnJoint.create(parent, &stat); MS_CHECK(stat);
-
-	// Attach an accessory to it
-	//
-	imocapImport::imyAccessory *acc = new imocapImport::imyAccessory;
-	acc->obj = joint;
-	item->setAccessory(acc);
+	mdata->joints[mdata->jointIndex] = joint;
 
 	// STILL missing duplicated name checking
 	//
@@ -582,12 +1208,13 @@ MStatus seekJoint(iSkeleton::iJoint *item, imocapImport::imyCallbackData *mdata,
 		}
 	} else {
 		// Get the object of parent joint
-		imocapImport::imyAccessory *pacc = dynamic_cast<imocapImport::imyAccessory*>
-			((item->getFather())->getAccessory());
-		IASSERT(NULL != pacc);
-		parent = pacc->obj;
-		IASSERT(MObject::kNullObj != parent);
-		
+		parent = mdata->joints[mdata->parentIndex];
+		if (parent.isNull()) {
+			// The parent has not been found either
+			ILOG1("No parent to seek from!");
+			MS_CHECK(MStatus::kNotFound);
+		}
+
 		// Seek the joint
 		MFnIkJoint mfnParent, mfnChild;
 		MObject lastJoint;
@@ -630,11 +1257,7 @@ MStatus seekJoint(iSkeleton::iJoint *item, imocapImport::imyCallbackData *mdata,
 		}
 	}
 
-	// Attach an accessory to it
-	//
-	imocapImport::imyAccessory *acc = new imocapImport::imyAccessory;
-	acc->obj = joint;
-	item->setAccessory(acc);
+	mdata->joints[mdata->jointIndex] = joint;
 
 	MS_EXIT
 	MS_RETURN
@@ -651,71 +1274,119 @@ MStatus animateJoint(iSkeleton::iJoint *item, imocapImport::imyCallbackData *mda
 	// Get parameters from callback data block
 	float scale = mdata->proportion;
 	bool motionOffset = mdata->haveTranslation;
-	unsigned int startFrame = mdata->frameBegin;
-	unsigned int endFrame = mdata->frameEnd;
+	iFrameCount startFrame = mdata->frameBegin;
+	iFrameCount endFrame = mdata->frameEnd;
 	MTime time(mdata->currentTime);
 	MTime frameTime(mdata->interval, MTime::kSeconds);
-	MTime endTime(time + frameTime * (endFrame - startFrame));
+	MTime endTime(time + frameTime * static_cast<double>(endFrame - startFrame));
 
 	// animate skeleton
 	//
 	MFnIkJoint mfnJoint;
 	stat = mfnJoint.setObject(joint); MS_CHECK(stat);
 
-	MFnAnimCurve acRx, acRy, acRz;
-	MS_CHECK(getAnimCurve(joint, MString("rotateX"), acRx));
-	if (validate(acRx)) MS_CHECK(removeAnimCurveKeys(acRx, time, endTime));
-	MS_CHECK(getAnimCurve(joint, MString("rotateY"), acRy));
-	if (validate(acRy)) MS_CHECK(removeAnimCurveKeys(acRy, time, endTime));
-	MS_CHECK(getAnimCurve(joint, MString("rotateZ"), acRz));
-	if (validate(acRz)) MS_CHECK(removeAnimCurveKeys(acRz, time, endTime));
-
-	MFnAnimCurve acTx, acTy, acTz;
 	// not only root has translations in HTR files
 	//
-	if (mdata->getLevel() == 0 || motionOffset) {
-		// Translation curve for joints
-		//
-		MS_CHECK(getAnimCurve(joint, MString("translateX"), acTx));
-		if (validate(acTx)) MS_CHECK(removeAnimCurveKeys(acTx, time, endTime));
-		MS_CHECK(getAnimCurve(joint, MString("translateY"), acTy));
-		if (validate(acTy)) MS_CHECK(removeAnimCurveKeys(acTy, time, endTime));
-		MS_CHECK(getAnimCurve(joint, MString("translateZ"), acTz));
-		if (validate(acTz)) MS_CHECK(removeAnimCurveKeys(acTz, time, endTime));
+	const bool translated = (mdata->getLevel() == 0 || motionOffset);
+	const unsigned int firstChannel = translated ? Channel::MC_CH_TX : Channel::MC_CH_RX;
+	const unsigned int base = mdata->jointIndex * Channel::MC_CH_COUNT;
 
+	// If endFrame exceed the size of the motion clip, cut the rest
+	//
+	if (endFrame > item->motion.size()) {
+		endFrame = item->motion.size();
 	}
 
-	// Loading keyframes
+	iVec baseOffset;
+	item->getOffset(baseOffset);
+
+	// Find out channels staying still through the section
 	//
-	// If endFrame exceed the capacity of the motion clip, cut the rest
+	iChannelRange range;
+	measureChannels(item->motion, startFrame, endFrame, range);
+
+	iSkeleton::iFrame still;
+	if (range.frames > 0) {
+		still = item->motion[startFrame];
+	} else {
+		still.offset.clear();
+		still.rotation.clear();
+		still.scale = 1.0;
+	}
+	double value[Channel::MC_CH_COUNT];
+	getChannelValues(baseOffset, still, scale, value);
+
+	// Curves for channels, remembered in the table
 	//
-	if (endFrame > item->motion.capacity()) {
-		endFrame = static_cast<unsigned int>(item->motion.capacity());
+	MFnAnimCurve curves[Channel::MC_CH_COUNT];
+	unsigned int c;
+	for (c = firstChannel; c < Channel::MC_CH_COUNT; ++c) {
+		// Constant channels of free plugs are set as static values
+		MPlug plug = mfnJoint.findPlug(channelAttributes[c], &stat); MS_CHECK(stat);
+		if (!isKeyedChannel(range, c, motionThreshold, plug.isConnected())) {
+			if (c >= Channel::MC_CH_RX) {
+				MS_CHECK(plug.setValue(toRadians(value[c])));
+			} else {
+				MS_CHECK(plug.setValue(value[c]));
+			}
+			++mdata->curvesSaved;
+			mdata->keysSaved += range.frames;
+			continue;
+		}
+		MS_CHECK(getAnimCurve(joint, MString(channelAttributes[c]), curves[c], &mdata->created));
+		if (validate(curves[c])) {
+			MS_CHECK(removeAnimCurveKeys(curves[c], time, endTime));
+			mdata->curves[base + c] = curves[c].object();
+		}
 	}
-	ILOG1("Retrieving keys from " << startFrame << " to " << endFrame);
+	MS_CHECK_RELAY	// Relay the emergency
 
-	iVec baseOffset;
-	item->getOffset(baseOffset);
+	unsigned int keyedChannels = 0;
+	for (c = firstChannel; c < Channel::MC_CH_COUNT; ++c) {
+		if (validate(curves[c])) ++keyedChannels;
+	}
+
+	// Loading keyframes
+	//
+	ILOG1("Retrieving keys from " << startFrame << " to " << endFrame);
 
-	for (unsigned int i = startFrame; i < endFrame; ++i) {
-		iSkeleton::iFrame &fm = item->motion[i];
-		const iVec rot = fm.rotation;
-		if (validate(acRx)) MS_CHECK(acRx.addKeyframe(time, rot.x));
-		if (validate(acRy)) MS_CHECK(acRy.addKeyframe(time, rot.y));
-		if (validate(acRz)) MS_CHECK(acRz.addKeyframe(time, rot.z));
-//		ILOG0("Time: " << time << "\tAdd keyframe (rotation): " << rot);
-		if ((mdata->getLevel() == 0) || motionOffset) {
-			// Basic offset is useless in BVH file ?!
-			//
-			const iVec ofs = (baseOffset + fm.offset) * scale;
-			//iVec ofs = fm.offset * scale;
-			if (validate(acTx)) MS_CHECK(acTx.addKeyframe(time, ofs.x));
-			if (validate(acTy)) MS_CHECK(acTy.addKeyframe(time, ofs.y));
-			if (validate(acTz)) MS_CHECK(acTz.addKeyframe(time, ofs.z));
-//			ILOG0("\tAdd keyframe (Translation): " << ofs);
+	if (!mdata->keyBlocks.empty()) {
+		// Keys baked in the background, the first block of them; the others
+		// are set by commits of their own
+		//
+		MS_CHECK(keyJoint(mdata->jointIndex, 0, mdata));
+		if (mdata->reducing) {
+			for (c = firstChannel; c < Channel::MC_CH_COUNT; ++c) {
+				if (!validate(curves[c])) continue;
+				mdata->keysReduced += range.frames - mdata->keyLists[base + c].size();
+			}
+		}
+	} else if (mdata->reducing) {
+		// Only the fitted keys with linear tangents
+		//
+		for (c = firstChannel; c < Channel::MC_CH_COUNT; ++c) {
+			if (!validate(curves[c])) continue;
+			const iKeyList &keys = mdata->keyLists[base + c];
+			for (unsigned int k = 0; k < keys.size(); ++k) {
+				getChannelValues(baseOffset, item->motion[startFrame + keys[k]], scale, value);
+				MS_CHECK(curves[c].addKeyframe(time + frameTime * keys[k], value[c],
+					MFnAnimCurve::kTangentLinear, MFnAnimCurve::kTangentLinear));
+			}
+			MS_CHECK_RELAY	// Relay the emergency
+			mdata->keysSet += keys.size();
+			mdata->keysReduced += range.frames - keys.size();
 		}
+	} else {
+		for (iFrameCount i = startFrame; i < endFrame; ++i) {
+			getChannelValues(baseOffset, item->motion[i], scale, value);
+			for (c = firstChannel; c < Channel::MC_CH_COUNT; ++c) {
+				if (validate(curves[c])) MS_CHECK(curves[c].addKeyframe(time, value[c]));
+			}
+			MS_CHECK_RELAY	// Relay the emergency
+			mdata->keysSet += keyedChannels;
 
-		time += frameTime;
+			time += frameTime;
+		}
 	}
 
 	MS_CHECK_RELAY	// Relay the emergency
@@ -725,10 +1396,111 @@ MStatus animateJoint(iSkeleton::iJoint *item, imocapImport::imyCallbackData *mda
 	MS_RETURN
 }
 
+//-----------------------------------------------------------------------------
+// keyJoint
+//-----------------------------------------------------------------------------
+MStatus keyJoint(unsigned int idx, unsigned int block, imocapImport::imyCallbackData *mdata)
+{
+	MStatus stat;
+	MS_ENTRANCE
+
+	// Curves of the joint in the table, null for channels not keyed
+	//
+	const MFnAnimCurve::TangentType tangent = mdata->reducing ?
+		MFnAnimCurve::kTangentLinear : MFnAnimCurve::kTangentGlobal;
+	const unsigned int base = idx * Channel::MC_CH_COUNT;
+	imyKeyBlock *keys = &mdata->keyBlocks[(idx * mdata->keyBlockCount + block) * Channel::MC_CH_COUNT];
+	for (unsigned int c = 0; c < Channel::MC_CH_COUNT; ++c) {
+		if (mdata->curves[base + c].isNull() || 0 == keys[c].times.length()) continue;
+		MFnAnimCurve curve;
+		MS_CHECK(curve.setObject(mdata->curves[base + c]));
+		// Keys out of the block are kept, those of a merged curve included
+		MS_CHECK(curve.addKeys(&keys[c].times, &keys[c].values, tangent, tangent, true));
+		mdata->keysSet += keys[c].times.length();
+		keys[c].times.clear();
+		keys[c].values.clear();
+	}
+	MS_CHECK_RELAY	// Relay the emergency
+
+	MS_EXIT		// Exit for emergency
+	MS_RETURN
+}
+
+//-----------------------------------------------------------------------------
+// getChannelValues
+//-----------------------------------------------------------------------------
+void getChannelValues(const iVec &baseOffset, const iSkeleton::iFrame &fm, float scale, double *value)
+{
+	// Basic offset is useless in BVH file ?!
+	//
+	const iVec ofs = (baseOffset + iVec(fm.offset)) * scale;
+	value[Channel::MC_CH_TX] = ofs.x;
+	value[Channel::MC_CH_TY] = ofs.y;
+	value[Channel::MC_CH_TZ] = ofs.z;
+	value[Channel::MC_CH_RX] = fm.rotation.x;
+	value[Channel::MC_CH_RY] = fm.rotation.y;
+	value[Channel::MC_CH_RZ] = fm.rotation.z;
+}
+
+//-----------------------------------------------------------------------------
+// streamJoint
+//-----------------------------------------------------------------------------
+MStatus streamJoint(imocapImport::imyCallbackData *mdata, const MObject &joint)
+{
+	MStatus stat;
+	MS_ENTRANCE
+
+	MDGModifier &dgMod = *(mdata->dgModifier);
+	MFnDependencyNode mfnJoint(joint, &stat); MS_CHECK(stat);
+	MPlug output = MFnDependencyNode(mdata->streamNode).findPlug(imocapStreamNode::output, &stat); MS_CHECK(stat);
+	MPlug element = output.elementByLogicalIndex(mdata->jointIndex, &stat); MS_CHECK(stat);
+
+	// Rotation of every joints
+	//
+	MPlug dst = mfnJoint.findPlug("rotate", &stat); MS_CHECK(stat);
+	MS_CHECK(breakConnections(dst, dgMod));
+	MS_CHECK(dgMod.connect(element.child(imocapStreamNode::outRotate), dst));
+
+	// not only root has translations in HTR files
+	//
+	if (mdata->getLevel() == 0 || mdata->haveTranslation) {
+		dst = mfnJoint.findPlug("translate", &stat); MS_CHECK(stat);
+		MS_CHECK(breakConnections(dst, dgMod));
+		MS_CHECK(dgMod.connect(element.child(imocapStreamNode::outTranslate), dst));
+	}
+	ILOG1("Joint " << mfnJoint.name() << " streamed by output[" << mdata->jointIndex << "]");
+
+	MS_EXIT
+	MS_RETURN
+}
+
+//-----------------------------------------------------------------------------
+// breakConnections
+//-----------------------------------------------------------------------------
+MStatus breakConnections(const MPlug &plug, MDGModifier &modifier)
+{
+	MStatus stat;
+	MS_ENTRANCE
+
+	// Incoming connections of the plug and its children (anim curves mostly)
+	//
+	MPlugArray sources;
+	for (unsigned int i = 0; i <= plug.numChildren(); ++i) {
+		MPlug dst = (i == 0) ? plug : plug.child(i - 1, &stat); MS_CHECK(stat);
+		if (dst.connectedTo(sources, true, false, &stat) && sources.length() > 0) {
+			MS_CHECK(modifier.disconnect(sources[0], dst));
+		}
+	}
+
+	MS_EXIT
+	MS_RETURN
+}
+
 //-----------------------------------------------------------------------------
 // getAnimCurve
 //-----------------------------------------------------------------------------
-MStatus getAnimCurve(const MObject &joint, const MString attr, MFnAnimCurve &curve)
+MStatus getAnimCurve(const MObject &joint, const MString attr, MFnAnimCurve &curve,
+	imyHandleTable *created)
 {
 	MStatus stat;
 	MS_ENTRANCE
@@ -763,11 +1535,12 @@ MStatus getAnimCurve(const MObject &joint, const MString attr, MFnAnimCurve &cur
 		//	* unitlessToTime (animCurveUT)
 		//	* unitlessToUnitless (animCurveUU)
 
-		curve.create(joint, plug, MFnAnimCurve::kAnimCurveTL, NULL, &stat);
+		const MObject made = curve.create(joint, plug, MFnAnimCurve::kAnimCurveTL, NULL, &stat);
 		if (stat != MStatus::kSuccess) {
 			ILOG1("Creating Animation Curve failed");
 			MS_CHECK(MStatus::kNotFound);
 		}
+		if (NULL != created) created->push_back(made);
 	} else {
 		// Plug is connected, find out the AnimCurve node
 		MFnAnimCurve animCurve(plug, &stat);
@@ -22,15 +22,34 @@
 #include <maya/MPxFileTranslator.h>
 #include <maya/MEulerRotation.h>
 #include <maya/MTime.h>
+#include <maya/MTimeArray.h>
+#include <maya/MDoubleArray.h>
 #include <maya/MDagPath.h>
 #include <maya/MStringArray.h>
 #include <maya/MFnAnimCurve.h>
 #include <maya/MPlug.h>
+#include <maya/MDGModifier.h>
+#include <vector>
 #include "iskeleton.h"
+#include "ireduce.h"
+#include "ireport.h"
 
 #define IM_INT_DEFAULT		0x80000000L	// 2147483648L
 #define IM_DOUBLE_DEFAULT	0.0
 
+class iProgress;
+class iCancelFlag;
+
+// Maya objects indexed by joints in preorder (and channels)
+typedef std::vector<MObject> imyHandleTable;
+
+// Keys of a channel over a block of frames, baked before they are set
+struct imyKeyBlock {
+	MTimeArray times;
+	MDoubleArray values;
+};
+typedef std::vector<imyKeyBlock> imyKeyTable;
+
 inline MTransformationMatrix::RotationOrder iorderToTrOrder(int rotationOrder) {
 	MTransformationMatrix::RotationOrder order;
 	switch (rotationOrder) {
@@ -94,7 +113,6 @@ public:
 //	virtual MString defaultExtension() const;
 	virtual MString filter() const;
 
-private:
 	// Parameter block
 	class imocapParam {
 	public:
@@ -107,64 +125,158 @@ private:
 			startFrame = IM_INT_DEFAULT;
 			endFrame = IM_INT_DEFAULT;
 			frameTime = IM_DOUBLE_DEFAULT;
+			stream = false;
+			clipFolder = "";
+			eulerFilter = false;
+			reduce = false;
+			rotationTolerance = 0.01;
+			translationTolerance = 0.01;
+			threads = 0;
+			memoryBudget = 0.0;
+			outOfCore = false;
+			spillFolder = "";
+			async = false;
+			trace = "";
+			report = false;
 		}
 		bool	bonesOnly;		// Extract skeleton from mocap file only
 		bool	merge;			// Apply motion data on existing skeleton
 		float	scale;			// Determine the actual size of skeletons
 		unsigned int		rotationOrder;	// The roation order of every bones
-		unsigned int		startFrame;		// The start frame of motion section (0...n)
-		unsigned int		endFrame;		// The end frame of motion section (0...n)
+		iFrameCount		startFrame;		// The start frame of motion section (0...n)
+		iFrameCount		endFrame;		// The end frame of motion section (0...n)
 		double	frameTime;		// The interval between frames (second)
-	} paramBlock;
+		bool	stream;			// Drive joints by a stream node instead of keys
+		MString	clipFolder;		// Folder of clips (empty for the project's)
+		bool	eulerFilter;	// Remove flips of rotations before keying
+		bool	reduce;			// Keep only keys needed within tolerances
+		double	rotationTolerance;		// Maximal error of rotations (degree)
+		double	translationTolerance;	// Maximal error of translations (cm)
+		unsigned int		threads;		// Threads of parallel stages (0 for all)
+		double	memoryBudget;	// Memory of the motion (MB, 0 for no limit)
+		bool	outOfCore;		// Spill motion over the budget instead of refusing it
+		MString	spillFolder;	// Folder of the spill file (empty for the system's)
+		bool	async;			// Import in the background
+		MString	trace;			// Chrome trace of the import (empty for none)
+		bool	report;			// Write the report beside the mocap file
+	};
 
 public:
 	enum MC_FILE_TYPE { MC_FT_UNKNOWN, MC_FT_BVH, MC_FT_HTR };
 	// Callback data block
 	//
-	class imyCallbackData : public iSkeleton::iJoint::icallbackData {
+	class imyCallbackData {
 	public:
-		imyCallbackData() : icallbackData() {}
-		virtual ~imyCallbackData() {}
+		imyCallbackData() : level(0), jointIndex(0), parentIndex(-1), keyFrames(0), keyBlockCount(1),
+			report(NULL) {}
+		unsigned int getLevel() { return level; }
+		// Current joint
+		unsigned int level;			// Depth of current joint
+		unsigned int jointIndex;	// Preorder index of current joint
 		// Parameters
 		bool onlyBones;
 		bool injection;
 		float proportion;
 		unsigned int order;
-		unsigned int frameBegin;
-		unsigned int frameEnd;
+		iFrameCount frameBegin;
+		iFrameCount frameEnd;
 		double interval;
 		MTime currentTime;
 		MDagPath dagPath;
 		MString myNamespace;		// Namespace
+		MString clipFolder;			// Folder of clips, empty for the project's
+		MString clipFilename;		// Clip for streaming, named after the stream node
 		bool haveTranslation;
+		// Handles of joints & curves
+		int parentIndex;			// Preorder index of parent joint
+		imyHandleTable joints;		// One for a joint
+		imyHandleTable curves;		// Channel::MC_CH_COUNT for a joint
+		imyHandleTable created;		// Nodes made by the rebuild, deleted if it is undone
+		// Streaming
+		bool streaming;
+		MObject streamNode;
+		MDGModifier *dgModifier;
+		// Key reduction
+		bool reducing;
+		double rotationTolerance;
+		double translationTolerance;
+		std::vector<iKeyList> keyLists;	// Channel::MC_CH_COUNT for a joint
+		iFrameCount keysReduced;
+		// Keys baked in the background, Channel::MC_CH_COUNT for a block of
+		// frames of a joint, empty if they are set frame by frame
+		imyKeyTable keyBlocks;
+		unsigned int keyFrames;		// Frames of a block
+		unsigned int keyBlockCount;	// Blocks of a joint
+		// Constant channels set statically
+		unsigned int curvesSaved;
+		iFrameCount keysSaved;
+		// Keys set on curves
+		double keysSet;
+		// Phases of the import, NULL for none
+		iImportReport *report;
 		// Result
 		MStatus result;
 	};
 
-	// Accessory for joints
-	//
-	class imyAccessory : public iSkeleton::iJoint::iaccessory {
-	public:
-		MObject obj;			// Store the object of joints
-		imyAccessory() : obj(MObject::kNullObj), iaccessory() {}
-		virtual ~imyAccessory() {}
-	};
+	// Stages of an import, loading & preparing touch no Maya object
+	static MC_FILE_TYPE recognition(MString filename);
+	static int loadMocapFile(const MString filename, iSkeleton &skobj, iImportReport *report = NULL,
+		iProgress *progress = NULL, double memoryBudget = 0.0, bool outOfCore = false,
+		const std::string &spillFolder = std::string());
+	static MStatus captureScene(const imocapParam &param, const bool isOpen, imyCallbackData &data);
+	static MStatus prepareRebuild(iSkeleton &skobj, const imocapParam &param, imyCallbackData &data,
+		iCancelFlag *cancel = NULL);
+	static MStatus beginRebuild(iSkeleton &skobj, imyCallbackData &data);
+	static MStatus endRebuild(imyCallbackData &data);
+	// Undo a rebuild which has not reached its end
+	static void abortRebuild(imyCallbackData &data);
+	// Write the trace recorded by the import
+	static void writeTrace(const MString &path);
+	// Finish the report of an import and write it beside the file if wanted
+	static void closeReport(iImportReport &report, const imocapParam &param, double seconds, const MStatus &stat);
+
+	// Report of the last import
+	static iImportReport lastReport;
 
 private:
+	imocapParam paramBlock;		// Parameters of the import
 	MString myNamespace;		// Namespace
 
-	MC_FILE_TYPE recognition(MString filename) const;
 	MStatus importMocapFile(const MString filename, const bool isOpen);
 	//MStatus importBvhFile(MString filename, iSkeleton &skobj);
 	MStatus rebuildSkeleton(iSkeleton &skobj, const bool isOpen);
-	friend void skeletonCallback(iSkeleton::iJoint *item, iSkeleton::iJoint::icallbackData *data);
+	static MStatus createStreamNode(iSkeleton &skobj, imyCallbackData *mdata);
+
+};
 
+MStatus rebuildJoint(iSkeleton::iJoint *item, imocapImport::imyCallbackData *mdata);
+MStatus rebuildNode(iSkeleton::iNode &node, unsigned int idx, imocapImport::imyCallbackData *mdata);
+int reduceMotion(iSkeleton &skel, imocapImport::imyCallbackData *mdata, iCancelFlag *cancel = NULL);
+int bakeKeys(iSkeleton &skel, imocapImport::imyCallbackData *mdata, unsigned int frames,
+	iCancelFlag *cancel = NULL);
+MStatus keyJoint(unsigned int idx, unsigned int block, imocapImport::imyCallbackData *mdata);
+
+// Visitor rebuilding joints one by one in preorder
+//
+class imySkeletonVisitor {
+	imocapImport::imyCallbackData &data;
+public:
+	imySkeletonVisitor(imocapImport::imyCallbackData &mdata) : data(mdata) {}
+	void operator()(iSkeleton::iNode &node, unsigned int idx) {
+		// Something wrong?
+		if (data.result.error()) return;
+		data.result = rebuildNode(node, idx, &data);
+	}
 };
 
 MStatus createJoint(iSkeleton::iJoint *item, imocapImport::imyCallbackData *mdata,  MObject &joint);
 MStatus seekJoint(iSkeleton::iJoint *item, imocapImport::imyCallbackData *mdata, MObject &joint);
 MStatus animateJoint(iSkeleton::iJoint *item, imocapImport::imyCallbackData *mdata, const MObject &joint);
-MStatus getAnimCurve(const MObject &joint, const MString attr, MFnAnimCurve &curve);
+void getChannelValues(const imath::iVec &baseOffset, const iSkeleton::iFrame &fm, float scale, double *value);
+MStatus streamJoint(imocapImport::imyCallbackData *mdata, const MObject &joint);
+MStatus breakConnections(const MPlug &plug, MDGModifier &modifier);
+MStatus getAnimCurve(const MObject &joint, const MString attr, MFnAnimCurve &curve,
+	imyHandleTable *created = NULL);
 MStatus removeAnimCurveKeys(MFnAnimCurve &curve, const MTime &startTime, const MTime &endTime);
 
 #endif	// #define __IMOCAPIMPORT_H__
@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <sstream>
+
+#include <maya/MArgDatabase.h>
+#include <maya/MGlobal.h>
+
+#include "idebug.h"
+#include "mstatusext.h"
+#include "imocapimport.h"
+#include "imocapreport.h"
+
+const char *imocapReportCmd::commandName = "imocapReport";
+
+static const char *phaseFlag = "-p";
+static const char *phaseLongFlag = "-phase";
+static const char *memoryFlag = "-m";
+static const char *memoryLongFlag = "-memory";
+static const char *fileFlag = "-f";
+static const char *fileLongFlag = "-file";
+
+//-----------------------------------------------------------------------------
+// creator
+//-----------------------------------------------------------------------------
+void *imocapReportCmd::creator()
+{
+	return new imocapReportCmd();
+}
+
+//-----------------------------------------------------------------------------
+// newSyntax
+//-----------------------------------------------------------------------------
+MSyntax imocapReportCmd::newSyntax()
+{
+	MSyntax syntax;
+	syntax.addFlag(phaseFlag, phaseLongFlag, MSyntax::kString);
+	syntax.addFlag(memoryFlag, memoryLongFlag);
+	syntax.addFlag(fileFlag, fileLongFlag, MSyntax::kString);
+	return syntax;
+}
+
+//-----------------------------------------------------------------------------
+// doIt
+//-----------------------------------------------------------------------------
+MStatus imocapReportCmd::doIt(const MArgList &args)
+{
+	MStatus stat;
+	MS_ENTRANCE	// Entry for critical zone
+
+	MArgDatabase argData(syntax(), args, &stat); MS_CHECK(stat);
+	const iImportReport &report = imocapImport::lastReport;
+
+	if (argData.isFlagSet(phaseFlag)) {
+		MString name;
+		MS_CHECK(argData.getFlagArgument(phaseFlag, 0, name));
+		setResult(report.getPhase(name.asChar()));
+	} else if (argData.isFlagSet(memoryFlag)) {
+		setResult(report.memory.getTotal());
+	} else if (argData.isFlagSet(fileFlag)) {
+		MString path;
+		MS_CHECK(argData.getFlagArgument(fileFlag, 0, path));
+		if (report.write(path.asChar()) != MC_SUCCESS) {
+			displayError("Cannot write report file " + path);
+			MS_CHECK(MStatus::kFailure);
+		}
+	} else {
+		std::ostringstream out;
+		out.precision(15);
+		report.write(out);
+		setResult(MString(out.str().c_str()));
+	}
+
+	MS_EXIT		// Exit for emergency
+	MS_RETURN	// Return for emergency
+}
@@ -0,0 +1,43 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __IMOCAPREPORT_H__
+#define __IMOCAPREPORT_H__
+
+#define REQUIRE_IOSTREAM
+
+#include <maya/MPxCommand.h>
+#include <maya/MSyntax.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// command querying the report of the last import
+//
+// imocapReport					: the report as a JSON string
+// imocapReport -phase "keys"	: seconds of a phase
+// imocapReport -memory			: bytes held by the import at its largest
+// imocapReport -file "a.json"	: write the report to the file
+//
+class imocapReportCmd : public MPxCommand {
+public:
+	virtual MStatus doIt(const MArgList &args);
+
+	static void *creator();
+	static MSyntax newSyntax();
+
+	static const char *commandName;
+};
+
+#endif	// #ifndef __IMOCAPREPORT_H__
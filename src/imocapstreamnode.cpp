@@ -0,0 +1,191 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#define REQUIRE_IOSTREAM
+
+#include <maya/MPlug.h>
+#include <maya/MDataBlock.h>
+#include <maya/MDataHandle.h>
+#include <maya/MArrayDataHandle.h>
+#include <maya/MArrayDataBuilder.h>
+#include <maya/MFnTypedAttribute.h>
+#include <maya/MFnNumericAttribute.h>
+#include <maya/MFnUnitAttribute.h>
+#include <maya/MFnCompoundAttribute.h>
+#include <maya/MFnStringData.h>
+#include <maya/MAngle.h>
+#include <maya/MTime.h>
+
+#include "idebug.h"
+#include "mstatusext.h"
+#include "imath.hpp"
+#include "imocapstreamnode.h"
+
+using namespace imath;
+
+// an id in the range reserved for local plug-ins
+const MTypeId imocapStreamNode::id(0x00070101);
+const char *imocapStreamNode::typeName = "imocapStream";
+
+MObject imocapStreamNode::clipFile;
+MObject imocapStreamNode::time;
+MObject imocapStreamNode::startTime;
+MObject imocapStreamNode::output;
+MObject imocapStreamNode::outTranslate;
+MObject imocapStreamNode::outTranslateX;
+MObject imocapStreamNode::outTranslateY;
+MObject imocapStreamNode::outTranslateZ;
+MObject imocapStreamNode::outRotate;
+MObject imocapStreamNode::outRotateX;
+MObject imocapStreamNode::outRotateY;
+MObject imocapStreamNode::outRotateZ;
+
+//-----------------------------------------------------------------------------
+// constructor
+//-----------------------------------------------------------------------------
+imocapStreamNode::imocapStreamNode() : MPxNode()
+{
+}
+
+//-----------------------------------------------------------------------------
+// unconstructor
+//-----------------------------------------------------------------------------
+imocapStreamNode::~imocapStreamNode()
+{
+}
+
+//-----------------------------------------------------------------------------
+// creator
+//-----------------------------------------------------------------------------
+void *imocapStreamNode::creator() { return new imocapStreamNode(); }
+
+//-----------------------------------------------------------------------------
+// initialize
+//-----------------------------------------------------------------------------
+MStatus imocapStreamNode::initialize()
+{
+	MStatus stat;
+	MS_ENTRANCE
+
+	MFnTypedAttribute tAttr;
+	MFnUnitAttribute uAttr;
+	MFnNumericAttribute nAttr;
+	MFnCompoundAttribute cAttr;
+	MFnStringData sData;
+
+	// inputs
+	//
+	clipFile = tAttr.create("clipFile", "cf", MFnData::kString,
+		sData.create(MString(""), &stat), &stat); MS_CHECK(stat);
+	MS_CHECK(tAttr.setStorable(true));
+
+	time = uAttr.create("time", "tm", MFnUnitAttribute::kTime, 0.0, &stat); MS_CHECK(stat);
+	MS_CHECK(uAttr.setStorable(true));
+
+	startTime = uAttr.create("startTime", "st", MFnUnitAttribute::kTime, 0.0, &stat); MS_CHECK(stat);
+	MS_CHECK(uAttr.setStorable(true));
+
+	// outputs
+	//
+	outTranslateX = nAttr.create("outTranslateX", "otx", MFnNumericData::kDouble, 0.0, &stat); MS_CHECK(stat);
+	outTranslateY = nAttr.create("outTranslateY", "oty", MFnNumericData::kDouble, 0.0, &stat); MS_CHECK(stat);
+	outTranslateZ = nAttr.create("outTranslateZ", "otz", MFnNumericData::kDouble, 0.0, &stat); MS_CHECK(stat);
+	outTranslate = nAttr.create("outTranslate", "ot",
+		outTranslateX, outTranslateY, outTranslateZ, &stat); MS_CHECK(stat);
+
+	outRotateX = uAttr.create("outRotateX", "orx", MFnUnitAttribute::kAngle, 0.0, &stat); MS_CHECK(stat);
+	outRotateY = uAttr.create("outRotateY", "ory", MFnUnitAttribute::kAngle, 0.0, &stat); MS_CHECK(stat);
+	outRotateZ = uAttr.create("outRotateZ", "orz", MFnUnitAttribute::kAngle, 0.0, &stat); MS_CHECK(stat);
+	outRotate = nAttr.create("outRotate", "or",
+		outRotateX, outRotateY, outRotateZ, &stat); MS_CHECK(stat);
+
+	output = cAttr.create("output", "out", &stat); MS_CHECK(stat);
+	MS_CHECK(cAttr.addChild(outTranslate));
+	MS_CHECK(cAttr.addChild(outRotate));
+	MS_CHECK(cAttr.setArray(true));
+	MS_CHECK(cAttr.setUsesArrayDataBuilder(true));
+	MS_CHECK(cAttr.setStorable(false));
+	MS_CHECK(cAttr.setWritable(false));
+
+	MS_CHECK(addAttribute(clipFile));
+	MS_CHECK(addAttribute(time));
+	MS_CHECK(addAttribute(startTime));
+	MS_CHECK(addAttribute(output));
+
+	MS_CHECK(attributeAffects(clipFile, output));
+	MS_CHECK(attributeAffects(time, output));
+	MS_CHECK(attributeAffects(startTime, output));
+
+	MS_EXIT
+	MS_RETURN
+}
+
+//-----------------------------------------------------------------------------
+// compute
+//-----------------------------------------------------------------------------
+MStatus imocapStreamNode::compute(const MPlug &plug, MDataBlock &data)
+{
+	MStatus stat;
+	MObject attr = plug.attribute();
+	if (attr != output && attr != outTranslate && attr != outRotate &&
+		attr != outTranslateX && attr != outTranslateY && attr != outTranslateZ &&
+		attr != outRotateX && attr != outRotateY && attr != outRotateZ) {
+		return MS::kUnknownParameter;
+	}
+
+	MS_ENTRANCE
+
+	// (re)open the clip if the file has been changed
+	//
+	MString file = data.inputValue(clipFile, &stat).asString(); MS_CHECK(stat);
+	if (!clip.isOpen() || file != clipName) {
+		clipName = file;
+		if (clip.open(file.asChar()) != MC_SUCCESS) {
+			ILOG4 ("Error: Cannot open clip " << file);
+			MS_CHECK(MStatus::kFailure);
+		}
+		values.resize(clip.getJoints() * clipChannels);
+	}
+
+	// sample it
+	//
+	MTime now = data.inputValue(time, &stat).asTime(); MS_CHECK(stat);
+	MTime start = data.inputValue(startTime, &stat).asTime(); MS_CHECK(stat);
+	if (clip.evaluate((now - start).as(MTime::kSeconds), &values[0]) != MC_SUCCESS) {
+		MS_CHECK(MStatus::kFailure);
+	}
+
+	// write all the joints at one time
+	//
+	MArrayDataHandle outArray = data.outputArrayValue(output, &stat); MS_CHECK(stat);
+	MArrayDataBuilder builder = outArray.builder(&stat); MS_CHECK(stat);
+	const float *value = &values[0];
+	for (unsigned int i = 0; i < clip.getJoints(); ++i, value += clipChannels) {
+		MDataHandle element = builder.addElement(i, &stat); MS_CHECK(stat);
+		element.child(outTranslate).set3Double(value[0], value[1], value[2]);
+		MDataHandle rotate = element.child(outRotate);
+		rotate.child(outRotateX).setMAngle(MAngle(toRadians(value[3])));
+		rotate.child(outRotateY).setMAngle(MAngle(toRadians(value[4])));
+		rotate.child(outRotateZ).setMAngle(MAngle(toRadians(value[5])));
+	}
+	MS_CHECK_RELAY
+	MS_CHECK(outArray.set(builder));
+	MS_CHECK(outArray.setAllClean());
+	MS_CHECK(data.setClean(plug));
+
+	MS_EXIT
+	MS_RETURN
+}
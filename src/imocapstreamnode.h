@@ -0,0 +1,68 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __IMOCAPSTREAMNODE_H__
+#define __IMOCAPSTREAMNODE_H__
+
+#define REQUIRE_IOSTREAM
+
+#include <maya/MPxNode.h>
+#include <maya/MTypeId.h>
+#include <maya/MString.h>
+#include <vector>
+
+#include "iclipstream.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// dependency node evaluating a clip on demand
+//
+// Inputs are the clip file, the scene time and the scene time of the first
+// frame. Element i of 'output' drives the i-th joint in preorder.
+//
+class imocapStreamNode : public MPxNode {
+public:
+	imocapStreamNode();
+	virtual ~imocapStreamNode();
+
+	virtual MStatus compute(const MPlug &plug, MDataBlock &data);
+
+	static void *creator();
+	static MStatus initialize();
+
+	static const MTypeId id;
+	static const char *typeName;
+
+	// attributes
+	static MObject clipFile;
+	static MObject time;
+	static MObject startTime;
+	static MObject output;
+	static MObject outTranslate;
+	static MObject outTranslateX;
+	static MObject outTranslateY;
+	static MObject outTranslateZ;
+	static MObject outRotate;
+	static MObject outRotateX;
+	static MObject outRotateY;
+	static MObject outRotateZ;
+
+private:
+	iClipStream clip;
+	MString clipName;		// the file of opened clip
+	std::vector<float> values;
+};
+
+#endif	// #ifndef __IMOCAPSTREAMNODE_H__
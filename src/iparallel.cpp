@@ -0,0 +1,470 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <deque>
+#include <vector>
+
+#include "idebug.h"
+#include "ithread.h"
+#include "iparallel.h"
+
+using namespace std;
+
+// jobs a loop is split into for every thread, so that idle ones can steal
+const unsigned int jobsPerThread = 4;
+// longest sleep of an idle worker (milliseconds)
+const unsigned int idleTimeout = 50;
+
+///////////////////////////////////////////////////////////////////////////////
+// a loop in progress
+//
+struct iBatch {
+	iTask *task;
+	iCancelFlag *cancel;
+	unsigned int pending;	// jobs not finished yet
+	bool complete;			// no index was skipped
+	iMutex lock;
+};
+
+// a range of indices of a loop
+struct iJob {
+	iBatch *batch;
+	unsigned int begin;
+	unsigned int end;
+};
+
+// jobs of a worker
+struct iQueue {
+	deque<iJob> jobs;
+	iMutex lock;
+	iQueue() { initMutex(lock); }
+	~iQueue() { freeMutex(lock); }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// the pool shared by all loops
+//
+// It is never destroyed by hand, so that no thread is joined while a
+// module is being unloaded; stopPool() does that beforehand.
+//
+static struct iPool {
+	iMutex lock;				// guards the fields below
+	bool allowed;				// workers may be started
+	unsigned int wanted;		// threads asked for (0 for processors)
+	unsigned int users;			// loops in progress
+	bool resizing;				// workers are of another size than wanted
+	unsigned int next;			// queue of the next job
+	vector<iThread> threads;
+	vector<iQueue *> queues;	// one for a worker
+	volatile bool stopping;		// loops skip what is left
+	volatile bool quitting;		// workers return
+	iSignal wake;
+
+	iPool() : allowed(true), wanted(0), users(0), resizing(false), next(0), stopping(false),
+		quitting(false) {
+		initMutex(lock);
+	}
+} pool;
+
+//-----------------------------------------------------------------------------
+// take a job, the newest of the own queue or the oldest of another one
+//-----------------------------------------------------------------------------
+static bool takeJob(unsigned int self, bool owner, iJob &job)
+{
+	const unsigned int n = static_cast<unsigned int>(pool.queues.size());
+	for (unsigned int k = 0; k < n; ++k) {
+		iQueue &queue = *pool.queues[(self + k) % n];
+		lockMutex(queue.lock);
+		const bool got = !queue.jobs.empty();
+		if (got) {
+			if (owner && 0 == k) {
+				job = queue.jobs.back();
+				queue.jobs.pop_back();
+			} else {
+				job = queue.jobs.front();
+				queue.jobs.pop_front();
+			}
+		}
+		unlockMutex(queue.lock);
+		if (got) return true;
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// run a job
+//-----------------------------------------------------------------------------
+static void runJob(const iJob &job)
+{
+	iBatch &batch = *job.batch;
+	bool complete = true;
+	for (unsigned int i = job.begin; i < job.end; ++i) {
+		if (pool.stopping || (NULL != batch.cancel && batch.cancel->isCancelled())) {
+			complete = false;
+			break;
+		}
+		batch.task->run(i);
+	}
+	// the batch may be gone once pending reaches zero
+	lockMutex(batch.lock);
+	if (!complete) batch.complete = false;
+	--batch.pending;
+	unlockMutex(batch.lock);
+}
+
+//-----------------------------------------------------------------------------
+// workers run jobs until they quit
+//-----------------------------------------------------------------------------
+static THREAD_PROC workerProc(void *arg)
+{
+	const unsigned int self = static_cast<unsigned int>(reinterpret_cast<size_t>(arg));
+	while (!pool.quitting) {
+		iJob job;
+		if (takeJob(self, true, job)) {
+			runJob(job);
+		} else {
+			pool.wake.wait(idleTimeout);
+		}
+	}
+	return THREAD_RETURN;
+}
+
+//-----------------------------------------------------------------------------
+// start workers with the pool locked
+//-----------------------------------------------------------------------------
+static void startWorkers()
+{
+	const unsigned int n = (0 == pool.wanted) ? countProcessors() : pool.wanted;
+	if (n <= 1) return;
+
+	// the thread waiting for a loop is the last one
+	pool.queues.resize(n - 1);
+	pool.threads.resize(n - 1);
+	unsigned int i, started = 0;
+	for (i = 0; i < n - 1; ++i) pool.queues[i] = new iQueue;
+	for (i = 0; i < n - 1; ++i) {
+		if (startThread(pool.threads[started], workerProc, reinterpret_cast<void *>(static_cast<size_t>(i)))) {
+			++started;
+		} else {
+			ILOG3("Warning: Cannot start worker thread " << i);
+		}
+	}
+	// queues without a worker are emptied by thieves
+	pool.threads.resize(started);
+	ILOG1("Thread pool started with " << started << " workers");
+}
+
+//-----------------------------------------------------------------------------
+// join workers with the pool locked and no loop in progress
+//
+// Idle workers never lock the pool, so they quit while it is held.
+//-----------------------------------------------------------------------------
+static void stopWorkers()
+{
+	pool.quitting = true;
+	pool.wake.post(static_cast<unsigned int>(pool.threads.size()));
+	unsigned int i;
+	for (i = 0; i < pool.threads.size(); ++i) joinThread(pool.threads[i]);
+	for (i = 0; i < pool.queues.size(); ++i) delete pool.queues[i];
+	if (!pool.threads.empty()) {
+		ILOG1("Thread pool stopped");
+	}
+
+	pool.threads.clear();
+	pool.queues.clear();
+	pool.next = 0;
+	pool.quitting = false;
+	pool.resizing = false;
+}
+
+//-----------------------------------------------------------------------------
+// join a loop, false if it has to run serially
+//-----------------------------------------------------------------------------
+static bool enterPool()
+{
+	lockMutex(pool.lock);
+	// workers of another size are replaced once no loop uses them
+	if (pool.allowed && pool.resizing && 0 == pool.users) stopWorkers();
+	if (pool.allowed && pool.queues.empty()) startWorkers();
+	const bool entered = pool.allowed && !pool.queues.empty();
+	if (entered) ++pool.users;
+	unlockMutex(pool.lock);
+	return entered;
+}
+
+//-----------------------------------------------------------------------------
+// leave a loop
+//-----------------------------------------------------------------------------
+static void leavePool()
+{
+	lockMutex(pool.lock);
+	--pool.users;
+	unlockMutex(pool.lock);
+}
+
+//-----------------------------------------------------------------------------
+// split a loop into jobs spread over the queues
+//-----------------------------------------------------------------------------
+static void submitBatch(iBatch &batch, unsigned int count, unsigned int jobs)
+{
+	if (jobs > count) jobs = count;
+	batch.pending = jobs;
+	if (0 == jobs) return;
+
+	const unsigned int n = static_cast<unsigned int>(pool.queues.size());
+	lockMutex(pool.lock);
+	const unsigned int first = pool.next;
+	pool.next = (pool.next + jobs) % n;
+	unlockMutex(pool.lock);
+
+	for (unsigned int k = 0; k < jobs; ++k) {
+		iJob job;
+		job.batch = &batch;
+		job.begin = static_cast<unsigned int>(static_cast<double>(count) * k / jobs);
+		job.end = static_cast<unsigned int>(static_cast<double>(count) * (k + 1) / jobs);
+		iQueue &queue = *pool.queues[(first + k) % n];
+		lockMutex(queue.lock);
+		queue.jobs.push_back(job);
+		unlockMutex(queue.lock);
+	}
+	pool.wake.post(jobs);
+}
+
+//-----------------------------------------------------------------------------
+// whether all jobs of a batch are done
+//-----------------------------------------------------------------------------
+static bool isBatchDone(iBatch &batch)
+{
+	lockMutex(batch.lock);
+	const bool done = (0 == batch.pending);
+	unlockMutex(batch.lock);
+	return done;
+}
+
+//-----------------------------------------------------------------------------
+// run one job of any loop, or have a nap
+//-----------------------------------------------------------------------------
+static void helpPool(unsigned int self)
+{
+	iJob job;
+	if (takeJob(self, false, job)) {
+		runJob(job);
+	} else {
+		pauseThread();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// countProcessors
+//-----------------------------------------------------------------------------
+unsigned int countProcessors()
+{
+#if defined (_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	long n = static_cast<long>(info.dwNumberOfProcessors);
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return (n > 0) ? static_cast<unsigned int>(n) : 1;
+}
+
+//-----------------------------------------------------------------------------
+// startPool
+//-----------------------------------------------------------------------------
+void startPool(unsigned int threads)
+{
+	// loops in progress keep their workers, which are replaced by the next
+	// loop to find the pool idle
+	lockMutex(pool.lock);
+	if (!pool.allowed || threads != pool.wanted) {
+		pool.wanted = threads;
+		pool.allowed = true;
+		pool.resizing = !pool.queues.empty();
+	}
+	unlockMutex(pool.lock);
+}
+
+//-----------------------------------------------------------------------------
+// stopPool
+//-----------------------------------------------------------------------------
+void stopPool()
+{
+	lockMutex(pool.lock);
+	pool.allowed = false;
+	pool.stopping = true;
+	unlockMutex(pool.lock);
+
+	// loops in progress skip their rest, so this takes one index at most
+	for (;;) {
+		lockMutex(pool.lock);
+		const unsigned int users = pool.users;
+		unlockMutex(pool.lock);
+		if (0 == users) break;
+		pauseThread();
+	}
+
+	lockMutex(pool.lock);
+	stopWorkers();
+	pool.stopping = false;
+	unlockMutex(pool.lock);
+}
+
+//-----------------------------------------------------------------------------
+// countPoolThreads
+//-----------------------------------------------------------------------------
+unsigned int countPoolThreads()
+{
+	lockMutex(pool.lock);
+	unsigned int n;
+	if (!pool.allowed) {
+		n = 1;
+	} else if (!pool.queues.empty()) {
+		n = static_cast<unsigned int>(pool.threads.size()) + 1;
+	} else {
+		n = (0 == pool.wanted) ? countProcessors() : pool.wanted;
+	}
+	unlockMutex(pool.lock);
+	return n;
+}
+
+//-----------------------------------------------------------------------------
+// parallelFor
+//-----------------------------------------------------------------------------
+bool parallelFor(unsigned int count, iTask &task, unsigned int threads, iCancelFlag *cancel)
+{
+	// not worth a thread
+	if (1 == threads || count < 2 || !enterPool()) {
+		for (unsigned int i = 0; i < count; ++i) {
+			if (NULL != cancel && cancel->isCancelled()) return false;
+			task.run(i);
+		}
+		return true;
+	}
+
+	iBatch batch;
+	batch.task = &task;
+	batch.cancel = cancel;
+	batch.complete = true;
+	initMutex(batch.lock);
+
+	const unsigned int jobs = (0 == threads) ? countPoolThreads() * jobsPerThread : threads;
+	submitBatch(batch, count, jobs);
+	// the calling thread works as well
+	while (!isBatchDone(batch)) helpPool(0);
+
+	freeMutex(batch.lock);
+	leavePool();
+	return batch.complete;
+}
+
+//-----------------------------------------------------------------------------
+// add a node
+//-----------------------------------------------------------------------------
+unsigned int iTaskGraph::add(iTask &task, unsigned int count)
+{
+	iNode node;
+	node.task = &task;
+	node.count = count;
+	node.deps = 0;
+	nodes.push_back(node);
+	return static_cast<unsigned int>(nodes.size() - 1);
+}
+
+//-----------------------------------------------------------------------------
+// add a dependency
+//-----------------------------------------------------------------------------
+void iTaskGraph::depend(unsigned int node, unsigned int before)
+{
+	if (node >= nodes.size() || before >= nodes.size() || node == before) return;
+	nodes[before].next.push_back(node);
+	++nodes[node].deps;
+}
+
+//-----------------------------------------------------------------------------
+// run the graph
+//-----------------------------------------------------------------------------
+bool iTaskGraph::run(unsigned int threads, iCancelFlag *cancel)
+{
+	const unsigned int n = static_cast<unsigned int>(nodes.size());
+	vector<unsigned int> deps(n), ready;
+	unsigned int i, k;
+	for (i = 0; i < n; ++i) {
+		deps[i] = nodes[i].deps;
+		if (0 == deps[i]) ready.push_back(i);
+	}
+
+	// one node after another in the calling thread
+	//
+	if (1 == threads || !enterPool()) {
+		unsigned int done = 0;
+		while (!ready.empty()) {
+			const unsigned int idx = ready.back();
+			ready.pop_back();
+			if (!parallelFor(nodes[idx].count, *nodes[idx].task, 1, cancel)) return false;
+			++done;
+			for (k = 0; k < nodes[idx].next.size(); ++k) {
+				if (0 == --deps[nodes[idx].next[k]]) ready.push_back(nodes[idx].next[k]);
+			}
+		}
+		return (done == n);
+	}
+
+	// ready nodes are submitted at once, their followers when they are done
+	//
+	vector<iBatch> batches(n);
+	vector<unsigned int> running;
+	const unsigned int jobs = (0 == threads) ? countPoolThreads() * jobsPerThread : threads;
+	unsigned int done = 0;
+	bool complete = true;
+	for (;;) {
+		for (k = 0; k < ready.size(); ++k) {
+			iBatch &batch = batches[ready[k]];
+			batch.task = nodes[ready[k]].task;
+			batch.cancel = cancel;
+			batch.complete = true;
+			initMutex(batch.lock);
+			submitBatch(batch, nodes[ready[k]].count, jobs);
+			running.push_back(ready[k]);
+		}
+		ready.clear();
+		if (running.empty()) break;
+
+		bool finished = false;
+		for (k = 0; k < running.size(); ) {
+			const unsigned int idx = running[k];
+			if (!isBatchDone(batches[idx])) {
+				++k;
+				continue;
+			}
+			finished = true;
+			complete = complete && batches[idx].complete;
+			freeMutex(batches[idx].lock);
+			running.erase(running.begin() + k);
+			++done;
+			// nothing more starts after a cancellation
+			if (!complete) continue;
+			for (i = 0; i < nodes[idx].next.size(); ++i) {
+				if (0 == --deps[nodes[idx].next[i]]) ready.push_back(nodes[idx].next[i]);
+			}
+		}
+		if (!finished) helpPool(0);
+	}
+	leavePool();
+
+	// nodes left over wait for each other
+	return complete && (done == n);
+}
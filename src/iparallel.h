@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __IPARALLEL_H__
+#define __IPARALLEL_H__
+
+#include <cstddef>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+// interface of jobs run by parallelFor
+//
+// run() is called once for every index in [0, count) from any of the
+// worker threads, so it must not touch anything shared with other indices.
+//
+class iTask {
+public:
+	virtual ~iTask() {}
+	virtual void run(unsigned int idx) = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// flag to cancel running loops
+//
+// Indices already started are finished, the rest are skipped.
+//
+class iCancelFlag {
+public:
+	iCancelFlag() : cancelled(false) {}
+	void cancel() { cancelled = true; }
+	void reset() { cancelled = false; }
+	bool isCancelled() const { return cancelled; }
+private:
+	volatile bool cancelled;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// class for graphs of tasks
+//
+// A node runs its task over [0, count) once every node it depends on
+// is done. Independent nodes run at the same time.
+//
+class iTaskGraph {
+public:
+	// add a node, return its index
+	unsigned int add(iTask &task, unsigned int count = 1);
+	// node runs after the node before
+	void depend(unsigned int node, unsigned int before);
+	// run all nodes in up to threads jobs each (0 for the pool, 1 for the
+	// calling thread only) and return when they are done, false if
+	// cancelled or the pool was stopped
+	bool run(unsigned int threads = 0, iCancelFlag *cancel = NULL);
+
+private:
+	//////////////////////////////////////
+	// inner struct for nodes
+	//
+	struct iNode {
+		iTask *task;
+		unsigned int count;
+		unsigned int deps;				// nodes it waits for
+		std::vector<unsigned int> next;	// nodes waiting for it
+	};
+	//
+	//////////////////////////////////////
+
+	std::vector<iNode> nodes;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// parallel functions
+//
+// All loops share one pool of worker threads. Workers are started by the
+// first loop and each of them keeps a queue of jobs, idle ones steal jobs
+// from the others. A thread waiting for a loop works on it as well, so
+// loops may be nested and nothing waits for a busy pool.
+//
+// quantity of processors
+unsigned int countProcessors();
+
+// allow the pool with threads (0 for one per processor), started lazily;
+// workers of another size are replaced once no loop is in progress
+void startPool(unsigned int threads = 0);
+// cancel pending jobs, join the workers and run loops serially until the
+// next startPool
+void stopPool();
+// quantity of threads working on a loop, the calling one included
+unsigned int countPoolThreads();
+
+// run task for indices [0, count) in up to threads jobs (0 for the pool,
+// 1 for the calling thread only), and return when all of them are done,
+// false if cancelled or the pool was stopped
+bool parallelFor(unsigned int count, iTask &task, unsigned int threads = 0,
+	iCancelFlag *cancel = NULL);
+
+#endif	// #ifndef __IPARALLEL_H__
@@ -0,0 +1,129 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __IPIPELINE_H__
+#define __IPIPELINE_H__
+
+#include <string>
+#include <vector>
+
+#include "ithread.h"
+
+// longest wait of a side for the other one (millisecond), a backstop only
+const unsigned int pipeWaitTimeout = 100;
+
+///////////////////////////////////////////////////////////////////////////////
+// statistics of a pipeline stage
+//
+struct iStageStats {
+	std::string name;
+	unsigned int batches;		// batches passed on
+	unsigned int stalls;		// waits for room in the output pipe
+	unsigned int starves;		// waits for a batch from the input pipe
+	unsigned int peak;			// most batches waiting in the output pipe
+	double occupancy;			// mean batches waiting in the output pipe
+	double seconds;				// wall time from start to end
+
+	iStageStats(const std::string &nick = std::string()) : name(nick),
+		batches(0), stalls(0), starves(0), peak(0), occupancy(0.0), seconds(0.0) {}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// class for bounded pipes of batches between two stages
+//
+// Exactly one thread pushes and one thread pops, so head and tail are each
+// written by one side only and no lock is needed. A full or empty pipe is
+// waited for on a signal posted by the other side, and the waits are
+// counted as stalls or starves. Every push & pop posts, so no wake is lost;
+// a post nobody waited for costs one more try later on.
+//
+template <class T>
+class iPipe {
+public:
+	// constructor
+	explicit iPipe(unsigned int depth) : ring(depth + 1, static_cast<T *>(NULL)),
+		head(0), tail(0), aborted(false), sum(0.0) {}
+
+	// quantity of waiting batches
+	unsigned int size() const {
+		const unsigned int n = static_cast<unsigned int>(ring.size());
+		return (head + n - tail) % n;
+	}
+
+	// put a batch, false if full
+	bool tryPush(T *item) {
+		const unsigned int next = (head + 1) % ring.size();
+		if (next == tail) return false;
+		ring[head] = item;
+		memoryBarrier();	// the item before the index
+		head = next;
+		return true;
+	}
+	// take a batch, false if empty
+	bool tryPop(T *&item) {
+		if (tail == head) return false;
+		memoryBarrier();	// the index before the item
+		item = ring[tail];
+		memoryBarrier();	// the item before the slot is reused
+		tail = (tail + 1) % ring.size();
+		return true;
+	}
+
+	// put a batch, false if the pipe was aborted
+	bool push(T *item, iStageStats &stats) {
+		while (!tryPush(item)) {
+			if (aborted) return false;
+			++stats.stalls;
+			freed.wait(pipeWaitTimeout);
+		}
+		filled.post(1);
+		const unsigned int n = size();
+		if (n > stats.peak) stats.peak = n;
+		sum += n;
+		++stats.batches;
+		stats.occupancy = sum / stats.batches;
+		return true;
+	}
+	// take a batch, false if the pipe was aborted
+	bool pop(T *&item, iStageStats &stats) {
+		while (!tryPop(item)) {
+			if (aborted) return false;
+			++stats.starves;
+			filled.wait(pipeWaitTimeout);
+		}
+		freed.post(1);
+		return true;
+	}
+
+	// make both sides give up waiting
+	void abort() {
+		aborted = true;
+		filled.post(1);
+		freed.post(1);
+	}
+	bool isAborted() const { return aborted; }
+
+private:
+	std::vector<T *> ring;
+	volatile unsigned int head;		// next slot to put, by the producer
+	volatile unsigned int tail;		// next slot to take, by the consumer
+	volatile bool aborted;
+	double sum;						// of occupancies, by the producer
+	iSignal filled;					// a batch was put
+	iSignal freed;					// a slot was freed
+};
+
+#endif	// #ifndef __IPIPELINE_H__
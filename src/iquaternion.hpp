@@ -49,7 +49,7 @@ public:
 //		result.v.z = q1.n * v.z +  q1.v.z * n + q1.v.x * v.y - q1.v.y * v.x;
 //		result.n = q1.n * n - (q1.v.x * v.x + q1.v.y * v.y + q1.v.z * v.z);
 		result.n = q1.n * n - q1.v * v;
-		result.v = v * q1.n + q1.v * n + q1.v ^ v;
+		result.v = v * q1.n + q1.v * n + (v ^ q1.v);
 		result.normalize();
 		return result;
 	}
@@ -107,7 +107,7 @@ public:
 	}
 
 	// magnitude
-	inline T magnitude() {
+	inline T magnitude() const {
 		return static_cast<T>(sqrt(v.x * v.x + v.y * v.y + v.z * v.z + n * n));
 	}
 
@@ -124,8 +124,34 @@ public:
 	}
 
 	// with matrices
+	// (the layout of toMatrix(), for row vectors)
 	inline iQuaternion<T> &operator=(const iMatrix<T> &m) {
-		// do it later...
+		T tr = m[0] + m[5] + m[10];
+		if (tr > 0) {
+			T s = static_cast<T>(sqrt(tr + 1.0) * 2.0);
+			n = static_cast<T>(0.25 * s);
+			v.x = (m[6] - m[9]) / s;
+			v.y = (m[8] - m[2]) / s;
+			v.z = (m[1] - m[4]) / s;
+		} else if (m[0] > m[5] && m[0] > m[10]) {
+			T s = static_cast<T>(sqrt(1.0 + m[0] - m[5] - m[10]) * 2.0);
+			n = (m[6] - m[9]) / s;
+			v.x = static_cast<T>(0.25 * s);
+			v.y = (m[4] + m[1]) / s;
+			v.z = (m[8] + m[2]) / s;
+		} else if (m[5] > m[10]) {
+			T s = static_cast<T>(sqrt(1.0 + m[5] - m[0] - m[10]) * 2.0);
+			n = (m[8] - m[2]) / s;
+			v.x = (m[4] + m[1]) / s;
+			v.y = static_cast<T>(0.25 * s);
+			v.z = (m[9] + m[6]) / s;
+		} else {
+			T s = static_cast<T>(sqrt(1.0 + m[10] - m[0] - m[5]) * 2.0);
+			n = (m[1] - m[4]) / s;
+			v.x = (m[8] + m[2]) / s;
+			v.y = (m[9] + m[6]) / s;
+			v.z = static_cast<T>(0.25 * s);
+		}
 		return *this;
 	}
 
@@ -194,16 +220,72 @@ public:
 		return (*this);
 	}
 
+	// with euler angles in any order (radians), order "abc" is qa * qb * qc
+	iQuaternion<T> &fromEulerAngle(const iVector<T> &v1, int order) {
+		unsigned int axes[3];
+		if (!getAxes(order, axes)) {
+			clear(); n = 1;
+			return *this;
+		}
+		const T angles[3] = {v1.x, v1.y, v1.z};
+		iQuaternion<T> q[3];
+		for (unsigned int i = 0; i < 3; ++i) {
+			iVector<T> axis;
+			if (0 == axes[i]) axis.x = 1;
+			else if (1 == axes[i]) axis.y = 1;
+			else axis.z = 1;
+			q[i].setAxisAngle(axis, angles[axes[i]]);
+		}
+		*this = q[0] * q[1] * q[2];
+		return *this;
+	}
+
+	iVector<T> toEulerAngle(int order) const {
+		unsigned int axes[3];
+		if (!getAxes(order, axes)) return iVector<T>();
+		const unsigned int a = axes[0], b = axes[1], c = axes[2];
+
+		// rotation for column vectors, r(i, j) = m[j * 4 + i]
+		iMatrix<T> m = toMatrix();
+		const T s = ((b + 3 - a) % 3 == 1) ? 1 : -1;
+
+		// the middle angle by its sine & cosine, accurate near 90 degrees
+		T angles[3];
+		const T sb = s * m[c * 4 + a];
+		const T cb = static_cast<T>(sqrt(m[a * 4 + a] * m[a * 4 + a] + m[b * 4 + a] * m[b * 4 + a]));
+		angles[b] = static_cast<T>(atan2(sb, cb));
+
+		// the last angle unless locked, then the first one from the
+		// matrix without the last rotation
+		T cc = 1, sc = 0;
+		angles[c] = 0;
+		if (cb > 4 * std::numeric_limits<T>::epsilon()) {
+			cc = m[a * 4 + a] / cb;
+			sc = -s * m[b * 4 + a] / cb;
+			angles[c] = static_cast<T>(atan2(sc, cc));
+		}
+		const T ub = cc * m[b * 4 + b] + s * sc * m[a * 4 + b];
+		const T uc = cc * m[b * 4 + c] + s * sc * m[a * 4 + c];
+		angles[a] = static_cast<T>(atan2(s * uc, ub));
+		return iVector<T>(angles[0], angles[1], angles[2]);
+	}
+
 	// with axis angles
 	iQuaternion<T> &setAxisAngle(const iVector<T> &axis, T theta) {
-		//theta *= 0.5;
-		//n = cos(theta);
-		//v = sin(theta) * axis;
+		theta *= 0.5;
+		n = cos(theta);
+		v = axis * static_cast<T>(sin(theta));
 		return *this;
 	}
 
-	void getAxisAngle(iVector<T> &axis, T &theta) {
-		// do it later...
+	void getAxisAngle(iVector<T> &axis, T &theta) const {
+		T len = static_cast<T>(sqrt(v * v));
+		theta = static_cast<T>(2.0 * atan2(len, n));
+		if (len > 0) {
+			axis = v * static_cast<T>(1.0 / len);
+		} else {
+			axis.set(1, 0, 0);
+		}
 	}
 
 	// rotation
@@ -217,14 +299,25 @@ public:
 	//	return t.v;
 	//}
 
-	friend std::ostream& operator<<(std::ostream &out, iQuaternion<T> &temp) {
+	friend std::ostream& operator<<(std::ostream &out, const iQuaternion<T> &temp) {
 		temp.output(out);
 		return out;
 	}
 
 private:
+	// axes of a rotation order, 0 for x ... 2 for z
+	static bool getAxes(int order, unsigned int (&axes)[3]) {
+		static const unsigned int table[6][3] = {
+			{0, 1, 2}, {1, 2, 0}, {2, 0, 1},
+			{2, 1, 0}, {1, 0, 2}, {0, 2, 1}
+		};
+		if (order < static_cast<int>(IRO_XYZ) || order > static_cast<int>(IRO_XZY)) return false;
+		for (unsigned int i = 0; i < 3; ++i) axes[i] = table[order][i];
+		return true;
+	}
+
 	// overriding standard output operator
-	void output(std::ostream &out) {
+	void output(std::ostream &out) const {
 		out << "(" << v.x << ", " << v.y << ", " << v.z << "; " << n << ")";
 	}
 
@@ -0,0 +1,60 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "idebug.h"
+#include "ireduce.h"
+
+//-----------------------------------------------------------------------------
+// reduceKeys
+//-----------------------------------------------------------------------------
+void reduceKeys(const double *samples, unsigned int count, double tolerance, iKeyList &keys)
+{
+	keys.clear();
+	if (0 == count) return;
+	keys.push_back(0);
+	if (1 == count) return;
+
+	unsigned int anchor = 0;
+	double low = 0.0, high = 0.0;	// band of slopes from the anchor
+
+	for (unsigned int i = anchor + 1; i < count; ++i) {
+		const double span = static_cast<double>(i - anchor);
+		const double slope = (samples[i] - samples[anchor]) / span;
+
+		// Can the segment from the anchor end here?
+		// (every sample between has narrowed the band)
+		if (i > anchor + 1 && (slope < low || slope > high)) {
+			// No, the previous sample becomes a key
+			anchor = i - 1;
+			keys.push_back(anchor);
+			--i;
+			continue;
+		}
+
+		// Narrow the band by the current sample
+		const double lo = (samples[i] - tolerance - samples[anchor]) / span;
+		const double hi = (samples[i] + tolerance - samples[anchor]) / span;
+		if (i == anchor + 1) {
+			low = lo;
+			high = hi;
+		} else {
+			if (lo > low) low = lo;
+			if (hi < high) high = hi;
+		}
+	}
+
+	keys.push_back(count - 1);
+}
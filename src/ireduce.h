@@ -0,0 +1,35 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __IREDUCE_H__
+#define __IREDUCE_H__
+
+#include <vector>
+
+// Indices of samples kept as keys
+typedef std::vector<unsigned int> iKeyList;
+
+///////////////////////////////////////////////////////////////////////////////
+// key reduction
+//
+// Pick the fewest samples such that the polyline through them (linear
+// tangents) stays within tolerance of every dropped sample. The first and
+// last samples are always kept. Runs in linear time by narrowing the band
+// of admissible slopes from the last key.
+//
+void reduceKeys(const double *samples, unsigned int count, double tolerance, iKeyList &keys);
+
+#endif	// #ifndef __IREDUCE_H__
@@ -0,0 +1,225 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#if defined (_WIN32)
+#	include <windows.h>
+#	include <psapi.h>
+#else
+#	include <sys/time.h>
+#	include <sys/resource.h>
+#endif
+
+#include <fstream>
+
+#include "itrace.h"
+#include "iskeleton.h"
+#include "ireport.h"
+
+using namespace std;
+
+//-----------------------------------------------------------------------------
+// rate of an amount, 0 without time
+//-----------------------------------------------------------------------------
+static double getRate(double amount, double seconds)
+{
+	return (seconds > 0.0) ? amount / seconds : 0.0;
+}
+
+//-----------------------------------------------------------------------------
+// forget everything
+//-----------------------------------------------------------------------------
+void iImportReport::clear()
+{
+	file.clear();
+	result = MC_SUCCESS;
+	seconds = 0.0;
+	bytes = 0.0;
+	joints = 0;
+	frames = 0;
+	keys = 0.0;
+	peakMemory = 0.0;
+	memory.clear();
+	stages.clear();
+	phaseNames.clear();
+	phaseSeconds.clear();
+	phaseAllocs.clear();
+}
+
+//-----------------------------------------------------------------------------
+// add seconds to a phase
+//-----------------------------------------------------------------------------
+void iImportReport::addPhase(const string &name, double sec, const iAllocCount &allocs)
+{
+	for (unsigned int i = 0; i < phaseNames.size(); ++i) {
+		if (phaseNames[i] == name) {
+			phaseSeconds[i] += sec;
+			phaseAllocs[i] += allocs;
+			return;
+		}
+	}
+	phaseNames.push_back(name);
+	phaseSeconds.push_back(sec);
+	phaseAllocs.push_back(allocs);
+}
+
+//-----------------------------------------------------------------------------
+// seconds of a phase
+//-----------------------------------------------------------------------------
+double iImportReport::getPhase(const string &name) const
+{
+	for (unsigned int i = 0; i < phaseNames.size(); ++i) {
+		if (phaseNames[i] == name) return phaseSeconds[i];
+	}
+	return 0.0;
+}
+
+//-----------------------------------------------------------------------------
+// allocations of a phase
+//-----------------------------------------------------------------------------
+iAllocCount iImportReport::getPhaseAllocs(const string &name) const
+{
+	for (unsigned int i = 0; i < phaseNames.size(); ++i) {
+		if (phaseNames[i] == name) return phaseAllocs[i];
+	}
+	return iAllocCount();
+}
+
+//-----------------------------------------------------------------------------
+// keep the largest memory
+//-----------------------------------------------------------------------------
+void iImportReport::noteMemory(const iMemoryUse &use)
+{
+	if (use.getTotal() > memory.getTotal()) memory = use;
+}
+
+//-----------------------------------------------------------------------------
+// a string quoted for JSON
+//-----------------------------------------------------------------------------
+static string quoteString(const string &s)
+{
+	string quoted("\"");
+	for (unsigned int i = 0; i < s.size(); ++i) {
+		if ('"' == s[i] || '\\' == s[i]) quoted += '\\';
+		quoted += s[i];
+	}
+	return quoted + "\"";
+}
+
+//-----------------------------------------------------------------------------
+// write the report as JSON
+//-----------------------------------------------------------------------------
+void iImportReport::write(ostream &out) const
+{
+	unsigned int i;
+
+	out << "{\n";
+	out << "\t\"file\": " << quoteString(file) << ",\n";
+	out << "\t\"result\": " << result << ",\n";
+	out << "\t\"seconds\": " << seconds << ",\n";
+	out << "\t\"bytes\": " << bytes << ",\n";
+	out << "\t\"joints\": " << joints << ",\n";
+	out << "\t\"frames\": " << frames << ",\n";
+	out << "\t\"keys\": " << keys << ",\n";
+	out << "\t\"peakMemory\": " << peakMemory << ",\n";
+	out << "\t\"memory\": {\n";
+	out << "\t\t\"total\": " << memory.getTotal() << ",\n";
+	out << "\t\t\"hierarchy\": " << memory.hierarchy << ",\n";
+	out << "\t\t\"names\": " << memory.names << ",\n";
+	out << "\t\t\"motion\": " << memory.motion << ",\n";
+	out << "\t\t\"slack\": " << memory.slack << ",\n";
+	out << "\t\t\"caches\": " << memory.caches << ",\n";
+	out << "\t\t\"spilled\": " << memory.spilled << ",\n";
+	out << "\t\t\"joints\": [";
+	for (i = 0; i < memory.joints.size(); ++i) {
+		const iMemoryUse::iJointUse &j = memory.joints[i];
+		out << (i ? ",\n" : "\n") << "\t\t\t{ \"name\": " << quoteString(j.name)
+			<< ", \"motion\": " << j.motion << ", \"slack\": " << j.slack << " }";
+	}
+	out << "\n\t\t]\n";
+	out << "\t},\n";
+	out << "\t\"bytesPerSecond\": " << getRate(bytes, getPhase("hierarchy") + getPhase("motion")) << ",\n";
+	out << "\t\"framesPerSecond\": " << getRate(static_cast<double>(frames), getPhase("motion")) << ",\n";
+	out << "\t\"keysPerSecond\": " << getRate(keys, getPhase("keys")) << ",\n";
+
+	out << "\t\"phases\": {";
+	for (i = 0; i < phaseNames.size(); ++i) {
+		out << (i ? ",\n" : "\n") << "\t\t\"" << phaseNames[i] << "\": " << phaseSeconds[i];
+	}
+	out << "\n\t},\n";
+
+	if (isCountingAllocs()) {
+		out << "\t\"allocations\": {";
+		for (i = 0; i < phaseNames.size(); ++i) {
+			out << (i ? ",\n" : "\n") << "\t\t\"" << phaseNames[i] << "\": { \"count\": "
+				<< phaseAllocs[i].allocs << ", \"bytes\": " << phaseAllocs[i].bytes << " }";
+		}
+		out << "\n\t},\n";
+	}
+
+	out << "\t\"stages\": [";
+	for (i = 0; i < stages.size(); ++i) {
+		const iStageStats &s = stages[i];
+		out << (i ? ",\n" : "\n") << "\t\t{ \"name\": \"" << s.name << "\", \"batches\": " << s.batches
+			<< ", \"stalls\": " << s.stalls << ", \"starves\": " << s.starves << ", \"peak\": " << s.peak
+			<< ", \"occupancy\": " << s.occupancy << ", \"seconds\": " << s.seconds << " }";
+	}
+	out << "\n\t]\n";
+	out << "}\n";
+}
+
+int iImportReport::write(const string &path) const
+{
+	ofstream out(path.c_str());
+	if (!out) return MC_INVALID_STREAM;
+	out.precision(15);
+	write(out);
+	return out ? MC_SUCCESS : MC_INVALID_STREAM;
+}
+
+//-----------------------------------------------------------------------------
+// phase timer
+//-----------------------------------------------------------------------------
+iPhaseTimer::iPhaseTimer(iImportReport *rpt, const char *phaseName) :
+	report(rpt), name(phaseName), begin(getWallTime()), allocs(getAllocCount())
+{
+}
+
+iPhaseTimer::~iPhaseTimer()
+{
+	const double end = getWallTime();
+	traceSpan(name, begin, end);
+	if (NULL != report) report->addPhase(name, end - begin, getAllocCount() - allocs);
+}
+
+//-----------------------------------------------------------------------------
+// peak resident bytes of the process
+//-----------------------------------------------------------------------------
+double getPeakMemory()
+{
+#if defined (_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0.0;
+	return static_cast<double>(counters.PeakWorkingSetSize);
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+#	if defined (OSMac_) || defined (__APPLE__)
+	return static_cast<double>(usage.ru_maxrss);			// bytes
+#	else
+	return static_cast<double>(usage.ru_maxrss) * 1024.0;	// kilobytes
+#	endif
+#endif
+}
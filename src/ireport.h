@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __IREPORT_H__
+#define __IREPORT_H__
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ipipeline.h"
+#include "ialloc.h"
+#include "iskeleton.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// report on the performance of an import
+//
+// Phases are timed by the wall clock and add up, so a phase entered for
+// every joint is reported once. Builds counting allocations (see ialloc.h)
+// report the allocations of every phase as well. Nothing here depends on
+// Maya.
+//
+class iImportReport {
+public:
+	// constructor
+	iImportReport() { clear(); }
+
+	// forget everything
+	void clear();
+
+	// add seconds (and allocations) to a phase, phases are kept in the
+	// order of first use
+	void addPhase(const std::string &name, double seconds,
+		const iAllocCount &allocs = iAllocCount());
+	// seconds of a phase, 0 if never entered
+	double getPhase(const std::string &name) const;
+	// allocations of a phase
+	iAllocCount getPhaseAllocs(const std::string &name) const;
+
+	// keep memory held by the import if it is the largest so far
+	void noteMemory(const iMemoryUse &use);
+
+	// write the report as JSON
+	void write(std::ostream &out) const;
+	int write(const std::string &path) const;
+
+	std::string file;			// mocap file
+	int result;					// MC_SUCCESS or the error of the import
+	double seconds;				// wall time of the whole import
+	double bytes;				// size of the file
+	unsigned int joints;
+	iFrameCount frames;		// frames decoded
+	double keys;				// keys set on curves
+	double peakMemory;			// peak resident bytes of the process
+	iMemoryUse memory;			// held by the import at its largest
+	std::vector<iStageStats> stages;	// pipelined stages of the parser
+
+private:
+	std::vector<std::string> phaseNames;
+	std::vector<double> phaseSeconds;
+	std::vector<iAllocCount> phaseAllocs;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// phase from construction to destruction
+//
+// The phase goes to the trace as well, the report may be NULL.
+//
+class iPhaseTimer {
+public:
+	iPhaseTimer(iImportReport *rpt, const char *phaseName);
+	~iPhaseTimer();
+private:
+	iImportReport *report;
+	const char *name;
+	double begin;
+	iAllocCount allocs;		// counts at the beginning
+};
+
+// peak resident bytes of the process, 0 if unknown
+double getPeakMemory();
+
+#endif	// #ifndef __IREPORT_H__
@@ -0,0 +1,526 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "idebug.h"
+#include "iskeleton.h"
+#include "irotation.h"
+
+using namespace std;
+using namespace Rotation;
+
+// angles handled by one pass of sines & cosines
+const unsigned int rotationTile = 256;
+// beyond this (radian) angles are left to the library
+const double sinCosLimit = 1.0e6;
+// bias making quadrants of angles below the limit positive
+const int sinCosBias = 1 << 20;
+// cosines of middle angles below this are gimbal lock
+const double gimbalLockLimit = 4.0 * numeric_limits<double>::epsilon();
+
+//-----------------------------------------------------------------------------
+// wrap an angle in degrees into [-180, 180)
+//-----------------------------------------------------------------------------
+static inline double wrapDegrees(double d)
+{
+	return d - 360.0 * floor((d + 180.0) / 360.0);
+}
+
+//-----------------------------------------------------------------------------
+// sines & cosines of angles in radians
+//
+// Every angle is reduced by the nearest multiple k of pi/2, split in three
+// parts so that the remainder r within [-pi/4, pi/4] stays exact, then
+// polynomials of r give both values and the quadrant of k swaps and negates
+// them. Nothing in the loop calls the library or branches, so compilers
+// vectorize it, and the error is within 1e-15 of the library's. Tiles
+// holding an angle beyond sinCosLimit are left to the library.
+//-----------------------------------------------------------------------------
+static void sinCos(unsigned int count, const double *x, double *s, double *c)
+{
+	static const double twoOverPi = 6.36619772367581382433e-01;
+	static const double pio2a = 1.57079632673412561417e+00;	// first 33 bits of pi/2
+	static const double pio2b = 6.07710050630396597660e-11;	// next 33 bits
+	static const double pio2c = 2.02226624879595063154e-21;	// the rest
+	unsigned int i;
+
+	// NaN is beyond the limit as well
+	unsigned int beyond = 0;
+	for (i = 0; i < count; ++i) beyond += !(fabs(x[i]) < sinCosLimit);
+	if (beyond > 0) {
+		for (i = 0; i < count; ++i) {
+			s[i] = sin(x[i]);
+			c[i] = cos(x[i]);
+		}
+		return;
+	}
+
+	for (i = 0; i < count; ++i) {
+		// nearest k, biased so that truncation rounds down
+		const int k = static_cast<int>(x[i] * twoOverPi + (0.5 + sinCosBias)) - sinCosBias;
+		const double dk = k;
+		const double r = ((x[i] - dk * pio2a) - dk * pio2b) - dk * pio2c;
+		const double z = r * r;
+
+		// minimax polynomials on [-pi/4, pi/4]
+		const double sr = r + r * z * (-1.66666666666666307295e-01 + z * (8.33333333332211858878e-03
+			+ z * (-1.98412698295895385996e-04 + z * (2.75573136213857245213e-06
+			+ z * (-2.50507477628578072866e-08 + z * 1.58962301576546568060e-10)))));
+		const double cr = 1.0 - 0.5 * z + z * z * (4.16666666666665929218e-02
+			+ z * (-1.38888888888730564116e-03 + z * (2.48015872888517045348e-05
+			+ z * (-2.75573141792967388112e-07 + z * (2.08757008419747316778e-09
+			+ z * -1.13585365213876817300e-11)))));
+
+		// sin(r + k pi/2) & cos(r + k pi/2), selected by products with 0
+		// and 1, which are exact
+		const double odd = static_cast<double>(k & 1);
+		const double even = 1.0 - odd;
+		const double ss = 1.0 - static_cast<double>(k & 2);
+		const double cs = 1.0 - static_cast<double>((k + 1) & 2);
+		s[i] = ss * (even * sr + odd * cr);
+		c[i] = cs * (even * cr + odd * sr);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// sign of the cross product of base vectors, e[a] x e[b] = sign * e[c]
+//-----------------------------------------------------------------------------
+template <int A, int B>
+struct iCrossSign {
+	static double value() { return ((B - A + 3) % 3 == 1) ? 1.0 : -1.0; }
+};
+
+//-----------------------------------------------------------------------------
+// Euler angles to quaternions for the axes A, B, C (0 for x ... 2 for z)
+//-----------------------------------------------------------------------------
+template <int A, int B, int C>
+static void eulerToQuaternionT(unsigned int count,
+	const double *rx, const double *ry, const double *rz,
+	double *qx, double *qy, double *qz, double *qw, double factor)
+{
+	const double *in[3] = {rx, ry, rz};
+	double *out[3] = {qx, qy, qz};
+	const double *ra = in[A], *rb = in[B], *rc = in[C];
+	double *oa = out[A], *ob = out[B], *oc = out[C];
+
+	// all axes are known at compile time, so the quaternion products
+	// below are reduced to a few multiplications without any branch
+	const double sab = iCrossSign<A, B>::value();
+	const double sac = iCrossSign<A, C>::value();
+	const double sbc = iCrossSign<B, C>::value();
+
+	// half angles, then their sines & cosines, tile by tile
+	double h[3][rotationTile], s[3][rotationTile], c[3][rotationTile];
+	for (unsigned int first = 0; first < count; first += rotationTile) {
+		const unsigned int n = (count - first < rotationTile) ? count - first : rotationTile;
+		unsigned int i;
+		for (i = 0; i < n; ++i) {
+			h[0][i] = ra[first + i] * factor;
+			h[1][i] = rb[first + i] * factor;
+			h[2][i] = rc[first + i] * factor;
+		}
+		for (unsigned int k = 0; k < 3; ++k) sinCos(n, h[k], s[k], c[k]);
+
+		for (i = 0; i < n; ++i) {
+			const double ca = c[0][i], sa = s[0][i];
+			const double cb = c[1][i], sb = s[1][i];
+			const double cc = c[2][i], sc = s[2][i];
+
+			// p = qa * qb
+			const double pw = ca * cb;
+			const double pa = sa * cb;
+			const double pb = ca * sb;
+			const double pc = sab * sa * sb;
+
+			// q = p * qc
+			const unsigned int e = first + i;
+			qw[e] = pw * cc - pc * sc;
+			oa[e] = pa * cc + sbc * pb * sc;
+			ob[e] = pb * cc + sac * pa * sc;
+			oc[e] = pc * cc + pw * sc;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Euler angles of a matrix for the axes A, B, C
+//-----------------------------------------------------------------------------
+template <int A, int B, int C>
+static inline void extractEuler(const double (&r)[3][3], double &ra, double &rb, double &rc)
+{
+	const double s = iCrossSign<A, B>::value();
+
+	// the middle angle by its sine & cosine, which keeps it accurate near
+	// 90 degrees where asin is not
+	const double sb = s * r[A][C];
+	const double cb = sqrt(r[A][A] * r[A][A] + r[A][B] * r[A][B]);
+	rb = atan2(sb, cb);
+
+	// the last angle from the same row, unless locked, when the last
+	// rotation is folded into the first one
+	double cc = 1.0, sc = 0.0;
+	rc = 0.0;
+	if (cb > gimbalLockLimit) {
+		cc = r[A][A] / cb;
+		sc = -s * r[A][B] / cb;
+		rc = atan2(sc, cc);
+	}
+
+	// the first angle from axis B of the matrix without the last rotation,
+	// so that all three agree however close to the lock
+	const double ub = cc * r[B][B] + s * sc * r[B][A];
+	const double uc = cc * r[C][B] + s * sc * r[C][A];
+	ra = atan2(s * uc, ub);
+}
+
+//-----------------------------------------------------------------------------
+// matrices to Euler angles for the axes A, B, C
+//-----------------------------------------------------------------------------
+template <int A, int B, int C>
+static void matrixToEulerT(unsigned int count, const double *m,
+	double *rx, double *ry, double *rz, double factor)
+{
+	double *out[3] = {rx, ry, rz};
+	double *oa = out[A], *ob = out[B], *oc = out[C];
+
+	for (unsigned int i = 0; i < count; ++i) {
+		double r[3][3], ra, rb, rc;
+		for (unsigned int k = 0; k < 9; ++k) r[k / 3][k % 3] = m[k * count + i];
+		extractEuler<A, B, C>(r, ra, rb, rc);
+		oa[i] = ra * factor;
+		ob[i] = rb * factor;
+		oc[i] = rc * factor;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// quaternions to Euler angles for the axes A, B, C
+//-----------------------------------------------------------------------------
+template <int A, int B, int C>
+static void quaternionToEulerT(unsigned int count,
+	const double *qx, const double *qy, const double *qz, const double *qw,
+	double *rx, double *ry, double *rz, double factor)
+{
+	double *out[3] = {rx, ry, rz};
+	double *oa = out[A], *ob = out[B], *oc = out[C];
+
+	for (unsigned int i = 0; i < count; ++i) {
+		const double x = qx[i], y = qy[i], z = qz[i], w = qw[i];
+		double r[3][3], ra, rb, rc;
+		r[0][0] = 1.0 - 2.0 * (y * y + z * z);
+		r[0][1] = 2.0 * (x * y - w * z);
+		r[0][2] = 2.0 * (x * z + w * y);
+		r[1][0] = 2.0 * (x * y + w * z);
+		r[1][1] = 1.0 - 2.0 * (x * x + z * z);
+		r[1][2] = 2.0 * (y * z - w * x);
+		r[2][0] = 2.0 * (x * z - w * y);
+		r[2][1] = 2.0 * (y * z + w * x);
+		r[2][2] = 1.0 - 2.0 * (x * x + y * y);
+		extractEuler<A, B, C>(r, ra, rb, rc);
+		oa[i] = ra * factor;
+		ob[i] = rb * factor;
+		oc[i] = rc * factor;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// eulerToQuaternion
+//-----------------------------------------------------------------------------
+void eulerToQuaternion(int order, unsigned int count,
+	const double *rx, const double *ry, const double *rz,
+	double *qx, double *qy, double *qz, double *qw, bool degrees)
+{
+	const double factor = degrees ? (0.5 * imath::PI / 180.0) : 0.5;
+
+	switch (order) {
+	case MC_RO_XYZ: eulerToQuaternionT<0, 1, 2>(count, rx, ry, rz, qx, qy, qz, qw, factor); break;
+	case MC_RO_YZX: eulerToQuaternionT<1, 2, 0>(count, rx, ry, rz, qx, qy, qz, qw, factor); break;
+	case MC_RO_ZXY: eulerToQuaternionT<2, 0, 1>(count, rx, ry, rz, qx, qy, qz, qw, factor); break;
+	case MC_RO_ZYX: eulerToQuaternionT<2, 1, 0>(count, rx, ry, rz, qx, qy, qz, qw, factor); break;
+	case MC_RO_YXZ: eulerToQuaternionT<1, 0, 2>(count, rx, ry, rz, qx, qy, qz, qw, factor); break;
+	case MC_RO_XZY: eulerToQuaternionT<0, 2, 1>(count, rx, ry, rz, qx, qy, qz, qw, factor); break;
+	default:
+		ILOG4("Error: Invalid rotation order " << order);
+		for (unsigned int i = 0; i < count; ++i) {
+			qx[i] = qy[i] = qz[i] = 0.0;
+			qw[i] = 1.0;
+		}
+		break;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// quaternionToEuler
+//-----------------------------------------------------------------------------
+void quaternionToEuler(int order, unsigned int count,
+	const double *qx, const double *qy, const double *qz, const double *qw,
+	double *rx, double *ry, double *rz, bool degrees)
+{
+	const double factor = degrees ? (180.0 / imath::PI) : 1.0;
+
+	switch (order) {
+	case MC_RO_XYZ: quaternionToEulerT<0, 1, 2>(count, qx, qy, qz, qw, rx, ry, rz, factor); break;
+	case MC_RO_YZX: quaternionToEulerT<1, 2, 0>(count, qx, qy, qz, qw, rx, ry, rz, factor); break;
+	case MC_RO_ZXY: quaternionToEulerT<2, 0, 1>(count, qx, qy, qz, qw, rx, ry, rz, factor); break;
+	case MC_RO_ZYX: quaternionToEulerT<2, 1, 0>(count, qx, qy, qz, qw, rx, ry, rz, factor); break;
+	case MC_RO_YXZ: quaternionToEulerT<1, 0, 2>(count, qx, qy, qz, qw, rx, ry, rz, factor); break;
+	case MC_RO_XZY: quaternionToEulerT<0, 2, 1>(count, qx, qy, qz, qw, rx, ry, rz, factor); break;
+	default:
+		ILOG4("Error: Invalid rotation order " << order);
+		for (unsigned int i = 0; i < count; ++i) rx[i] = ry[i] = rz[i] = 0.0;
+		break;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// eulerToMatrix
+//-----------------------------------------------------------------------------
+void eulerToMatrix(int order, unsigned int count,
+	const double *rx, const double *ry, const double *rz,
+	double *m, bool degrees)
+{
+	// through quaternions, whose planes are borrowed from the matrix
+	double *qx = m, *qy = m + count, *qz = m + count * 2, *qw = m + count * 3;
+	eulerToQuaternion(order, count, rx, ry, rz, qx, qy, qz, qw, degrees);
+
+	// expand in place, each element reads and writes its own column only
+	for (unsigned int i = 0; i < count; ++i) {
+		const double x = qx[i], y = qy[i], z = qz[i], w = qw[i];
+		m[0 * count + i] = 1.0 - 2.0 * (y * y + z * z);
+		m[1 * count + i] = 2.0 * (x * y - w * z);
+		m[2 * count + i] = 2.0 * (x * z + w * y);
+		m[3 * count + i] = 2.0 * (x * y + w * z);
+		m[4 * count + i] = 1.0 - 2.0 * (x * x + z * z);
+		m[5 * count + i] = 2.0 * (y * z - w * x);
+		m[6 * count + i] = 2.0 * (x * z - w * y);
+		m[7 * count + i] = 2.0 * (y * z + w * x);
+		m[8 * count + i] = 1.0 - 2.0 * (x * x + y * y);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// matrixToEuler
+//-----------------------------------------------------------------------------
+void matrixToEuler(int order, unsigned int count, const double *m,
+	double *rx, double *ry, double *rz, bool degrees)
+{
+	const double factor = degrees ? (180.0 / imath::PI) : 1.0;
+
+	switch (order) {
+	case MC_RO_XYZ: matrixToEulerT<0, 1, 2>(count, m, rx, ry, rz, factor); break;
+	case MC_RO_YZX: matrixToEulerT<1, 2, 0>(count, m, rx, ry, rz, factor); break;
+	case MC_RO_ZXY: matrixToEulerT<2, 0, 1>(count, m, rx, ry, rz, factor); break;
+	case MC_RO_ZYX: matrixToEulerT<2, 1, 0>(count, m, rx, ry, rz, factor); break;
+	case MC_RO_YXZ: matrixToEulerT<1, 0, 2>(count, m, rx, ry, rz, factor); break;
+	case MC_RO_XZY: matrixToEulerT<0, 2, 1>(count, m, rx, ry, rz, factor); break;
+	default:
+		ILOG4("Error: Invalid rotation order " << order);
+		for (unsigned int i = 0; i < count; ++i) rx[i] = ry[i] = rz[i] = 0.0;
+		break;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// quaternionToMatrix
+//-----------------------------------------------------------------------------
+void quaternionToMatrix(unsigned int count,
+	const double *qx, const double *qy, const double *qz, const double *qw,
+	double *m)
+{
+	double *r[9];
+	for (unsigned int k = 0; k < 9; ++k) r[k] = m + k * count;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		const double x = qx[i], y = qy[i], z = qz[i], w = qw[i];
+		r[0][i] = 1.0 - 2.0 * (y * y + z * z);
+		r[1][i] = 2.0 * (x * y - w * z);
+		r[2][i] = 2.0 * (x * z + w * y);
+		r[3][i] = 2.0 * (x * y + w * z);
+		r[4][i] = 1.0 - 2.0 * (x * x + z * z);
+		r[5][i] = 2.0 * (y * z - w * x);
+		r[6][i] = 2.0 * (x * z - w * y);
+		r[7][i] = 2.0 * (y * z + w * x);
+		r[8][i] = 1.0 - 2.0 * (x * x + y * y);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// matrixToQuaternion
+//-----------------------------------------------------------------------------
+void matrixToQuaternion(unsigned int count, const double *m,
+	double *qx, double *qy, double *qz, double *qw)
+{
+	const double *r[9];
+	for (unsigned int k = 0; k < 9; ++k) r[k] = m + k * count;
+
+	// Shepperd's method: the largest component comes from the diagonal,
+	// the others from the skew & symmetric sums divided by it, so that
+	// half turns (w = 0) keep the signs between x, y & z
+	for (unsigned int i = 0; i < count; ++i) {
+		const double d0 = r[0][i], d1 = r[4][i], d2 = r[8][i];
+		const double t[4] = {
+			1.0 + d0 - d1 - d2,
+			1.0 - d0 + d1 - d2,
+			1.0 - d0 - d1 + d2,
+			1.0 + d0 + d1 + d2
+		};
+		unsigned int big = 3;
+		for (unsigned int k = 0; k < 3; ++k) {
+			if (t[k] > t[big]) big = k;
+		}
+		const double h = 0.5 * sqrt(t[big]);
+		const double f = 0.25 / h;
+		const double sx = (r[7][i] - r[5][i]) * f;
+		const double sy = (r[2][i] - r[6][i]) * f;
+		const double sz = (r[3][i] - r[1][i]) * f;
+		const double xy = (r[1][i] + r[3][i]) * f;
+		const double xz = (r[2][i] + r[6][i]) * f;
+		const double yz = (r[5][i] + r[7][i]) * f;
+		double x, y, z, w;
+		switch (big) {
+		case 0: x = h; y = xy; z = xz; w = sx; break;
+		case 1: x = xy; y = h; z = yz; w = sy; break;
+		case 2: x = xz; y = yz; z = h; w = sz; break;
+		default: x = sx; y = sy; z = sz; w = h; break;
+		}
+
+		// w is kept positive as ever
+		const double sign = (w < 0.0) ? -1.0 : 1.0;
+		qx[i] = x * sign;
+		qy[i] = y * sign;
+		qz[i] = z * sign;
+		qw[i] = w * sign;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// filterEuler
+//-----------------------------------------------------------------------------
+void filterEuler(int order, unsigned int count, double *rx, double *ry, double *rz)
+{
+	static const unsigned int axes[6][3] = {
+		{0, 1, 2}, {1, 2, 0}, {2, 0, 1},
+		{2, 1, 0}, {1, 0, 2}, {0, 2, 1}
+	};
+	if (!isOrderValid(order)) {
+		ILOG4("Error: Invalid rotation order " << order);
+		return;
+	}
+	if (count < 2) return;
+
+	double *r[3] = {rx, ry, rz};
+	const unsigned int b = axes[order][1];
+	unsigned int i, k;
+
+	// gimbal twins, only the middle axis is mirrored
+	//
+	vector<double> twin(count * 3);
+	double *t[3] = {&twin[0], &twin[count], &twin[count * 2]};
+	for (k = 0; k < 3; ++k) {
+		const double *src = r[k];
+		double *dst = t[k];
+		if (k == b) {
+			for (i = 0; i < count; ++i) dst[i] = 180.0 - src[i];
+		} else {
+			for (i = 0; i < count; ++i) dst[i] = src[i] + 180.0;
+		}
+	}
+
+	// whether to take the twin, given the choice of the frame before
+	// (independent for every frame)
+	//
+	vector<unsigned char> afterRaw(count), afterTwin(count);
+	for (i = 1; i < count; ++i) {
+		double rr = 0.0, tr = 0.0, rt = 0.0, tt = 0.0;
+		for (k = 0; k < 3; ++k) {
+			rr += fabs(wrapDegrees(r[k][i] - r[k][i - 1]));
+			tr += fabs(wrapDegrees(t[k][i] - r[k][i - 1]));
+			rt += fabs(wrapDegrees(r[k][i] - t[k][i - 1]));
+			tt += fabs(wrapDegrees(t[k][i] - t[k][i - 1]));
+		}
+		afterRaw[i] = (tr < rr) ? 1 : 0;
+		afterTwin[i] = (tt <= rt) ? 1 : 0;
+	}
+
+	// the choices themselves are a short chain of bits
+	//
+	vector<unsigned char> flip(count);
+	flip[0] = 0;
+	for (i = 1; i < count; ++i) {
+		flip[i] = flip[i - 1] ? afterTwin[i] : afterRaw[i];
+	}
+
+	// pick solutions, then unwrap by a prefix sum of wrapped deltas
+	//
+	vector<double> delta(count);
+	for (k = 0; k < 3; ++k) {
+		double *src = r[k];
+		const double *alt = t[k];
+		for (i = 0; i < count; ++i) {
+			delta[i] = flip[i] ? alt[i] : src[i];
+		}
+		for (i = count - 1; i > 0; --i) {
+			delta[i] = wrapDegrees(delta[i] - delta[i - 1]);
+		}
+		double sum = delta[0];
+		for (i = 1; i < count; ++i) {
+			sum += delta[i];
+			src[i] = sum;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// multiplyQuaternion
+//-----------------------------------------------------------------------------
+void multiplyQuaternion(unsigned int count,
+	const double *ax, const double *ay, const double *az, const double *aw,
+	const double *bx, const double *by, const double *bz, const double *bw,
+	double *qx, double *qy, double *qz, double *qw)
+{
+	for (unsigned int i = 0; i < count; ++i) {
+		const double x1 = ax[i], y1 = ay[i], z1 = az[i], w1 = aw[i];
+		const double x2 = bx[i], y2 = by[i], z2 = bz[i], w2 = bw[i];
+		qw[i] = w1 * w2 - x1 * x2 - y1 * y2 - z1 * z2;
+		qx[i] = w1 * x2 + x1 * w2 + y1 * z2 - z1 * y2;
+		qy[i] = w1 * y2 + y1 * w2 + z1 * x2 - x1 * z2;
+		qz[i] = w1 * z2 + z1 * w2 + x1 * y2 - y1 * x2;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// rotateVector
+//-----------------------------------------------------------------------------
+void rotateVector(unsigned int count,
+	const double *qx, const double *qy, const double *qz, const double *qw,
+	const double *vx, const double *vy, const double *vz,
+	double *ox, double *oy, double *oz)
+{
+	for (unsigned int i = 0; i < count; ++i) {
+		const double x = qx[i], y = qy[i], z = qz[i], w = qw[i];
+		const double px = vx[i], py = vy[i], pz = vz[i];
+		// t = 2 * (u x v), v' = v + w * t + u x t
+		const double tx = 2.0 * (y * pz - z * py);
+		const double ty = 2.0 * (z * px - x * pz);
+		const double tz = 2.0 * (x * py - y * px);
+		ox[i] = px + w * tx + (y * tz - z * ty);
+		oy[i] = py + w * ty + (z * tx - x * tz);
+		oz[i] = pz + w * tz + (x * ty - y * tx);
+	}
+}
@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __IROTATION_H__
+#define __IROTATION_H__
+
+///////////////////////////////////////////////////////////////////////////////
+// batch rotation kernels
+//
+// Every kernel works on arrays of count elements laid out by component
+// (structure of arrays), so that the loops over elements can be vectorized.
+// Orders are Rotation::MC_ROT_ORDER in the notation of the mocap files:
+// order "abc" stands for the rotation qa * qb * qc, which is applied to
+// vectors as c first and a last.
+//
+// Matrices are 3x3 rotations for column vectors, passed as nine planes of
+// count elements: element (row, col) of the i-th matrix is
+// m[(row * 3 + col) * count + i].
+//
+// Euler angles to quaternions (x, y, z, w)
+void eulerToQuaternion(int order, unsigned int count,
+	const double *rx, const double *ry, const double *rz,
+	double *qx, double *qy, double *qz, double *qw, bool degrees = true);
+
+// quaternions to Euler angles
+void quaternionToEuler(int order, unsigned int count,
+	const double *qx, const double *qy, const double *qz, const double *qw,
+	double *rx, double *ry, double *rz, bool degrees = true);
+
+// Euler angles to matrices
+void eulerToMatrix(int order, unsigned int count,
+	const double *rx, const double *ry, const double *rz,
+	double *m, bool degrees = true);
+
+// matrices to Euler angles
+void matrixToEuler(int order, unsigned int count, const double *m,
+	double *rx, double *ry, double *rz, bool degrees = true);
+
+// unit quaternions to matrices
+void quaternionToMatrix(unsigned int count,
+	const double *qx, const double *qy, const double *qz, const double *qw,
+	double *m);
+
+// matrices to unit quaternions
+void matrixToQuaternion(unsigned int count, const double *m,
+	double *qx, double *qy, double *qz, double *qw);
+
+// products of quaternions, q = a * b (q may be a or b)
+void multiplyQuaternion(unsigned int count,
+	const double *ax, const double *ay, const double *az, const double *aw,
+	const double *bx, const double *by, const double *bz, const double *bw,
+	double *qx, double *qy, double *qz, double *qw);
+
+// unwrap sequences of Euler angles in degrees (in place), so that every
+// frame picks the equivalent solution (360 degrees apart, or the gimbal
+// twin a + 180, 180 - b, c + 180 of order "abc") closest to the frame before
+void filterEuler(int order, unsigned int count, double *rx, double *ry, double *rz);
+
+// rotate vectors by unit quaternions, v' = q * v * ~q (v' may be v)
+void rotateVector(unsigned int count,
+	const double *qx, const double *qy, const double *qz, const double *qw,
+	const double *vx, const double *vy, const double *vz,
+	double *ox, double *oy, double *oz);
+
+#endif	// #ifndef __IROTATION_H__
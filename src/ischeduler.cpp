@@ -0,0 +1,199 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include "idebug.h"
+#include "ischeduler.h"
+
+//-----------------------------------------------------------------------------
+// constructor
+//-----------------------------------------------------------------------------
+iScheduler::iScheduler(iJob &jobobj, iCommit &commitobj) :
+	job(jobobj), commit(commitobj), threaded(false),
+	state(MC_SS_IDLE), result(MC_SUCCESS), units(0), next(0), begun(false)
+{
+	initMutex(lock);
+}
+
+//-----------------------------------------------------------------------------
+// destructor
+//-----------------------------------------------------------------------------
+iScheduler::~iScheduler()
+{
+	// the job has to be gone before its owner
+	cancel();
+	if (threaded) joinThread(thread);
+	freeMutex(lock);
+}
+
+//-----------------------------------------------------------------------------
+// the background thread
+//-----------------------------------------------------------------------------
+THREAD_PROC iScheduler::jobProc(void *arg)
+{
+	iScheduler *scheduler = static_cast<iScheduler *>(arg);
+	const int value = scheduler->job.work(scheduler->cancelFlag);
+
+	lockMutex(scheduler->lock);
+	if (scheduler->cancelFlag.isCancelled() || MC_CANCELLED == value) {
+		scheduler->state = MC_SS_CANCELLED;
+	} else if (MC_SUCCESS != value) {
+		scheduler->state = MC_SS_FAILED;
+	} else {
+		scheduler->state = MC_SS_COMMITTING;
+	}
+	scheduler->result = value;
+	unlockMutex(scheduler->lock);
+
+	return THREAD_RETURN;
+}
+
+//-----------------------------------------------------------------------------
+// start
+//-----------------------------------------------------------------------------
+int iScheduler::start()
+{
+	if (MC_SS_IDLE != getState()) return MC_FATAL_ERROR;
+
+	lockMutex(lock);
+	state = MC_SS_WORKING;
+	unlockMutex(lock);
+	if (!startThread(thread, jobProc, this)) {
+		// without a thread the job is done right now
+		ILOG3 ("Warning: Cannot start a thread for the job");
+		jobProc(this);
+	} else {
+		threaded = true;
+	}
+
+	return MC_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// finish with a result
+//-----------------------------------------------------------------------------
+void iScheduler::finish(int current, int value)
+{
+	lockMutex(lock);
+	state = current;
+	result = value;
+	unlockMutex(lock);
+}
+
+//-----------------------------------------------------------------------------
+// stop the commits before their end, undoing them
+//-----------------------------------------------------------------------------
+void iScheduler::stop(int current, int value)
+{
+	if (begun) {
+		ILOG2 ("Rollback of " << next << " units committed");
+		commit.rollback();
+	}
+	finish(current, value);
+}
+
+//-----------------------------------------------------------------------------
+// idle
+//-----------------------------------------------------------------------------
+int iScheduler::idle(double budget)
+{
+	int current = getState();
+	if (MC_SS_COMMITTING != current) return current;
+
+	// the job is over, so its thread is joined at once
+	if (threaded) {
+		joinThread(thread);
+		threaded = false;
+	}
+	if (cancelFlag.isCancelled()) {
+		stop(MC_SS_CANCELLED, MC_CANCELLED);
+		return getState();
+	}
+
+	const double deadline = getWallTime() + budget;
+	int value = MC_SUCCESS;
+	if (!begun) {
+		begun = true;
+		value = commit.begin();
+		units = commit.countUnits();
+	}
+	// one unit at least, so that every call makes progress
+	while (MC_SUCCESS == value && next < units && !cancelFlag.isCancelled()) {
+		value = commit.commit(next++);
+		if (getWallTime() >= deadline) break;
+	}
+	// a cancel is checked before end(), which leaves nothing to undo
+	if (MC_SUCCESS != value) {
+		stop(MC_SS_FAILED, value);
+	} else if (cancelFlag.isCancelled()) {
+		stop(MC_SS_CANCELLED, MC_CANCELLED);
+	} else if (next >= units) {
+		value = commit.end();
+		if (MC_SUCCESS != value) {
+			stop(MC_SS_FAILED, value);
+		} else {
+			finish(MC_SS_DONE, value);
+		}
+	}
+
+	return getState();
+}
+
+//-----------------------------------------------------------------------------
+// wait
+//-----------------------------------------------------------------------------
+int iScheduler::wait(double budget)
+{
+	while (!isFinished()) {
+		if (MC_SS_COMMITTING != idle(budget)) pauseThread();
+	}
+	return getState();
+}
+
+//-----------------------------------------------------------------------------
+// getState
+//-----------------------------------------------------------------------------
+int iScheduler::getState()
+{
+	lockMutex(lock);
+	const int current = state;
+	unlockMutex(lock);
+	return current;
+}
+
+//-----------------------------------------------------------------------------
+// isFinished
+//-----------------------------------------------------------------------------
+bool iScheduler::isFinished()
+{
+	const int current = getState();
+	return (MC_SS_DONE == current || MC_SS_FAILED == current || MC_SS_CANCELLED == current);
+}
+
+//-----------------------------------------------------------------------------
+// getProgress
+//-----------------------------------------------------------------------------
+double iScheduler::getProgress()
+{
+	switch (getState()) {
+	case MC_SS_IDLE:
+		return 0.0;
+	case MC_SS_WORKING:
+		return 0.5 * job.getProgress();
+	case MC_SS_COMMITTING:
+		return (units > 0) ? 0.5 + 0.5 * next / units : 0.5;
+	}
+	return 1.0;
+}
@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __ISCHEDULER_H__
+#define __ISCHEDULER_H__
+
+#include "iskeleton.h"
+#include "ithread.h"
+#include "iparallel.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// interface of work done by a background thread
+//
+class iJob {
+public:
+	iJob() : progress(0.0) {}
+	virtual ~iJob() {}
+	// do the work, return a MCDATA_RESULT value; cancel is to be polled
+	virtual int work(iCancelFlag &cancel) = 0;
+	// progress of the work (0 ... 1)
+	double getProgress() const { return progress; }
+
+protected:
+	void setProgress(double value) { progress = value; }
+
+private:
+	volatile double progress;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// interface of work committed by short slices in the main thread
+//
+// Units are committed in order once the job is done, begin() before the
+// first and end() after the last one. If the commits stop before end() has
+// succeeded, by a failure or a cancel, rollback() undoes what begin() and
+// the units committed so far have made.
+//
+class iCommit {
+public:
+	virtual ~iCommit() {}
+	virtual int begin() { return MC_SUCCESS; }
+	virtual unsigned int countUnits() = 0;
+	virtual int commit(unsigned int idx) = 0;
+	virtual int end() { return MC_SUCCESS; }
+	virtual void rollback() {}
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// class running a job in the background and committing it by slices
+//
+// Nothing but idle() is called from the main thread, so the scheduler can
+// be driven by an idle callback of the host or by wait() without one.
+//
+class iScheduler {
+public:
+	enum MC_SCHEDULER_STATE {
+		MC_SS_IDLE,			// not started
+		MC_SS_WORKING,		// job is running
+		MC_SS_COMMITTING,	// units are being committed
+		MC_SS_DONE,
+		MC_SS_FAILED,
+		MC_SS_CANCELLED
+	};
+
+	// constructor & destructor
+	iScheduler(iJob &jobobj, iCommit &commitobj);
+	~iScheduler();
+
+	// start the job
+	int start();
+	// give the main thread's time, return the state
+	int idle(double budget);
+	// drive idle() until finished, as a main loop would
+	int wait(double budget = 0.01);
+	// stop the job or the commits as soon as possible
+	void cancel() { cancelFlag.cancel(); }
+
+	// get state
+	int getState();
+	int getResult() { return result; }
+	bool isFinished();
+	// progress, half for the job and half for the commits
+	double getProgress();
+
+private:
+	iJob &job;
+	iCommit &commit;
+	iCancelFlag cancelFlag;
+	iThread thread;
+	bool threaded;			// thread has to be joined
+	iMutex lock;			// guards state & result
+	int state;
+	int result;
+	unsigned int units;		// to be committed
+	unsigned int next;		// next unit
+	bool begun;				// begin() has been called
+
+	static THREAD_PROC jobProc(void *arg);
+	void finish(int current, int value);
+	void stop(int current, int value);
+};
+
+#endif	// #ifndef __ISCHEDULER_H__
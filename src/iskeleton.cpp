@@ -18,6 +18,12 @@
 
 #include "idebug.h"
 #include "iskeleton.h"
+#include "irotation.h"
+#include "iparallel.h"
+#include "iclipsampler.h"
+
+// frames converted by a job at one time
+const unsigned int convertBlockFrames = 512;
 
 using namespace std;
 using namespace imath;
@@ -26,7 +32,7 @@ using namespace imath;
 namespace Rotation {
 	bool isOrderValid(int order)
 	{
-		if (order < MC_RO_XYZ || order > MC_RO_XZY) return false;
+		if (order < static_cast<int>(MC_RO_XYZ) || order > static_cast<int>(MC_RO_XZY)) return false;
 		return true;
 	}
 
@@ -65,35 +71,315 @@ namespace Rotation {
 	}
 }
 //---------------------------------------------------------------------------
-void iSkeleton::iJoint::preOrder(TRANVERSE_CALLBACK visit, icallbackData *data)
+// build the preorder array
+//---------------------------------------------------------------------------
+void iSkeleton::rebuildNodes()
+{
+	nodes.clear();
+	dirty = false;
+	if (NULL == root) return;
+	nodes.reserve(dict.size());
+
+	// explicit stack instead of recursion, children are pushed reversely
+	// to keep them in their original order
+	vector<iNode> stack;
+	iNode node;
+	node.joint = root;
+	node.depth = 0;
+	node.parent = -1;
+	stack.push_back(node);
+	while (!stack.empty()) {
+		iNode top = stack.back();
+		stack.pop_back();
+		const int idx = static_cast<int>(nodes.size());
+		top.joint->setIndex(idx);
+		nodes.push_back(top);
+
+		for (unsigned int i = top.joint->countChildren(); i > 0; --i) {
+			node.joint = top.joint->getChild(i - 1);
+			node.depth = top.depth + 1;
+			node.parent = idx;
+			stack.push_back(node);
+		}
+	}
+	ILOG1 ("Preorder rebuilt with " << nodes.size() << " joints");
+}
+
+//---------------------------------------------------------------------------
+// add memory held by a joint
+//---------------------------------------------------------------------------
+void iSkeleton::iJoint::measureMemory(iMemoryUse &use)
+{
+	iMemoryUse::iJointUse jointUse;
+	jointUse.name = name;
+	jointUse.motion = static_cast<double>(motion.size() * sizeof(iFrame));
+	jointUse.slack = static_cast<double>((motion.capacity() - motion.size()) * sizeof(iFrame));
+
+	use.hierarchy += sizeof(iJoint) + children.capacity() * sizeof(iJoint *);
+	use.names += name.capacity() + 1;
+	use.caches += motion.countChunks() * sizeof(iFrame *);
+	for (size_t c = 0; c < motion.countChunks(); ++c) {
+		if (isChunkSpilled(motion.getChunk(c))) use.spilled += chunkSize * sizeof(iFrame);
+	}
+	use.motion += jointUse.motion;
+	use.slack += jointUse.slack;
+	use.joints.push_back(jointUse);
+}
+
+//---------------------------------------------------------------------------
+// measure memory held by the skeleton
+//---------------------------------------------------------------------------
+void iSkeleton::measureMemory(iMemoryUse &use)
+{
+	use.clear();
+	flatten();
+	use.joints.reserve(nodes.size());
+	for (unsigned int i = 0; i < nodes.size(); ++i) nodes[i].joint->measureMemory(use);
+
+	// a tree node of the dictionary holds a color and three links
+	const double treeNode = sizeof(valType) + sizeof(int) + 3 * sizeof(void *);
+	map<string, iJoint *>::const_iterator iter;
+	for (iter = dict.begin(); iter != dict.end(); ++iter) {
+		use.names += iter->first.capacity() + 1;
+	}
+	use.hierarchy += sizeof(iSkeleton);
+	use.names += name.capacity() + 1;
+	use.caches += dict.size() * treeNode + nodes.capacity() * sizeof(iNode);
+}
+
+//---------------------------------------------------------------------------
+// filter rotations of a motion
+//---------------------------------------------------------------------------
+static void filterMotion(int order, iSkeleton::iMotion &motion)
+{
+	const unsigned int count = static_cast<unsigned int>(motion.size());
+	if (count < 2) return;
+
+	vector<double> r(count * 3);
+	double *rx = &r[0], *ry = &r[count], *rz = &r[count * 2];
+	unsigned int i;
+	for (i = 0; i < count; ++i) {
+		const iSkeleton::iFrameVec &rot = motion[i].rotation;
+		rx[i] = rot.x; ry[i] = rot.y; rz[i] = rot.z;
+	}
+	filterEuler(order, count, rx, ry, rz);
+	for (i = 0; i < count; ++i) {
+		motion[i].rotation.set(rx[i], ry[i], rz[i]);
+	}
+}
+
+//---------------------------------------------------------------------------
+// job running indices [first, ...) of another job, as a node of a graph
+//---------------------------------------------------------------------------
+class iSliceTask : public iTask {
+	iTask *task;
+	unsigned int first;
+public:
+	iSliceTask(iTask &tsk, unsigned int start) : task(&tsk), first(start) {}
+	void run(unsigned int idx) { task->run(first + idx); }
+};
+
+//---------------------------------------------------------------------------
+// job filtering rotations of a joint
+//---------------------------------------------------------------------------
+class iFilterTask : public iTask {
+	iSkeleton &skel;
+	std::vector<iSkeleton::iJoint *> &joints;	// joints to be filtered
+public:
+	iFilterTask(iSkeleton &skobj, std::vector<iSkeleton::iJoint *> &jots) :
+		skel(skobj), joints(jots) {}
+	void run(unsigned int idx) {
+		iSkeleton::iJoint *jot = joints[idx];
+		filterMotion(skel.getRotOrder(jot), jot->motion);
+	}
+};
+
+//---------------------------------------------------------------------------
+// job converting a block of frames of a joint
+//---------------------------------------------------------------------------
+class iReorderTask : public iTask {
+	std::vector<iSkeleton::iJoint *> &joints;	// joints to be converted
+	std::vector<int> &sources;					// their orders
+	int target;
+	unsigned int blocks;						// blocks per joint
+public:
+	iReorderTask(std::vector<iSkeleton::iJoint *> &jots, std::vector<int> &orders,
+		int order, unsigned int count) :
+		joints(jots), sources(orders), target(order), blocks(count) {}
+	void run(unsigned int idx) {
+		iSkeleton::iJoint *jot = joints[idx / blocks];
+		iSkeleton::iMotion &motion = jot->motion;
+		const unsigned int begin = (idx % blocks) * convertBlockFrames;
+		if (begin >= motion.size()) return;
+		unsigned int end = begin + convertBlockFrames;
+		if (end > motion.size()) end = static_cast<unsigned int>(motion.size());
+		const unsigned int count = end - begin;
+
+		double rx[convertBlockFrames] = {0.0}, ry[convertBlockFrames] = {0.0};
+		double rz[convertBlockFrames] = {0.0};
+		double qx[convertBlockFrames], qy[convertBlockFrames], qz[convertBlockFrames];
+		double qw[convertBlockFrames];
+		unsigned int i;
+		for (i = 0; i < count; ++i) {
+			const iSkeleton::iFrameVec &r = motion[begin + i].rotation;
+			rx[i] = r.x; ry[i] = r.y; rz[i] = r.z;
+		}
+		eulerToQuaternion(sources[idx / blocks], count, rx, ry, rz, qx, qy, qz, qw);
+		quaternionToEuler(target, count, qx, qy, qz, qw, rx, ry, rz);
+		for (i = 0; i < count; ++i) {
+			motion[begin + i].rotation.set(rx[i], ry[i], rz[i]);
+		}
+	}
+};
+
+//---------------------------------------------------------------------------
+// re-express rotations of all joints in another order
+//---------------------------------------------------------------------------
+int iSkeleton::convertRotOrder(int order, unsigned int threads, iCancelFlag *cancel)
 {
-	ILOG1 ("Visit joint " << name << " by preorder @ level " << data->getLevel());
-	IASSERT(NULL != data);
-	(*visit)(this, data);		// callback function
-	vector<iJoint *>::iterator iter;
-	data->levelInc();
-	//data->offsetAdd(this);
-	for (iter = children.begin(); iter != children.end(); ++iter) {
-		(*iter)->preOrder(visit, data);
+	ITRACE_SCOPE("convertRotOrder");
+	if (!Rotation::isOrderValid(order)) return MC_ILLEAGAL_DATA;
+
+	// joints whose order differs
+	//
+	vector<iJoint *> joints;
+	vector<int> sources;
+	unsigned int longest = 0;
+	const unsigned int count = countJoints();
+	for (unsigned int j = 0; j < count; ++j) {
+		iJoint *jot = nodes[j].joint;
+		const int source = getRotOrder(jot);
+		jot->setRotOrder(order);
+		if (source == order) continue;
+
+		// base rotation
+		iVec base, q;
+		double qw;
+		jot->getRotation(base);
+		eulerToQuaternion(source, 1, &base.x, &base.y, &base.z, &q.x, &q.y, &q.z, &qw);
+		quaternionToEuler(order, 1, &q.x, &q.y, &q.z, &qw, &base.x, &base.y, &base.z);
+		jot->setRotation(base);
+
+		joints.push_back(jot);
+		sources.push_back(source);
+		if (jot->motion.size() > longest) longest = static_cast<unsigned int>(jot->motion.size());
 	}
-	//data->offsetSub(this);
-	data->levelDec();
+	rotationOrder = order;
+
+	// motion, by blocks of frames; angles out of quaternions are principal
+	// values, so the blocks of a joint are then filtered to keep them
+	// continuous, which waits for that joint only
+	//
+	if (!joints.empty() && longest > 0) {
+		const unsigned int blocks = (longest + convertBlockFrames - 1) / convertBlockFrames;
+		iReorderTask task(joints, sources, order, blocks);
+		iFilterTask filter(*this, joints);
+		vector<iSliceTask> slices;
+		slices.reserve(joints.size() * 2);
+		iTaskGraph graph;
+		for (unsigned int j = 0; j < joints.size(); ++j) {
+			slices.push_back(iSliceTask(task, j * blocks));
+			slices.push_back(iSliceTask(filter, j));
+			const unsigned int converted = graph.add(slices[j * 2], blocks);
+			graph.depend(graph.add(slices[j * 2 + 1]), converted);
+		}
+		if (!graph.run(threads, cancel)) return MC_CANCELLED;
+	}
+	ILOG1 (joints.size() << " joints converted to rotation order " << Rotation::getStringFromOrder(order));
+
+	return MC_SUCCESS;
 }
 
 //---------------------------------------------------------------------------
-void iSkeleton::iJoint::postOrder(TRANVERSE_CALLBACK visit, icallbackData *data)
+// remove flips and wraps from rotations of all joints
+//---------------------------------------------------------------------------
+int iSkeleton::filterRotations(unsigned int threads, iCancelFlag *cancel)
 {
-	vector<iJoint *>::iterator iter;
-	IASSERT(NULL != data);
-	data->levelInc();
-	//data->offsetAdd(this);
-	for (iter = children.begin(); iter != children.end(); ++iter) {
-		(*iter)->preOrder(visit, data);
+	ITRACE_SCOPE("filterRotations");
+	if (empty()) return MC_INVALID_SKELETON;
+
+	// every joint is a sequential chain, joints are independent
+	const unsigned int count = countJoints();
+	vector<iJoint *> joints(count);
+	for (unsigned int j = 0; j < count; ++j) joints[j] = nodes[j].joint;
+	iFilterTask task(*this, joints);
+	if (!parallelFor(count, task, threads, cancel)) return MC_CANCELLED;
+	ILOG1 ("Rotations of " << count << " joints filtered");
+
+	return MC_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+// job resampling motion of a joint
+//---------------------------------------------------------------------------
+class iResampleTask : public iTask {
+	iSkeleton &skel;
+	const iClipSampler &sampler;
+	const vector<double> &times;
+public:
+	iResampleTask(iSkeleton &skobj, const iClipSampler &smp, const vector<double> &tms) :
+		skel(skobj), sampler(smp), times(tms) {}
+	void run(unsigned int idx) {
+		iSkeleton::iJoint *jot = skel.getNode(idx).joint;
+		if (jot->motion.empty()) return;
+		const size_t count = times.size();
+		iSkeleton::iMotion motion;
+		motion.resize(count);
+		// chunk by chunk, as frames are contiguous within a chunk only
+		for (size_t first = 0; first < count; first += chunkSize) {
+			const unsigned int n = static_cast<unsigned int>((count - first < chunkSize) ? count - first : chunkSize);
+			sampler.sampleJoint(idx, &times[first], n, motion.getChunk(first >> chunkShift));
+		}
+		// angles out of quaternions are principal values, keep them continuous
+		filterMotion(skel.getRotOrder(jot), motion);
+		jot->motion.swap(motion);
 	}
-	//data->offsetSub(this);
-	data->levelDec();
-	ILOG1 ("Visit joint " << name << " by postorder @ level " << data->getLevel());
-	(*visit)(this, data);		// callback function
+};
+
+//---------------------------------------------------------------------------
+// resample a range of frames of all joints at another interval
+//---------------------------------------------------------------------------
+int iSkeleton::resample(double interval, iFrameCount first, iFrameCount last, unsigned int threads,
+	iCancelFlag *cancel)
+{
+	ITRACE_SCOPE("resample");
+	if (empty()) return MC_INVALID_SKELETON;
+	if (interval <= 0.0 || frameTime <= 0.0) return MC_ILLEAGAL_DATA;
+	if (last > frames) last = frames;
+	if (first >= last) return MC_ILLEAGAL_DATA;
+	if (frames < 2 || (interval == frameTime && 0 == first && last == frames)) return MC_SUCCESS;
+
+	// the sampler keeps a copy, joints are rewritten in place
+	iClipSampler sampler;
+	int result = sampler.prepare(*this);
+	if (MC_SUCCESS != result) return result;
+
+	// the last new frame never passes the end of the range
+	const double begin = static_cast<double>(first) * frameTime;
+	const double duration = static_cast<double>(last - 1 - first) * frameTime;
+	const size_t count = static_cast<size_t>(duration / interval + 1.0e-6) + 1;
+	vector<double> times(count);
+	for (size_t i = 0; i < count; ++i) times[i] = begin + interval * i;
+
+	// a cancelled take is left part resampled, only good to be dropped
+	iResampleTask task(*this, sampler, times);
+	if (!parallelFor(countJoints(), task, threads, cancel)) return MC_CANCELLED;
+	ILOG1 ("Frames " << first << " to " << last << " of " << frames << " resampled to " << count << " frames");
+
+	frames = count;
+	frameTime = interval;
+
+	return MC_SUCCESS;
+}
+
+//---------------------------------------------------------------------------
+// destructor
+//---------------------------------------------------------------------------
+iSkeleton::~iSkeleton()
+{
+	// every joint is in the dictionary
+	map<string, iJoint *>::iterator iter;
+	for (iter = dict.begin(); iter != dict.end(); ++iter) delete iter->second;
 }
 
 //---------------------------------------------------------------------------
@@ -126,10 +412,12 @@ int iSkeleton::addJoint(const string &name, const iVec &of, const iVec &rot, con
 		// otherwise ...
 		root = current = baby;
 		dict.insert(valType(name, baby));
+		dirty = true;
 	} else {
 		// current is not point to root
 		current->addChild(baby);
 		dict.insert(valType(name, baby));
+		dirty = true;
 		// go down
 		current = baby;
 	}
@@ -22,6 +22,9 @@
 #include <map>
 
 #include "imath.hpp"
+#include "ichunkvector.h"
+
+class iCancelFlag;
 
 ///////////////////////////////////////////////////////////////////////////////
 // result values
@@ -34,7 +37,9 @@ enum MCDATA_RESULT {
 	MC_INVALID_JOINT,
 	MC_DUP_JOINT_NAME,
 	MC_ILLEAGAL_DATA,
-	MC_FATAL_ERROR
+	MC_FATAL_ERROR,
+	MC_CANCELLED,
+	MC_OUT_OF_MEMORY
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -51,6 +56,84 @@ namespace Rotation {
 	std::string getStringFromOrder(int order);
 };
 
+///////////////////////////////////////////////////////////////////////////////
+namespace Channel {
+	enum MC_CHANNEL {
+		MC_CH_TX, MC_CH_TY, MC_CH_TZ,
+		MC_CH_RX, MC_CH_RY, MC_CH_RZ,
+		MC_CH_COUNT
+	};
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// memory held by a skeleton, in bytes
+//
+// Containers are measured by their capacity, tree nodes of the dictionary
+// by their payload and links, overhead of the heap is not counted.
+//
+struct iMemoryUse {
+	struct iJointUse {
+		std::string name;
+		double motion;			// frames in use
+		double slack;			// capacity beyond them
+	};
+
+	double hierarchy;			// the skeleton, joints and links between them
+	double names;				// characters of names and keys
+	double motion;				// frames in use
+	double slack;				// capacity of motion beyond the frames in use
+	double caches;				// the dictionary and the preorder array
+	double spilled;				// chunks in the spill file, part of the above
+	std::vector<iJointUse> joints;	// motion of every joint in preorder
+
+	iMemoryUse() { clear(); }
+	void clear() {
+		hierarchy = names = motion = slack = caches = spilled = 0.0;
+		joints.clear();
+	}
+	double getTotal() const { return hierarchy + names + motion + slack + caches; }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// count or index of frames
+//
+// 64-bit from the header of a file to the keys of its curves, so that no
+// take is cut by its length.
+//
+typedef unsigned long long iFrameCount;
+
+///////////////////////////////////////////////////////////////////////////////
+// scalar of stored motion
+//
+// Frames are kept in float, which holds every digit mocap files carry,
+// unless built with IMOCAP_DOUBLE_MOTION ("jam -sDOUBLE_MOTION=1").
+// Stages converting rotations, slerping or solving transforms load frames
+// into scratch arrays of double, so they keep double precision either way.
+// It is a flag of the build rather than a parameter of iSkeleton, since a
+// take is stored once in one precision, and every parser, pass & clip would
+// otherwise be instantiated twice for no digit gained.
+//
+#if defined (IMOCAP_DOUBLE_MOTION)
+typedef double iMotionReal;
+#else
+typedef float iMotionReal;
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// frame of a joint in a precision
+//
+template <class Real>
+struct iFrameOf {
+	imath::iVector<Real> offset;
+	imath::iVector<Real> rotation;
+	Real scale;		// bone length scale of HTR files
+	iFrameOf() : scale(1) {}
+	// from a frame of another precision
+	template <class U>
+	explicit iFrameOf(const iFrameOf<U> &fm) : offset(fm.offset), rotation(fm.rotation),
+		scale(static_cast<Real>(fm.scale)) {}
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // class for skeletons
 //
@@ -58,13 +141,12 @@ class iSkeleton {
 public:
 
 	//////////////////////////////////////
-	// inner struct for motion data
+	// types of motion data
 	//
-	struct iFrame {
-		imath::iVec offset;
-		imath::iVec rotation;
-		double scale;
-	};
+	typedef iFrameOf<iMotionReal> iFrame;
+	typedef imath::iVector<iMotionReal> iFrameVec;
+	// frames of a joint, grown by chunks without moving the ones in place
+	typedef iChunkVector<iFrame> iMotion;
 	//
 	//////////////////////////////////////
 
@@ -88,25 +170,16 @@ public:
 		imath::iVec offset;
 		imath::iVec rotation;
 		double length;		// reserved for .htr/.htr2 format
+		unsigned int index;	// position in preorder
+		int order;			// rotation order of motion, MC_RO_NONE for the skeleton's
 	public:
-		// define a callback type
-		class icallbackData {
-			unsigned int level;
-		public:
-			icallbackData() : level(0) {}
-			virtual ~icallbackData() {}
-			unsigned int getLevel() { return level; }
-			void levelInc() { ++level; }
-			void levelDec() { --level; }
-		};
-		typedef void (* TRANVERSE_CALLBACK)(iJoint *item, icallbackData *data);
-
 		// motion data
-		std::vector<iFrame> motion;
+		iMotion motion;
 
 		// constructor
-        iJoint() : father(NULL), length(0.0), accessory(NULL) {}
-		iJoint(const std::string &nick) : father(NULL), name(nick), length(0.0), accessory(NULL) {}
+        iJoint() : accessory(NULL), father(NULL), length(0.0), index(0), order(Rotation::MC_RO_NONE) {}
+		iJoint(const std::string &nick) : accessory(NULL), name(nick), father(NULL), length(0.0),
+			index(0), order(Rotation::MC_RO_NONE) {}
 		// destructor
 		~iJoint() {
 			// remove additional data
@@ -130,6 +203,12 @@ public:
 		// get/set length
 		double getLength() { return length; }
 		void setLength(double len) { length = len; }
+		// get/set index in preorder
+		unsigned int getIndex() { return index; }
+		void setIndex(unsigned int idx) { index = idx; }
+		// get/set rotation order
+		int getRotOrder() { return order; }
+		void setRotOrder(int ord) { order = ord; }
 		// get/set accessory
 		iaccessory *getAccessory() { return accessory; }
 		void setAccessory(iaccessory *data) { accessory = data; }
@@ -181,10 +260,8 @@ public:
 		unsigned int countChildren() {
 			return static_cast<unsigned int>(children.size());		// should be vector<iJoint*>::sizetype ??
 		}
-		// preorder scan
-		void preOrder(TRANVERSE_CALLBACK visit, icallbackData *data);
-		// postorder scan
-		void postOrder(TRANVERSE_CALLBACK visit, icallbackData *data);
+		// add memory held by the joint
+		void measureMemory(iMemoryUse &use);
 		// print itself
 		friend std::ostream& operator<<(std::ostream &out, iJoint &temp) {
 			temp.output(out);
@@ -200,13 +277,24 @@ public:
 	//
 	//////////////////////////////////////
 
+	//////////////////////////////////////
+	// inner struct for flat traversal
+	//
+	struct iNode {
+		iJoint *joint;
+		unsigned int depth;		// 0 for root
+		int parent;				// index of parent in preorder, -1 for root
+	};
+	//
+	//////////////////////////////////////
+
 	typedef std::map<std::string, iJoint *>::value_type valType;
 
 	// constructor
-	iSkeleton() : root(NULL), current(NULL), rotationOrder(Rotation::MC_RO_ZXY),
+	iSkeleton() : root(NULL), current(NULL), dirty(false), rotationOrder(Rotation::MC_RO_ZXY),
 		frames(0), frameTime(0.4), scaleOrientation(0), haveTranslation(false) {}
-	// destructor
-	//virtual ~iSkeleton() {}
+	// destructor, joints & their motion go with the skeleton
+	~iSkeleton();
 	// empty
 	bool empty() { return (NULL == root); }
 	// exist
@@ -221,12 +309,28 @@ public:
 	// get a joint from current pointer
 	iJoint *getJoint();
 	// set/get parameters
-	void setFrames(unsigned int count) { frames = count; }
-	unsigned int getFrames() { return frames; }
+	void setFrames(iFrameCount count) { frames = count; }
+	iFrameCount getFrames() { return frames; }
 	void setFrameTime(double time) { frameTime = time; }
 	double getFrameTime() { return frameTime; }
 	void setRotOrder(int ord) { rotationOrder = ord; }
 	int getRotOrder() { return rotationOrder; }
+	// rotation order of a joint, the skeleton's one if it has none
+	int getRotOrder(iJoint *joint) {
+		const int ord = (NULL != joint) ? joint->getRotOrder() : static_cast<int>(Rotation::MC_RO_NONE);
+		return Rotation::isOrderValid(ord) ? ord : rotationOrder;
+	}
+	// re-express rotations of all joints in another order
+	int convertRotOrder(int order, unsigned int threads = 0, iCancelFlag *cancel = NULL);
+	// remove flips and wraps from rotations of all joints
+	int filterRotations(unsigned int threads = 0, iCancelFlag *cancel = NULL);
+	// resample frames [first, last) of all joints at another interval
+	// (seconds), only that range of the take is kept (MC_CANCELLED leaves
+	// joints part resampled)
+	int resample(double interval, iFrameCount first, iFrameCount last, unsigned int threads = 0,
+		iCancelFlag *cancel = NULL);
+	// measure memory held by the skeleton and its motion
+	void measureMemory(iMemoryUse &use);
 	void setScaleOrientation(unsigned int o) { scaleOrientation = o; }
 	unsigned int getScaleOrientation() { return scaleOrientation; }
 	void setHaveTranslation(bool o) { haveTranslation = o; }
@@ -270,6 +374,19 @@ public:
 	// move current pointer here
 	int goHere(iJoint *joint);
 
+	// quantity of joints
+	unsigned int countJoints() { flatten(); return static_cast<unsigned int>(nodes.size()); }
+	// get a joint from it's index in preorder
+	iNode &getNode(unsigned int idx) { flatten(); return nodes[idx]; }
+	// visit every joint by preorder, parents always come before children
+	// visitor is called as visitor(iNode &node, unsigned int idx)
+	template <typename V>
+	void traverse(V &visitor) {
+		flatten();
+		const unsigned int count = static_cast<unsigned int>(nodes.size());
+		for (unsigned int i = 0; i < count; ++i) visitor(nodes[i], i);
+	}
+
 	// print itself
 	friend std::ostream& operator<<(std::ostream &out, iSkeleton &temp) {
 		temp.output(out);
@@ -281,26 +398,33 @@ private:
 	iJoint *current;
 	// add this map to speed up progress of motion data loading 
 	std::map<std::string, iJoint *> dict;
+	// joints in preorder, rebuilt after adding joints
+	std::vector<iNode> nodes;
+	bool dirty;
 
 	// motion parameters
 	int rotationOrder;
-	unsigned int frames;
+	iFrameCount frames;
 	double frameTime;
 
 	// extra properties for HTR files
 	unsigned int scaleOrientation;
 	bool haveTranslation;
 
+	// joints are owned, not to be copied
+	iSkeleton(const iSkeleton &);
+	iSkeleton &operator=(const iSkeleton &);
+
+	// build the preorder array
+	void flatten() { if (dirty) rebuildNodes(); }
+	void rebuildNodes();
+
 	// overriding standard output operator
 	void output(std::ostream &out) {
-		if (NULL != root) outputFamily(out, root);
-	}
-
-	void outputFamily(std::ostream &out, iJoint *joint, unsigned int level = 0) {
-		const std::string leading(level, ' ');
-		out << leading << *joint << std::endl;
-		for (unsigned int i = 0; i < joint->countChildren(); ++i) {
-			outputFamily(out, joint->getChild(i), level + 1);
+		flatten();
+		for (unsigned int i = 0; i < nodes.size(); ++i) {
+			const std::string leading(nodes[i].depth, ' ');
+			out << leading << *(nodes[i].joint) << std::endl;
 		}
 	}
 };
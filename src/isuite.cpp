@@ -0,0 +1,1764 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "ithread.h"
+#include "ichunkstore.h"
+#include "iclipsampler.h"
+#include "iclipstream.h"
+#include "ichannel.h"
+#include "imocapdatabvh.h"
+#include "imocapdatahtr.h"
+#include "ikinematics.h"
+#include "iparallel.h"
+#include "ireduce.h"
+#include "irotation.h"
+#include "ischeduler.h"
+#include "isuite.h"
+#include "itrace.h"
+
+using namespace std;
+
+//////////////////////////////////////
+// state of a running suite
+//
+struct iSuiteContext {
+	string scratch;				// folder for files
+	ostream &out;
+	iBenchmarkMetrics *metrics;	// NULL for none
+	unsigned int failures;
+
+	iSuiteContext(const string &folder, ostream &stream, iBenchmarkMetrics *table) :
+		scratch(folder), out(stream), metrics(table), failures(0) {}
+
+	// a check passes when the condition holds
+	void check(const char *what, bool passed) {
+		char line[256];
+		sprintf(line, "  %-6s %s", passed ? "ok" : "FAILED", what);
+		out << line << "\n";
+		if (!passed) ++failures;
+	}
+	// a check passes when the error is within the tolerance, NaN fails
+	void check(const char *what, double error, double tolerance) {
+		char line[256];
+		const bool passed = (error <= tolerance);
+		sprintf(line, "  %-6s %-48s error %.3g (tolerance %.3g)",
+			passed ? "ok" : "FAILED", what, error, tolerance);
+		out << line << "\n";
+		if (!passed) ++failures;
+	}
+	// add a metric of the suite
+	void addMetric(const char *suite, const char *name, double value) {
+		char line[256];
+		sprintf(line, "  %-6s %-48s %.4g", "rate", name, value);
+		out << line << "\n";
+		if (NULL == metrics) return;
+		sprintf(line, "%s.%s", suite, name);
+		(*metrics)[line] = value;
+	}
+};
+//
+//////////////////////////////////////
+
+//////////////////////////////////////
+// entry of the table of suites
+//
+struct iSuiteEntry {
+	const char *name;
+	void (*run)(iSuiteContext &context);
+};
+//
+//////////////////////////////////////
+
+//-----------------------------------------------------------------------------
+// parse a BVH file held by a string
+//-----------------------------------------------------------------------------
+static int parseBvh(const string &text, iSkeleton &skel)
+{
+	istringstream in(text);
+	iMocapDataBvh parser(&in, &skel);
+	return parser.load();
+}
+
+//-----------------------------------------------------------------------------
+// parse a synthetic file of the format
+//-----------------------------------------------------------------------------
+static int parseSynthetic(const iGeneratorParam &param, iSkeleton &skel, iProgress *progress = NULL)
+{
+	ostringstream file;
+	const int result = generateMocap(param, file);
+	if (result != MC_SUCCESS) return result;
+
+	istringstream in(file.str());
+	if (iGeneratorParam::MC_GF_BVH == param.format) {
+		iMocapDataBvh parser(&in, &skel);
+		parser.setProgress(progress);
+		return parser.load();
+	}
+	iMocapDataHtr parser(&in, &skel);
+	parser.setProgress(progress);
+	return parser.load();
+}
+
+//-----------------------------------------------------------------------------
+// turn an angle into (-180, 180]
+//-----------------------------------------------------------------------------
+static double wrapDegrees(double angle)
+{
+	while (angle > 180.0) angle -= 360.0;
+	while (angle <= -180.0) angle += 360.0;
+	return angle;
+}
+
+//-----------------------------------------------------------------------------
+// largest error of an evaluated clip against the frames of a skeleton
+//
+// The reference blends frame i and i + 1 of the skeleton by the weight,
+// rotations the short way round, as a stream node would show them.
+//-----------------------------------------------------------------------------
+static double measureClipError(iClipStream &clip, iSkeleton &skel, float scale,
+	unsigned int i, double weight)
+{
+	const unsigned int count = skel.countJoints();
+	vector<float> values(count * clipChannels);
+	if (clip.evaluate((i + weight) * clip.getFrameTime(), &values[0]) != MC_SUCCESS) return HUGE_VAL;
+
+	double error = 0.0;
+	for (unsigned int j = 0; j < count; ++j) {
+		// end sites carry no motion
+		iSkeleton::iJoint *joint = skel.getNode(j).joint;
+		const iSkeleton::iFrame still;
+		const unsigned int k = (i + 1 < joint->motion.size()) ? i + 1 : i;
+		const iSkeleton::iFrame &f0 = (i < joint->motion.size()) ? joint->motion[i] : still;
+		const iSkeleton::iFrame &f1 = (k < joint->motion.size()) ? joint->motion[k] : still;
+		imath::iVec base;
+		joint->getOffset(base);
+		const double expected[clipChannels] = {
+			(base.x + f0.offset.x + (f1.offset.x - f0.offset.x) * weight) * scale,
+			(base.y + f0.offset.y + (f1.offset.y - f0.offset.y) * weight) * scale,
+			(base.z + f0.offset.z + (f1.offset.z - f0.offset.z) * weight) * scale,
+			f0.rotation.x + wrapDegrees(f1.rotation.x - f0.rotation.x) * weight,
+			f0.rotation.y + wrapDegrees(f1.rotation.y - f0.rotation.y) * weight,
+			f0.rotation.z + wrapDegrees(f1.rotation.z - f0.rotation.z) * weight
+		};
+		for (unsigned int c = 0; c < clipChannels; ++c) {
+			double delta = fabs(values[j * clipChannels + c] - expected[c]);
+			// rotations of 180 and -180 are the same
+			if (c >= 3) delta = fabs(wrapDegrees(delta));
+			if (delta > error) error = delta;
+		}
+	}
+	return error;
+}
+
+//-----------------------------------------------------------------------------
+// quaternion of Euler angles (degrees), as products of the turns about the
+// axes, order "abc" being qa * qb * qc
+//-----------------------------------------------------------------------------
+static void composeQuaternion(int order, const iSkeleton::iFrameVec &r, double *q)
+{
+	static const unsigned int axes[6][3] = {
+		{0, 1, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}, {1, 0, 2}, {0, 2, 1}
+	};
+	const double degrees[3] = {r.x, r.y, r.z};
+
+	q[0] = q[1] = q[2] = 0.0;
+	q[3] = 1.0;
+	for (unsigned int i = 0; i < 3; ++i) {
+		const unsigned int a = axes[order][i];
+		const double half = imath::toRadians(degrees[a]) * 0.5;
+		double e[4] = {0.0, 0.0, 0.0, cos(half)};
+		e[a] = sin(half);
+		const double p[4] = {
+			q[3] * e[0] + q[0] * e[3] + q[1] * e[2] - q[2] * e[1],
+			q[3] * e[1] + q[1] * e[3] + q[2] * e[0] - q[0] * e[2],
+			q[3] * e[2] + q[2] * e[3] + q[0] * e[1] - q[1] * e[0],
+			q[3] * e[3] - q[0] * e[0] - q[1] * e[1] - q[2] * e[2]
+		};
+		copy(p, p + 4, q);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// largest error of a sampled pose against slerps of the frames of a
+// skeleton, frames of joint j being pose[j * stride]
+//
+// Rotations are compared as quaternions of either sign, offsets relative
+// to their size.
+//-----------------------------------------------------------------------------
+static double measureSampleError(iSkeleton &skel, double time,
+	const iSkeleton::iFrame *pose, size_t stride)
+{
+	const unsigned int frames = skel.getFrames();
+	const double f = time / skel.getFrameTime();
+	unsigned int idx = 0;
+	double u = 0.0;
+	if (frames >= 2 && f >= frames - 1) {
+		idx = frames - 2;
+		u = 1.0;
+	} else if (f > 0.0) {
+		idx = static_cast<unsigned int>(f);
+		u = f - idx;
+	}
+
+	double error = 0.0;
+	for (unsigned int j = 0; j < skel.countJoints(); ++j) {
+		iSkeleton::iJoint *joint = skel.getNode(j).joint;
+		const iSkeleton::iFrame &sampled = pose[j * stride];
+		const iSkeleton::iFrame still;
+		const size_t n = joint->motion.size();
+		const iSkeleton::iFrame &f0 = (n > 0) ? joint->motion[min<size_t>(idx, n - 1)] : still;
+		const iSkeleton::iFrame &f1 = (n > 0) ? joint->motion[min<size_t>(idx + 1, n - 1)] : still;
+		const int order = skel.getRotOrder(joint);
+
+		// slerp the short way round
+		double q0[4], q1[4], q[4], s[4];
+		composeQuaternion(order, f0.rotation, q0);
+		composeQuaternion(order, f1.rotation, q1);
+		double d = q0[0] * q1[0] + q0[1] * q1[1] + q0[2] * q1[2] + q0[3] * q1[3];
+		const double side = (d < 0.0) ? -1.0 : 1.0;
+		d = min(fabs(d), 1.0);
+		const double theta = acos(d);
+		const double w0 = (theta > 1e-9) ? sin((1.0 - u) * theta) / sin(theta) : 1.0 - u;
+		const double w1 = (theta > 1e-9) ? sin(u * theta) / sin(theta) : u;
+		unsigned int k;
+		for (k = 0; k < 4; ++k) q[k] = q0[k] * w0 + side * q1[k] * w1;
+
+		composeQuaternion(order, sampled.rotation, s);
+		double same = 0.0, opposite = 0.0;
+		for (k = 0; k < 4; ++k) {
+			same = max(same, fabs(s[k] - q[k]));
+			opposite = max(opposite, fabs(s[k] + q[k]));
+		}
+		error = max(error, min(same, opposite));
+
+		const double offset[3] = {
+			f0.offset.x + (f1.offset.x - f0.offset.x) * u,
+			f0.offset.y + (f1.offset.y - f0.offset.y) * u,
+			f0.offset.z + (f1.offset.z - f0.offset.z) * u
+		};
+		const double got[3] = {sampled.offset.x, sampled.offset.y, sampled.offset.z};
+		for (k = 0; k < 3; ++k) {
+			error = max(error, fabs(got[k] - offset[k]) / max(1.0, fabs(offset[k])));
+		}
+		error = max(error, fabs(sampled.scale - (f0.scale + (f1.scale - f0.scale) * u)));
+	}
+	return error;
+}
+
+//-----------------------------------------------------------------------------
+// suite of clips: saved, reopened and evaluated as stream nodes do
+//-----------------------------------------------------------------------------
+static void runClipSuite(iSuiteContext &context)
+{
+	// spins crossing 180 degrees both ways, interpolated the short way round
+	static const char *spin =
+		"HIERARCHY\n"
+		"ROOT Hips\n{\n"
+		"\tOFFSET 1 2 3\n"
+		"\tCHANNELS 6 Xposition Yposition Zposition Zrotation Xrotation Yrotation\n"
+		"\tJOINT Chest\n\t{\n"
+		"\t\tOFFSET 0 10 0\n"
+		"\t\tCHANNELS 3 Zrotation Xrotation Yrotation\n"
+		"\t\tEnd Site\n\t\t{\n\t\t\tOFFSET 0 5 0\n\t\t}\n"
+		"\t}\n}\n"
+		"MOTION\n"
+		"Frames: 4\n"
+		"Frame Time: 0.1\n"
+		"0 0 0 0 0 0 150 -20 10\n"
+		"1 2 3 10 20 30 170 -170 20\n"
+		"2 4 6 20 40 60 -170 170 30\n"
+		"3 6 9 30 60 90 -150 150 40\n";
+	const float scale = 2.0F;
+
+	iSkeleton skel;
+	context.check("hand-written file parsed", parseBvh(spin, skel) == MC_SUCCESS);
+	if (context.failures > 0) return;
+
+	const string path = iClipStream::makePath(context.scratch, "imocap_suite_clip");
+	context.check("clip saved", iClipStream::save(path, skel, 0, skel.getFrames(),
+		skel.getFrameTime(), scale) == MC_SUCCESS);
+	context.check("a new path is made beside an existing clip",
+		iClipStream::makePath(context.scratch, "imocap_suite_clip") != path);
+
+	iClipStream clip;
+	context.check("clip opened", clip.open(path) == MC_SUCCESS);
+	if (context.failures > 0) {
+		remove(path.c_str());
+		return;
+	}
+	context.check("joints, frames & frame time kept", clip.getJoints() == skel.countJoints() &&
+		clip.getFrames() == skel.getFrames() && clip.getFrameTime() == skel.getFrameTime());
+	context.check("root translated", clip.isTranslated(0));
+
+	double onFrames = 0.0, between = 0.0;
+	unsigned int i;
+	for (i = 0; i < skel.getFrames(); ++i) {
+		onFrames = max(onFrames, measureClipError(clip, skel, scale, i, 0.0));
+		if (i + 1 < skel.getFrames()) {
+			between = max(between, measureClipError(clip, skel, scale, i, 0.25));
+			between = max(between, measureClipError(clip, skel, scale, i, 0.5));
+		}
+	}
+	context.check("values on frames", onFrames, 1e-4);
+	context.check("values between frames", between, 1e-4);
+
+	// the spin passes 180 degrees instead of turning back through 0
+	vector<float> values(clip.getJoints() * clipChannels);
+	clip.evaluate(1.5 * clip.getFrameTime(), &values[0]);
+	context.check("rotations across 180 degrees",
+		max(fabs(wrapDegrees(values[clipChannels + 5] - 180.0)),
+		fabs(wrapDegrees(values[clipChannels + 3] - 180.0))), 1e-4);
+
+	// first and last frames are held outside of the clip
+	clip.evaluate(-1.0, &values[0]);
+	context.check("first frame held before the clip",
+		equal(values.begin(), values.end(), clip.getFrame(0)));
+	clip.evaluate(100.0, &values[0]);
+	context.check("last frame held after the clip",
+		equal(values.begin(), values.end(), clip.getFrame(clip.getFrames() - 1)));
+	clip.close();
+	remove(path.c_str());
+
+	// a synthetic take of many blocks, visited out of order so that blocks
+	// are evicted from the cache and fetched again
+	iGeneratorParam param;
+	param.joints = 12;
+	param.frames = clipBlockFrames * (clipCacheBlocks * 2 + 1) + 7;
+	ostringstream file;
+	iSkeleton take;
+	context.check("synthetic file parsed", generateMocap(param, file) == MC_SUCCESS &&
+		parseBvh(file.str(), take) == MC_SUCCESS);
+	if (context.failures > 0) return;
+
+	const string takePath = iClipStream::makePath(context.scratch, "imocap_suite_take");
+	context.check("synthetic clip saved & opened", iClipStream::save(takePath, take, 0,
+		take.getFrames(), take.getFrameTime(), 1.0F) == MC_SUCCESS && clip.open(takePath) == MC_SUCCESS);
+	if (context.failures > 0) {
+		remove(takePath.c_str());
+		return;
+	}
+
+	double scattered = 0.0;
+	const unsigned int frames = take.getFrames();
+	for (i = 0; i < frames; ++i) {
+		// a prime stride visits every frame but the last once
+		const unsigned int idx = (i * 7919U) % (frames - 1);
+		scattered = max(scattered, measureClipError(clip, take, 1.0F, idx, 0.5));
+	}
+	context.check("frames visited out of order", scattered, 1e-3);
+	clip.close();
+	remove(takePath.c_str());
+
+	// the sampler, one pose at a time while its cursor steps forward within
+	// segments, stays, jumps back and runs past both ends, then all poses
+	// at once, against slerps of the frames
+	iSkeleton *sources[2] = {&skel, &take};
+	double stepped = 0.0, many = 0.0;
+	for (unsigned int s = 0; s < 2; ++s) {
+		iSkeleton &source = *sources[s];
+		const double ft = source.getFrameTime();
+		const double last = source.getFrames() - 1.0;
+		vector<double> times;
+		double t;
+		for (t = -0.5; t < min(last, 30.0); t += 0.3) times.push_back(t * ft);
+		times.push_back(times.back());
+		for (t = 0.7; t < min(last, 3.0); t += 0.25) times.push_back(t * ft);
+		times.push_back((last - 0.5) * ft);
+		times.push_back(last * ft);
+		times.push_back((last + 2.0) * ft);
+
+		iClipSampler sampler;
+		if (sampler.prepare(source) != MC_SUCCESS) {
+			stepped = many = HUGE_VAL;
+			break;
+		}
+		vector<iSkeleton::iFrame> pose;
+		for (i = 0; i < times.size(); ++i) {
+			sampler.sample(times[i], pose);
+			stepped = max(stepped, measureSampleError(source, times[i], &pose[0], 1));
+		}
+		const unsigned int count = static_cast<unsigned int>(times.size());
+		sampler.sampleMany(&times[0], count, pose);
+		for (i = 0; i < count; ++i) {
+			many = max(many, measureSampleError(source, times[i], &pose[i], count));
+		}
+	}
+	context.check("sampled poses as the cursor moves", stepped, 1e-5);
+	context.check("poses sampled at once", many, 1e-5);
+}
+
+//////////////////////////////////////
+// slow loop of the parallel suite, run by a thread of its own
+//
+struct iSlowLoop : public iTask {
+	vector<unsigned char> seen;		// indices run
+	volatile unsigned int runs;		// a hint of progress, not exact
+	bool result;
+
+	iSlowLoop(unsigned int count) : seen(count, 0), runs(0), result(false) {}
+	void run(unsigned int idx) {
+		seen[idx] = 1;
+		++runs;
+		pauseThread();
+	}
+	unsigned int countSeen() const {
+		return static_cast<unsigned int>(count(seen.begin(), seen.end(), 1));
+	}
+	static THREAD_PROC proc(void *arg) {
+		iSlowLoop &loop = *static_cast<iSlowLoop *>(arg);
+		loop.result = parallelFor(static_cast<unsigned int>(loop.seen.size()), loop);
+		return THREAD_RETURN;
+	}
+	// start the loop and return once it is well under way
+	bool start(iThread &thread) {
+		if (!startThread(thread, proc, this)) return false;
+		while (runs < 8) pauseThread();
+		return true;
+	}
+};
+//
+//////////////////////////////////////
+
+//////////////////////////////////////
+// node of a task graph in the parallel suite, which counts the indices
+// started before a node it waits for was done
+//
+struct iGraphNode : public iTask {
+	vector<unsigned char> seen;				// indices run
+	vector<const iGraphNode *> before;		// nodes it waits for
+	iCancelFlag *cancel;					// cancelled by every index
+	volatile long early;
+
+	iGraphNode(unsigned int count) : seen(count, 0), cancel(NULL), early(0) {}
+	void run(unsigned int idx) {
+		for (unsigned int k = 0; k < before.size(); ++k) {
+			if (!before[k]->isDone()) atomicAdd(early, 1);
+		}
+		if (NULL != cancel) cancel->cancel();
+		pauseThread();
+		seen[idx] = 1;
+	}
+	bool isDone() const { return countSeen() == seen.size(); }
+	unsigned int countSeen() const {
+		return static_cast<unsigned int>(count(seen.begin(), seen.end(), 1));
+	}
+};
+//
+//////////////////////////////////////
+
+//-----------------------------------------------------------------------------
+// largest distance of dropped samples from the polyline through the keys,
+// HUGE_VAL if the keys do not start & end with the samples or go back
+//-----------------------------------------------------------------------------
+static double measureReducedError(const vector<double> &samples, const iKeyList &keys)
+{
+	if (keys.empty() || keys.front() != 0 || keys.back() != samples.size() - 1) return HUGE_VAL;
+	double error = 0.0;
+	for (unsigned int k = 0; k + 1 < keys.size(); ++k) {
+		const unsigned int a = keys[k], b = keys[k + 1];
+		if (b <= a) return HUGE_VAL;
+		for (unsigned int i = a + 1; i < b; ++i) {
+			const double line = samples[a] + (samples[b] - samples[a]) * (i - a) / (b - a);
+			error = max(error, fabs(samples[i] - line));
+		}
+	}
+	return error;
+}
+
+//-----------------------------------------------------------------------------
+// suite of keys: constant channels set statically & keys reduced
+//-----------------------------------------------------------------------------
+static void runKeysSuite(iSuiteContext &context)
+{
+	// spans of a half & twice the threshold, exact in single precision
+	const double under = 0.0009765625, over = 0.001953125;
+	const unsigned int first = 20, last = 80;
+	iSkeleton::iMotion motion;
+	for (unsigned int i = 0; i < 100; ++i) {
+		iSkeleton::iFrame frame;
+		const bool inside = (i >= first && i < last);
+		frame.offset.x = 5.0F;
+		frame.offset.y = static_cast<iMotionReal>(2.0 + ((i & 1) ? under : 0.0));
+		frame.offset.z = inside ? 1.0F : 30.0F;
+		frame.rotation.x = static_cast<iMotionReal>(0.5 * i);
+		frame.rotation.y = static_cast<iMotionReal>(-3.0 + ((i & 1) ? over : 0.0));
+		frame.rotation.z = 0.0F;
+		motion.push_back(frame);
+	}
+
+	iChannelRange range;
+	measureChannels(motion, first, last, range);
+	context.check("channels measured over the range", range.frames == last - first &&
+		range.minimum[Channel::MC_CH_RX] == 0.5 * first &&
+		range.maximum[Channel::MC_CH_RX] == 0.5 * (last - 1));
+	context.check("constant channels left without curves",
+		!isKeyedChannel(range, Channel::MC_CH_TX, motionThreshold, false) &&
+		!isKeyedChannel(range, Channel::MC_CH_TY, motionThreshold, false) &&
+		!isKeyedChannel(range, Channel::MC_CH_TZ, motionThreshold, false) &&
+		!isKeyedChannel(range, Channel::MC_CH_RZ, motionThreshold, false));
+	context.check("channels over the threshold keyed",
+		isKeyedChannel(range, Channel::MC_CH_RX, motionThreshold, false) &&
+		isKeyedChannel(range, Channel::MC_CH_RY, motionThreshold, false));
+	context.check("constant channels of connected plugs keyed",
+		isKeyedChannel(range, Channel::MC_CH_TX, motionThreshold, true));
+
+	// frames outside of the range count as well once it covers them
+	measureChannels(motion, 0, 100, range);
+	context.check("whole take measured", range.frames == 100 &&
+		isKeyedChannel(range, Channel::MC_CH_TZ, motionThreshold, false));
+	measureChannels(motion, 100, 200, range);
+	context.check("empty range constant", 0 == range.frames &&
+		!isKeyedChannel(range, Channel::MC_CH_RX, motionThreshold, false));
+
+	// reduced curves stay in the band at every dropped sample, whatever
+	// the shape of the channel
+	const double tolerance = 0.05;
+	const unsigned int count = 2000;
+	double worst = 0.0;
+	bool fewer = true;
+	iKeyList keys;
+	for (unsigned int shape = 0; shape < 4; ++shape) {
+		vector<double> samples(count);
+		for (unsigned int i = 0; i < count; ++i) {
+			switch (shape) {
+			case 0: samples[i] = 40.0 * sin(0.01 * i) + 3.0 * sin(0.003 * i); break;
+			case 1: samples[i] = (i / 250 % 2) ? 10.0 : -10.0; break;
+			case 2: samples[i] = 0.2 * i; break;
+			// noise of twice the tolerance
+			default: samples[i] = 2.0 * tolerance * fmod(fabs(sin(12.9898 * i)) * 43758.5453, 1.0); break;
+			}
+		}
+		reduceKeys(&samples[0], count, tolerance, keys);
+		worst = max(worst, measureReducedError(samples, keys));
+		if (shape < 3 && keys.size() >= count / 5) fewer = false;
+		if (2 == shape) context.check("a ramp reduced to its end keys", 2 == keys.size());
+	}
+	context.check("dropped samples within the tolerance & end keys kept", worst, tolerance * (1.0 + 1e-9));
+	context.check("smooth channels reduced", fewer);
+
+	reduceKeys(NULL, 0, tolerance, keys);
+	const bool none = keys.empty();
+	const double one = 4.0;
+	reduceKeys(&one, 1, tolerance, keys);
+	context.check("channels of no or one sample", none && 1 == keys.size() && 0 == keys[0]);
+}
+
+//-----------------------------------------------------------------------------
+// suite of long takes: 10M frames loaded within budgets of memory
+//-----------------------------------------------------------------------------
+static void runLongTakeSuite(iSuiteContext &context)
+{
+	// the motion takes 280 MB, refused by the first budget & spilled over the second
+	const double budget = 64.0 * 1024.0 * 1024.0, heapBudget = 256.0 * 1024.0 * 1024.0;
+	iGeneratorParam param;
+	param.joints = 1;
+	param.frames = 10000000;
+
+	// written to a file, as a string of it would take as much memory again
+	string path(context.scratch);
+	if (!path.empty() && path[path.size() - 1] != '/' && path[path.size() - 1] != '\\') path += '/';
+	path += "imocap_suite_long.bvh";
+	{
+		ofstream file(path.c_str(), ios::out | ios::binary);
+		context.check("long take written", generateMocap(param, file) == MC_SUCCESS && file.good());
+	}
+	if (context.failures > 0) {
+		remove(path.c_str());
+		return;
+	}
+
+	// over the memory budget, nothing is made for the frames
+	{
+		ifstream in(path.c_str(), ios::in | ios::binary);
+		iSkeleton skel;
+		iMocapDataBvh parser(&in, &skel);
+		parser.setMemoryBudget(budget);
+		context.check("long take refused over the budget", parser.load() == MC_OUT_OF_MEMORY &&
+			0 == skel.getNode(0).joint->motion.capacity());
+	}
+
+	// a header telling more frames than 32 bits count is taken at its word
+	{
+		iGeneratorParam small;
+		small.joints = 1;
+		small.frames = 10;
+		ostringstream file;
+		generateMocap(small, file);
+		string text = file.str();
+		const string::size_type at = text.find("Frames:");
+		const string::size_type end = text.find_first_of("\r\n", at);
+		const iFrameCount told = (static_cast<iFrameCount>(1) << 32) + small.frames;
+		if (at != string::npos && end != string::npos) text.replace(at, end - at, "Frames: " + toString(told));
+		istringstream in(text);
+		iSkeleton skel;
+		iMocapDataBvh parser(&in, &skel);
+		parser.setMemoryBudget(budget);
+		context.check("frame counts beyond 32 bits", parser.load() == MC_OUT_OF_MEMORY &&
+			skel.getFrames() == told);
+	}
+
+	// over the spill budget, chunks go to a file in the scratch folder
+	setSpillBudget(heapBudget, context.scratch);
+	{
+		ifstream in(path.c_str(), ios::in | ios::binary);
+		iSkeleton skel;
+		iImportReport report;
+		iMocapDataBvh parser(&in, &skel);
+		const double begin = getWallTime();
+		const int result = parser.load(&report);
+		const double seconds = getWallTime() - begin;
+		const iSkeleton::iMotion &motion = skel.getNode(0).joint->motion;
+		context.check("long take loaded", MC_SUCCESS == result &&
+			skel.getFrames() == param.frames && motion.size() == param.frames);
+		double heap = 0.0, spilled = 0.0;
+		getChunkUse(heap, spilled);
+		context.check("motion over the budget spilled", spilled > 0.0 && heap <= heapBudget);
+
+		// a take loaded next is spilled as well, each skeleton counts its own
+		iGeneratorParam small;
+		small.joints = 4;
+		small.frames = 10000;
+		iSkeleton other;
+		iMemoryUse use, otherUse;
+		const bool parsed = parseSynthetic(small, other) == MC_SUCCESS;
+		skel.measureMemory(use);
+		other.measureMemory(otherUse);
+		getChunkUse(heap, spilled);
+		context.check("spilled chunks counted by their skeleton", parsed && otherUse.spilled > 0.0 &&
+			use.spilled > 0.0 && use.spilled <= use.motion + use.slack &&
+			use.spilled + otherUse.spilled == spilled);
+
+		// the last line of the file holds the last frame, the root has
+		// positions, then rotations about Z, X & Y
+		double values[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+		{
+			ifstream file(path.c_str(), ios::in | ios::binary);
+			file.seekg(-512, ios::end);
+			string line, last;
+			while (getline(file, line)) {
+				if (line.find_first_not_of(" \t\r") != string::npos) last = line;
+			}
+			istringstream words(last);
+			for (unsigned int c = 0; c < 6; ++c) words >> values[c];
+		}
+		if (MC_SUCCESS == result && motion.size() == param.frames) {
+			const iSkeleton::iFrame &frame = motion[param.frames - 1];
+			context.check("last frame as the file holds it", fabs(frame.offset.x - values[0]) +
+				fabs(frame.offset.y - values[1]) + fabs(frame.offset.z - values[2]) +
+				fabs(frame.rotation.z - values[3]) + fabs(frame.rotation.x - values[4]) +
+				fabs(frame.rotation.y - values[5]), 1e-3);
+		}
+
+		// room for the frames is made before the motion, whose allocations
+		// are buffers of its stages; chunks of the heap would be 2.2e-4
+		if (isCountingAllocs()) {
+			const double perFrame = report.getPhaseAllocs("motion").allocs / static_cast<double>(param.frames);
+			context.check("no allocations per frame of the motion", perFrame, 1e-4);
+		}
+		context.addMetric("longtake", "framesPerSec", param.frames / max(seconds, 1e-6));
+	}
+	setSpillBudget(0.0);
+	remove(path.c_str());
+}
+
+//-----------------------------------------------------------------------------
+// suite of the thread pool: resized and stopped under running loops
+//-----------------------------------------------------------------------------
+static void runParallelSuite(iSuiteContext &context)
+{
+	const unsigned int count = 200;
+	iThread thread;
+
+	// a new size waits for the loop in progress
+	startPool(3);
+	{
+		iSlowLoop warm(8);
+		parallelFor(8, warm);
+	}
+	iSlowLoop resized(count);
+	if (resized.start(thread)) {
+		startPool(2);
+		joinThread(thread);
+		context.check("loop kept its workers while the pool was resized",
+			resized.result && resized.countSeen() == count);
+		iSlowLoop next(8);
+		context.check("next loop runs on the new size",
+			parallelFor(8, next) && countPoolThreads() == 2);
+	} else {
+		context.check("loop thread started", false);
+	}
+
+	// stopping the pool skips the rest of the loop
+	iSlowLoop stopped(count);
+	if (stopped.start(thread)) {
+		stopPool();
+		joinThread(thread);
+		context.check("loop stopped with the pool reports it",
+			!stopped.result && stopped.countSeen() < count);
+	} else {
+		context.check("loop thread started", false);
+	}
+
+	// graphs: a diamond beside a lone node, in the pool & in the calling
+	// thread, then a node cancelling the one after it
+	startPool(3);
+	for (unsigned int threads = 0; threads < 2; ++threads) {
+		iGraphNode a(16), b(16), c(16), d(16), e(16);
+		b.before.push_back(&a);
+		c.before.push_back(&a);
+		d.before.push_back(&b);
+		d.before.push_back(&c);
+		iTaskGraph graph;
+		const unsigned int na = graph.add(a, 16), nb = graph.add(b, 16);
+		const unsigned int nc = graph.add(c, 16), nd = graph.add(d, 16);
+		graph.add(e, 16);
+		graph.depend(nb, na);
+		graph.depend(nc, na);
+		graph.depend(nd, nb);
+		graph.depend(nd, nc);
+		const bool ran = graph.run(threads);
+		context.check(threads ? "graph nodes after their dependencies, one thread" :
+			"graph nodes after their dependencies, pool", ran && a.isDone() && b.isDone() &&
+			c.isDone() && d.isDone() && e.isDone() && 0 == b.early + c.early + d.early);
+	}
+	{
+		iCancelFlag flag;
+		iGraphNode a(16), b(16);
+		a.cancel = &flag;
+		iTaskGraph graph;
+		graph.depend(graph.add(b, 16), graph.add(a, 16));
+		const bool ran = graph.run(0, &flag);
+		context.check("cancelled graph skips the nodes after", !ran && 0 == b.countSeen());
+	}
+	// no worker outlives the suite
+	stopPool();
+	startPool();
+}
+
+//////////////////////////////////////
+// progress of a load in the skeleton suite, cancelling it after some calls
+//
+struct iStopProgress : public iProgress {
+	unsigned int calls;
+	unsigned int cancelAfter;	// calls, 0 for never
+	double last;				// latest fraction
+	bool ordered;				// fractions never went back or over 1
+
+	iStopProgress(unsigned int after) : calls(0), cancelAfter(after), last(0.0), ordered(true) {}
+	bool update(double done) {
+		ordered = ordered && done >= last && done <= 1.0;
+		last = done;
+		return 0 == cancelAfter || ++calls < cancelAfter;
+	}
+};
+//
+//////////////////////////////////////
+
+//-----------------------------------------------------------------------------
+// suite of skeletons: motion rebuilt over whole takes and ranges, read from
+// both versions of HTR files, and loads cancelled by their progress
+//-----------------------------------------------------------------------------
+static void runSkeletonSuite(iSuiteContext &context)
+{
+	// a range resampled at a quarter of the rate keeps every fourth frame
+	// of the file from its first one on
+	iGeneratorParam param;
+	param.joints = 12;
+	param.frames = 600;
+	param.frameRate = 120;
+	iSkeleton skel, file;
+	const bool parsed = parseSynthetic(param, skel) == MC_SUCCESS &&
+		parseSynthetic(param, file) == MC_SUCCESS;
+	context.check("synthetic files parsed", parsed);
+	if (!parsed) return;
+
+	const unsigned int first = 100, last = 400;
+	context.check("range resampled", skel.resample(4.0 * skel.getFrameTime(), first, last) == MC_SUCCESS &&
+		skel.getFrames() == (last - 1 - first) / 4 + 1);
+	double error = 0.0;
+	for (unsigned int j = 0; j < skel.countJoints(); ++j) {
+		const iSkeleton::iMotion &motion = skel.getNode(j).joint->motion;
+		const iSkeleton::iMotion &original = file.getNode(j).joint->motion;
+		for (unsigned int i = 0; i < motion.size(); ++i) {
+			const iSkeleton::iFrame &a = motion[i], &b = original[first + i * 4];
+			error = max(error, static_cast<double>(fabs(a.offset.x - b.offset.x) +
+				fabs(a.offset.y - b.offset.y) + fabs(a.offset.z - b.offset.z)));
+			error = max(error, fabs(wrapDegrees(a.rotation.x - b.rotation.x)) +
+				fabs(wrapDegrees(a.rotation.y - b.rotation.y)) + fabs(wrapDegrees(a.rotation.z - b.rotation.z)));
+		}
+	}
+	context.check("resampled range starts at its first frame", error, 1e-3);
+	context.check("empty range refused", file.resample(0.01, 50, 50) != MC_SUCCESS);
+
+	// passes leave off under a cancelled flag
+	iCancelFlag cancelled;
+	cancelled.cancel();
+	const int order = (Rotation::MC_RO_ZYX == file.getRotOrder()) ? Rotation::MC_RO_XYZ : Rotation::MC_RO_ZYX;
+	context.check("passes stop once cancelled", file.filterRotations(0, &cancelled) == MC_CANCELLED &&
+		file.resample(0.01, 0, file.getFrames(), 0, &cancelled) == MC_CANCELLED &&
+		file.convertRotOrder(order, 0, &cancelled) == MC_CANCELLED);
+
+	// both versions of HTR files carry the same motion, over several
+	// batches of lines read ahead
+	iSkeleton version1, version2;
+	param.frames = 400;
+	param.format = iGeneratorParam::MC_GF_HTR1;
+	const bool read1 = parseSynthetic(param, version1) == MC_SUCCESS;
+	param.format = iGeneratorParam::MC_GF_HTR2;
+	const bool read2 = parseSynthetic(param, version2) == MC_SUCCESS;
+	context.check("HTR 1 & 2 files parsed", read1 && read2 && version2.getFrames() == param.frames &&
+		version1.countJoints() == version2.countJoints());
+	if (!read1 || !read2 || version1.countJoints() != version2.countJoints()) return;
+	error = 0.0;
+	for (unsigned int j = 0; j < version1.countJoints(); ++j) {
+		const iSkeleton::iMotion &a = version1.getNode(j).joint->motion;
+		const iSkeleton::iMotion &b = version2.getNode(j).joint->motion;
+		if (a.size() != b.size()) {
+			error = 1.0;
+			break;
+		}
+		for (unsigned int i = 0; i < a.size(); ++i) {
+			error = max(error, static_cast<double>(fabs(a[i].offset.x - b[i].offset.x) +
+				fabs(a[i].offset.y - b[i].offset.y) + fabs(a[i].offset.z - b[i].offset.z) +
+				fabs(a[i].rotation.x - b[i].rotation.x) + fabs(a[i].rotation.y - b[i].rotation.y) +
+				fabs(a[i].rotation.z - b[i].rotation.z) + fabs(a[i].scale - b[i].scale)));
+		}
+	}
+	context.check("HTR 2 frames equal to HTR 1", error, 1e-6);
+
+	// the reader runs ahead of the parser by batches
+	ostringstream htr;
+	bool piped = false;
+	if (generateMocap(param, htr) == MC_SUCCESS) {
+		istringstream in(htr.str());
+		iSkeleton ahead;
+		iMocapDataHtr parser(&in, &ahead);
+		const vector<iStageStats> &stages = parser.getStageStats();
+		piped = parser.load() == MC_SUCCESS && ahead.getFrames() == param.frames &&
+			2 == stages.size() && stages[0].batches > 1 && stages[1].batches + 1 >= stages[0].batches;
+	}
+	context.check("HTR frames read ahead", piped);
+
+	// every parser asks its progress as it goes, and stops when told
+	bool reported = true, stopped = true;
+	for (param.format = iGeneratorParam::MC_GF_BVH; param.format <= iGeneratorParam::MC_GF_HTR2; ++param.format) {
+		iSkeleton whole, part;
+		iStopProgress watch(0), stop(1);
+		reported = reported && parseSynthetic(param, whole, &watch) == MC_SUCCESS &&
+			watch.last > 0.0 && watch.ordered;
+		stopped = stopped && parseSynthetic(param, part, &stop) == MC_CANCELLED &&
+			part.countJoints() > 0 && part.getNode(part.countJoints() - 1).joint->motion.size() < param.frames;
+	}
+	context.check("loads report their progress", reported);
+	context.check("loads cancelled by their progress", stopped);
+}
+
+//////////////////////////////////////
+// import of the scheduler suite, counting what its commits make & undo
+//
+struct iFakeImport : public iJob, public iCommit {
+	unsigned int polls;			// of the cancel flag by the job
+	unsigned int units;
+	unsigned int failing;		// unit which fails, units for none
+	bool begun, ended;
+	unsigned int made, undone;
+
+	iFakeImport(unsigned int count, unsigned int fail) : polls(20), units(count), failing(fail),
+		begun(false), ended(false), made(0), undone(0) {}
+	int work(iCancelFlag &cancel) {
+		for (unsigned int i = 0; i < polls; ++i) {
+			if (cancel.isCancelled()) return MC_CANCELLED;
+			setProgress(static_cast<double>(i) / polls);
+			pauseThread();
+		}
+		return MC_SUCCESS;
+	}
+	int begin() { begun = true; return MC_SUCCESS; }
+	unsigned int countUnits() { return units; }
+	int commit(unsigned int idx) {
+		if (idx == failing) return MC_FATAL_ERROR;
+		++made;
+		pauseThread();
+		return MC_SUCCESS;
+	}
+	int end() { ended = true; return MC_SUCCESS; }
+	void rollback() { undone += made; made = 0; }
+};
+//
+//////////////////////////////////////
+
+//-----------------------------------------------------------------------------
+// main loop of a host giving idle events to an import, which is cancelled
+// once a state has been seen for some events
+//-----------------------------------------------------------------------------
+static int runIdleLoop(iScheduler &scheduler, int cancelState, unsigned int cancelAfter,
+	unsigned int &slices)
+{
+	unsigned int seen = 0;
+	slices = 0;
+	scheduler.start();
+	while (!scheduler.isFinished()) {
+		const int state = scheduler.idle(0.003);
+		if (iScheduler::MC_SS_COMMITTING == state) ++slices;
+		if (cancelState == state && ++seen == cancelAfter) scheduler.cancel();
+		if (iScheduler::MC_SS_COMMITTING != state) pauseThread();
+	}
+	return scheduler.getState();
+}
+
+//-----------------------------------------------------------------------------
+// suite of the scheduler: imports committed by slices, cancelled & failed
+//-----------------------------------------------------------------------------
+static void runSchedulerSuite(iSuiteContext &context)
+{
+	const unsigned int units = 40;
+	unsigned int slices = 0;
+
+	iFakeImport done(units, units);
+	{
+		iScheduler scheduler(done, done);
+		context.check("import done", runIdleLoop(scheduler, iScheduler::MC_SS_IDLE, 0, slices) ==
+			iScheduler::MC_SS_DONE && scheduler.getProgress() == 1.0);
+		context.check("units committed by several slices", done.made == units && done.ended &&
+			0 == done.undone && slices > 1);
+	}
+
+	iFakeImport working(units, units);
+	{
+		iScheduler scheduler(working, working);
+		context.check("import cancelled while working", runIdleLoop(scheduler,
+			iScheduler::MC_SS_WORKING, 3, slices) == iScheduler::MC_SS_CANCELLED);
+		context.check("nothing committed after the job was cancelled", !working.begun &&
+			0 == working.made && 0 == working.undone);
+	}
+
+	iFakeImport committing(units, units);
+	{
+		iScheduler scheduler(committing, committing);
+		context.check("import cancelled while committing", runIdleLoop(scheduler,
+			iScheduler::MC_SS_COMMITTING, 2, slices) == iScheduler::MC_SS_CANCELLED &&
+			MC_CANCELLED == scheduler.getResult());
+		context.check("units committed before the cancel undone", !committing.ended &&
+			0 == committing.made && committing.undone > 0 && committing.undone < units);
+	}
+
+	iFakeImport failed(units, 10);
+	{
+		iScheduler scheduler(failed, failed);
+		context.check("import failed by a unit", runIdleLoop(scheduler, iScheduler::MC_SS_IDLE, 0, slices) ==
+			iScheduler::MC_SS_FAILED && MC_FATAL_ERROR == scheduler.getResult());
+		context.check("units committed before the failure undone", !failed.ended &&
+			0 == failed.made && 10 == failed.undone);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// 4x4 matrices for column vectors, row by row as iKinematics::getMatrix
+//-----------------------------------------------------------------------------
+static void multiplyMatrix(const double *a, const double *b, double *m)
+{
+	for (unsigned int r = 0; r < 4; ++r) {
+		for (unsigned int c = 0; c < 4; ++c) {
+			m[r * 4 + c] = a[r * 4] * b[c] + a[r * 4 + 1] * b[4 + c] +
+				a[r * 4 + 2] * b[8 + c] + a[r * 4 + 3] * b[12 + c];
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// rotation of Euler angles in degrees, composed axis by axis
+//
+// Order "abc" of the mocap files is Ra * Rb * Rc here, which is rotateOrder
+// "cba" of Maya, whose row vectors see the transposed product.
+//-----------------------------------------------------------------------------
+static void composeEuler(int order, double x, double y, double z, double *m)
+{
+	static const unsigned int axes[6][3] = {
+		{0, 1, 2}, {1, 2, 0}, {2, 0, 1}, {2, 1, 0}, {1, 0, 2}, {0, 2, 1}
+	};
+	const double degrees[3] = {x, y, z};
+
+	double r[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+	for (unsigned int i = 0; i < 3; ++i) {
+		const unsigned int a = axes[order][i];
+		const unsigned int b = (a + 1) % 3, c = (a + 2) % 3;
+		const double angle = imath::toRadians(degrees[a]);
+		double axis[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+		axis[b * 4 + b] = cos(angle); axis[b * 4 + c] = -sin(angle);
+		axis[c * 4 + b] = sin(angle); axis[c * 4 + c] = cos(angle);
+		double product[16];
+		multiplyMatrix(r, axis, product);
+		copy(product, product + 16, r);
+	}
+	copy(r, r + 16, m);
+}
+
+//-----------------------------------------------------------------------------
+// give joints base rotations and bones varying scales, which synthetic files
+// leave at rest
+//-----------------------------------------------------------------------------
+static void disturbSkeleton(iSkeleton &skel, bool scaled)
+{
+	for (unsigned int j = 0; j < skel.countJoints(); ++j) {
+		iSkeleton::iJoint *joint = skel.getNode(j).joint;
+		joint->setRotation(imath::iVec(10.0 + j * 7.0, -25.0 + j * 11.0, 40.0 - j * 13.0));
+		if (!scaled) continue;
+		for (unsigned int f = 0; f < joint->motion.size(); ++f) {
+			joint->motion[f].scale = static_cast<float>(1.0 + 0.25 * sin(0.1 * f + j));
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// largest error of solved world matrices at a frame against a reference
+//
+// The reference composes joints as Maya does, parent * offset * joint orient
+// * rotation of the frame, offsets stretched by the proportion and by the
+// HTR scale of the parent.
+//-----------------------------------------------------------------------------
+static double measureKinematicsError(iKinematics &kine, iSkeleton &skel,
+	unsigned int frame, double proportion)
+{
+	const unsigned int count = skel.countJoints();
+	vector<double> world(count * 16);
+	double error = 0.0;
+
+	for (unsigned int j = 0; j < count; ++j) {
+		iSkeleton::iNode &node = skel.getNode(j);
+		iSkeleton::iJoint *joint = node.joint;
+		const int order = skel.getRotOrder(joint);
+		const iSkeleton::iFrame still;
+		const iSkeleton::iFrame &f = (frame < joint->motion.size()) ? joint->motion[frame] : still;
+
+		imath::iVec base, orientAngles;
+		joint->getOffset(base);
+		joint->getRotation(orientAngles);
+		double local[16], orient[16], rotation[16];
+		composeEuler(order, orientAngles.x, orientAngles.y, orientAngles.z, orient);
+		composeEuler(order, f.rotation.x, f.rotation.y, f.rotation.z, rotation);
+		multiplyMatrix(orient, rotation, local);
+
+		double stretch = proportion;
+		if (node.parent >= 0) {
+			const iSkeleton::iMotion &pm = skel.getNode(node.parent).joint->motion;
+			if (frame < pm.size()) stretch *= pm[frame].scale;
+		}
+		const bool translated = (0 == node.depth) || skel.getHaveTranslation();
+		local[3] = (base.x + (translated ? f.offset.x : 0.0)) * stretch;
+		local[7] = (base.y + (translated ? f.offset.y : 0.0)) * stretch;
+		local[11] = (base.z + (translated ? f.offset.z : 0.0)) * stretch;
+
+		double *m = &world[j * 16];
+		if (node.parent < 0) copy(local, local + 16, m);
+		else multiplyMatrix(&world[node.parent * 16], local, m);
+
+		imath::iMat solved;
+		kine.getMatrix(j, frame, solved);
+		// positions are compared relative to the size of the take
+		for (unsigned int k = 0; k < 16; ++k) {
+			const double scale = (3 == k % 4 && k < 12) ? max(1.0, fabs(m[k])) : 1.0;
+			error = max(error, fabs(solved[k] - m[k]) / scale);
+		}
+	}
+	return error;
+}
+
+//-----------------------------------------------------------------------------
+// suite of forward kinematics: world matrices against a reference, and the
+// rate of joint transforms solved by one thread
+//-----------------------------------------------------------------------------
+static void runKinematicsSuite(iSuiteContext &context)
+{
+	static const struct {
+		const char *what;
+		unsigned int format, layout;
+		double proportion;
+	} takes[] = {
+		{ "matrices of BVH, orders by joints", iGeneratorParam::MC_GF_BVH,
+			iGeneratorParam::MC_GL_ORDERS, 1.0 },
+		{ "matrices of BVH, every joint translated", iGeneratorParam::MC_GF_BVH,
+			iGeneratorParam::MC_GL_FULL, 0.5 },
+		{ "matrices of HTR, scaled bones", iGeneratorParam::MC_GF_HTR1,
+			iGeneratorParam::MC_GL_ROOT, 2.0 }
+	};
+	unsigned int t, i;
+
+	for (t = 0; t < sizeof(takes) / sizeof(takes[0]); ++t) {
+		iGeneratorParam param;
+		param.format = takes[t].format;
+		param.layout = takes[t].layout;
+		param.joints = 30;
+		param.frames = kineBlockFrames * 2 + 17;
+		param.seed = t + 1;
+		iSkeleton skel;
+		iKinematics kine;
+		const bool parsed = (parseSynthetic(param, skel) == MC_SUCCESS);
+		if (parsed) disturbSkeleton(skel, iGeneratorParam::MC_GF_HTR1 == param.format);
+		if (!parsed ||
+			kine.solve(skel, 0, skel.getFrames(), takes[t].proportion) != MC_SUCCESS) {
+			context.check(takes[t].what, false);
+			continue;
+		}
+		double error = 0.0;
+		for (i = 0; i < skel.getFrames(); i += 13) {
+			error = max(error, measureKinematicsError(kine, skel, i, takes[t].proportion));
+		}
+		error = max(error, measureKinematicsError(kine, skel, skel.getFrames() - 1, takes[t].proportion));
+		context.check(takes[t].what, error, 1e-9);
+	}
+
+	// a range of frames starts at its first frame
+	{
+		iGeneratorParam param;
+		iSkeleton skel;
+		iKinematics whole, range;
+		const unsigned int first = kineBlockFrames + 5;
+		const bool solved = parseSynthetic(param, skel) == MC_SUCCESS &&
+			whole.solve(skel, 0, skel.getFrames()) == MC_SUCCESS &&
+			range.solve(skel, first, skel.getFrames()) == MC_SUCCESS;
+		double error = solved ? 0.0 : HUGE_VAL;
+		for (i = 0; solved && i < range.getFrames(); i += 7) {
+			for (unsigned int j = 0; j < skel.countJoints(); ++j) {
+				imath::iMat a, b;
+				whole.getMatrix(j, first + i, a);
+				range.getMatrix(j, i, b);
+				for (unsigned int k = 0; k < 16; ++k) error = max(error, fabs(a[k] - b[k]));
+			}
+		}
+		context.check("range of frames", error, 0.0);
+	}
+
+	// rate of a large take, best of a few runs of one solver, whose
+	// components are in memory after the first run
+	iGeneratorParam param;
+	param.joints = 60;
+	param.frames = 20000;
+	iSkeleton skel;
+	if (parseSynthetic(param, skel) != MC_SUCCESS) {
+		context.check("large take parsed", false);
+		return;
+	}
+	double best = HUGE_VAL;
+	iKinematics kine;
+	for (i = 0; i < 5; ++i) {
+		const double begin = getWallTime();
+		kine.solve(skel, 0, skel.getFrames(), 1.0, 1);
+		best = min(best, getWallTime() - begin);
+	}
+	const double rate = skel.countJoints() * static_cast<double>(skel.getFrames()) / max(best, 1e-6);
+	context.addMetric("kinematics", "jointTransformsPerSec", rate);
+	context.check("10M joint transforms per second", rate >= 1.0e7);
+}
+
+//-----------------------------------------------------------------------------
+// distance of quaternions, which turn the same with either sign
+//-----------------------------------------------------------------------------
+static double measureQuaternionError(const double *a, const double *b)
+{
+	double same = 0.0, opposite = 0.0;
+	for (unsigned int k = 0; k < 4; ++k) {
+		same = max(same, fabs(a[k] - b[k]));
+		opposite = max(opposite, fabs(a[k] + b[k]));
+	}
+	return min(same, opposite);
+}
+
+//-----------------------------------------------------------------------------
+// suite of rotations: Euler angles of every order through matrices and
+// quaternions and back, near gimbal lock as well, and rates of the kernels
+//-----------------------------------------------------------------------------
+static void runRotationSuite(iSuiteContext &context)
+{
+	static const char *orderNames[6] = {"XYZ", "YZX", "ZXY", "ZYX", "YXZ", "XZY"};
+	// middle angles close to 90 degrees, down to the lock itself
+	static const double nearLock[] = {1e-1, 1e-3, 1e-5, 1e-7, 1e-9, 1e-11, 0.0};
+	const unsigned int nears = sizeof(nearLock) / sizeof(nearLock[0]);
+	const unsigned int spread = 1000;
+	const unsigned int count = spread + nears * 2;
+	unsigned int i, k;
+
+	// angles of the spread by golden ratios, then both locks
+	vector<double> angles(count * 3);
+	double *first = &angles[0], *middle = &angles[count], *last = &angles[count * 2];
+	for (i = 0; i < spread; ++i) {
+		first[i] = 360.0 * fmod(i * 0.6180339887498949, 1.0) - 180.0;
+		middle[i] = 179.0 * fmod(i * 0.7548776662466927, 1.0) - 89.5;
+		last[i] = 360.0 * fmod(i * 0.5698402909980532, 1.0) - 180.0;
+	}
+	for (k = 0; k < nears; ++k) {
+		for (unsigned int sign = 0; sign < 2; ++sign) {
+			i = spread + k * 2 + sign;
+			first[i] = 30.0 + k * 17.0;
+			middle[i] = (sign ? -1.0 : 1.0) * (90.0 - nearLock[k]);
+			last[i] = -70.0 + k * 23.0;
+		}
+	}
+
+	double worstMatrix = 0.0, worstMiddle = 0.0, worstQuaternion = 0.0, worstClass = 0.0;
+	vector<double> m(count * 9), back(count * 9), q(count * 4), again(count * 4), e(count * 3);
+	for (int order = 0; order < 6; ++order) {
+		// the middle angle goes to the axis in the middle of the order
+		const char *name = orderNames[order];
+		double *in[3];
+		in[name[0] - 'X'] = first;
+		in[name[1] - 'X'] = middle;
+		in[name[2] - 'X'] = last;
+		double *out[3] = {&e[0], &e[count], &e[count * 2]};
+		const double *outMiddle = out[name[1] - 'X'];
+
+		// through matrices
+		eulerToMatrix(order, count, in[0], in[1], in[2], &m[0]);
+		matrixToEuler(order, count, &m[0], out[0], out[1], out[2]);
+		eulerToMatrix(order, count, out[0], out[1], out[2], &back[0]);
+		for (i = 0; i < count * 9; ++i) worstMatrix = max(worstMatrix, fabs(back[i] - m[i]));
+		for (i = 0; i < count; ++i) worstMiddle = max(worstMiddle, fabs(outMiddle[i] - middle[i]));
+
+		// through quaternions
+		double *qx = &q[0], *qy = &q[count], *qz = &q[count * 2], *qw = &q[count * 3];
+		double *ax = &again[0], *ay = &again[count], *az = &again[count * 2], *aw = &again[count * 3];
+		eulerToQuaternion(order, count, in[0], in[1], in[2], qx, qy, qz, qw);
+		quaternionToEuler(order, count, qx, qy, qz, qw, out[0], out[1], out[2]);
+		eulerToQuaternion(order, count, out[0], out[1], out[2], ax, ay, az, aw);
+		for (i = 0; i < count; ++i) {
+			const double a[4] = {qx[i], qy[i], qz[i], qw[i]};
+			const double b[4] = {ax[i], ay[i], az[i], aw[i]};
+			worstQuaternion = max(worstQuaternion, measureQuaternionError(a, b));
+			worstMiddle = max(worstMiddle, fabs(outMiddle[i] - middle[i]));
+		}
+
+		// through the quaternion class of imath
+		for (i = 0; i < count; ++i) {
+			imath::iVector<double> radians(imath::toRadians(in[0][i]),
+				imath::toRadians(in[1][i]), imath::toRadians(in[2][i]));
+			imath::iQuaternion<double> p, r;
+			p.fromEulerAngle(radians, order);
+			r.fromEulerAngle(p.toEulerAngle(order), order);
+			const double a[4] = {p.v.x, p.v.y, p.v.z, p.n};
+			const double b[4] = {r.v.x, r.v.y, r.v.z, r.n};
+			worstClass = max(worstClass, measureQuaternionError(a, b));
+		}
+	}
+	context.check("matrices through Euler angles, every order", worstMatrix, 1e-12);
+	context.check("middle angles near gimbal lock (degrees)", worstMiddle, 1e-9);
+	context.check("quaternions through Euler angles, every order", worstQuaternion, 1e-12);
+	context.check("quaternions of imath through Euler angles", worstClass, 1e-12);
+
+	// matrices back to quaternions, the last spread and half turns, whose
+	// signs between x, y & z are not in the skew part
+	{
+		static const double halfTurns[][4] = {
+			{0.70710678118654752, -0.70710678118654752, 0.0, 0.0},
+			{0.0, 0.70710678118654752, -0.70710678118654752, 0.0},
+			{-0.57735026918962576, 0.57735026918962576, 0.57735026918962576, 0.0},
+			{1.0, 0.0, 0.0, 0.0},
+			{0.0, 0.0, 1.0, 0.0}
+		};
+		const unsigned int halves = sizeof(halfTurns) / sizeof(halfTurns[0]);
+		const unsigned int total = count + halves;
+		vector<double> p(total * 4), r(total * 4), pm(total * 9);
+		for (i = 0; i < total; ++i) {
+			for (k = 0; k < 4; ++k) {
+				p[k * total + i] = (i < count) ? q[k * count + i] : halfTurns[i - count][k];
+			}
+		}
+		quaternionToMatrix(total, &p[0], &p[total], &p[total * 2], &p[total * 3], &pm[0]);
+		matrixToQuaternion(total, &pm[0], &r[0], &r[total], &r[total * 2], &r[total * 3]);
+		double worstBack = 0.0;
+		for (i = 0; i < total; ++i) {
+			const double a[4] = {p[i], p[total + i], p[total * 2 + i], p[total * 3 + i]};
+			const double b[4] = {r[i], r[total + i], r[total * 2 + i], r[total * 3 + i]};
+			worstBack = max(worstBack, measureQuaternionError(a, b));
+		}
+		context.check("quaternions through matrices, half turns too", worstBack, 1e-12);
+	}
+
+	// Euler filter: a smooth track, which turns past 180 degrees, is fed
+	// back wrapped by whole turns, then with gimbal twins (a + 180,
+	// 180 - b, c + 180) on some frames; the filter gets the track back
+	{
+		const unsigned int frames = 240;
+		vector<double> truth(frames * 3), track(frames * 3);
+		double worstWrap = 0.0, worstTwin = 0.0;
+		for (int order = 0; order < 6; ++order) {
+			const char *name = orderNames[order];
+			const unsigned int a = name[0] - 'X', b = name[1] - 'X', c = name[2] - 'X';
+			for (i = 0; i < frames; ++i) {
+				truth[a * frames + i] = -170.0 + i * 2.5;
+				truth[b * frames + i] = 40.0 * sin(i * 0.05);
+				truth[c * frames + i] = 100.0 - i * 1.5;
+			}
+			for (unsigned int twins = 0; twins < 2; ++twins) {
+				for (i = 0; i < frames; ++i) {
+					double r[3];
+					for (k = 0; k < 3; ++k) r[k] = truth[k * frames + i];
+					if (twins && i % 3 == 1) {
+						r[a] += 180.0;
+						r[b] = 180.0 - r[b];
+						r[c] += 180.0;
+					}
+					for (k = 0; k < 3; ++k) {
+						// the first frame is kept, the rest are off by
+						// -1, 0 or 1 turns
+						const double turns = (0 == i) ? 0.0 : static_cast<double>((i * 7 + k) % 3) - 1.0;
+						track[k * frames + i] = wrapDegrees(r[k]) + 360.0 * turns;
+					}
+				}
+				filterEuler(order, frames, &track[0], &track[frames], &track[frames * 2]);
+				double &worst = twins ? worstTwin : worstWrap;
+				for (i = 0; i < frames * 3; ++i) worst = max(worst, fabs(track[i] - truth[i]));
+			}
+		}
+		context.check("Euler filter unwraps turns, every order", worstWrap, 1e-9);
+		context.check("Euler filter drops gimbal twins, every order", worstTwin, 1e-9);
+	}
+
+	// a spin over many blocks, about an axis free in both orders, keeps
+	// turning after another order
+	{
+		const unsigned int frames = 1500;
+		ostringstream file;
+		file << "HIERARCHY\nROOT Hips\n{\n\tOFFSET 0 0 0\n"
+			"\tCHANNELS 6 Xposition Yposition Zposition Zrotation Xrotation Yrotation\n"
+			"\tEnd Site\n\t{\n\t\tOFFSET 0 5 0\n\t}\n}\n"
+			"MOTION\nFrames: " << frames << "\nFrame Time: 0.01\n";
+		for (i = 0; i < frames; ++i) {
+			file << "0 0 0 " << i * 1.5 << " " << 20.0 * sin(i * 0.01) << " 10\n";
+		}
+		iSkeleton skel;
+		const bool parsed = (parseBvh(file.str(), skel) == MC_SUCCESS);
+		vector<double> before(frames * 3), after(frames * 3);
+		for (i = 0; parsed && i < frames; ++i) {
+			const iSkeleton::iFrameVec &r = skel.getNode(0).joint->motion[i].rotation;
+			before[i] = r.x; before[frames + i] = r.y; before[frames * 2 + i] = r.z;
+		}
+		const int source = skel.getRotOrder(skel.getNode(0).joint);
+		const bool converted = parsed &&
+			skel.convertRotOrder(Rotation::MC_RO_XYZ) == MC_SUCCESS;
+		double jump = converted ? 0.0 : HUGE_VAL;
+		for (i = 0; converted && i < frames; ++i) {
+			const iSkeleton::iFrameVec &r = skel.getNode(0).joint->motion[i].rotation;
+			after[i] = r.x; after[frames + i] = r.y; after[frames * 2 + i] = r.z;
+			for (k = 0; i > 0 && k < 3; ++k) {
+				jump = max(jump, fabs(after[k * frames + i] - after[k * frames + i - 1]));
+			}
+		}
+		context.check("reordered spin has no jumps (degrees)", jump, 5.0);
+
+		vector<double> turned(frames * 9), kept(frames * 9);
+		double worstTurn = converted ? 0.0 : HUGE_VAL;
+		if (converted) {
+			eulerToMatrix(source, frames, &before[0], &before[frames], &before[frames * 2], &turned[0]);
+			eulerToMatrix(Rotation::MC_RO_XYZ, frames, &after[0], &after[frames],
+				&after[frames * 2], &kept[0]);
+			for (i = 0; i < frames * 9; ++i) worstTurn = max(worstTurn, fabs(turned[i] - kept[i]));
+		}
+		context.check("reordered spin turns the same", worstTurn, 1e-5);
+	}
+
+	// rates of the kernels over a take sized block, best of a few runs
+	const unsigned int elements = 1 << 18;
+	vector<double> big(elements * 7);
+	for (i = 0; i < elements * 3; ++i) big[i] = first[i % spread] + (i % 7);
+	double toQuaternion = HUGE_VAL, toEuler = HUGE_VAL;
+	for (k = 0; k < 5; ++k) {
+		double *r = &big[0], *p = &big[elements * 3];
+		double begin = getWallTime();
+		eulerToQuaternion(Rotation::MC_RO_ZXY, elements, r, r + elements, r + elements * 2,
+			p, p + elements, p + elements * 2, p + elements * 3);
+		toQuaternion = min(toQuaternion, getWallTime() - begin);
+		begin = getWallTime();
+		quaternionToEuler(Rotation::MC_RO_ZXY, elements, p, p + elements, p + elements * 2,
+			p + elements * 3, r, r + elements, r + elements * 2);
+		toEuler = min(toEuler, getWallTime() - begin);
+	}
+	context.addMetric("rotation", "eulerToQuaternionPerSec", elements / max(toQuaternion, 1e-6));
+	context.addMetric("rotation", "quaternionToEulerPerSec", elements / max(toEuler, 1e-6));
+}
+
+//-----------------------------------------------------------------------------
+// seconds per product of a kernel over arrays of matrices, best of rounds
+//
+// Chained products take the previous product on the left, as transforms of
+// joints are composed down a hierarchy, so that each waits for the last.
+//-----------------------------------------------------------------------------
+template <typename T, typename K>
+static double timeMatrixKernel(const vector<T> &a, const vector<T> &b, vector<T> &c,
+	bool chained, unsigned int rounds)
+{
+	const unsigned int count = static_cast<unsigned int>(a.size() / 16);
+	const unsigned int passes = 64;
+	double best = HUGE_VAL;
+	for (unsigned int r = 0; r < rounds; ++r) {
+		const double begin = getWallTime();
+		for (unsigned int p = 0; p < passes; ++p) {
+			unsigned int i;
+			if (!chained) {
+				for (i = 0; i < count; ++i) K::multiply(&a[i * 16], &b[i * 16], &c[i * 16]);
+				continue;
+			}
+			// chains of 16, which keeps values finite
+			for (i = 0; i < count; ++i) {
+				const T *left = ((i % 16) != 0) ? &c[(i - 1) * 16] : &a[i * 16];
+				K::multiply(left, &b[i * 16], &c[i * 16]);
+			}
+		}
+		best = min(best, (getWallTime() - begin) / (static_cast<double>(count) * passes));
+	}
+	return best;
+}
+
+//-----------------------------------------------------------------------------
+// products of the matrix kernel of a type against the scalar kernel
+//-----------------------------------------------------------------------------
+template <typename T>
+static void measureMatrixKernel(iSuiteContext &context, const char *what,
+	const char *type, double tolerance)
+{
+	const unsigned int count = 1024;
+	vector<T> a(count * 16), b(count * 16), c(count * 16), reference(count * 16);
+	unsigned int i;
+	for (i = 0; i < count * 16; ++i) {
+		a[i] = static_cast<T>(fmod(i * 0.6180339887498949, 2.0) - 1.0);
+		b[i] = static_cast<T>(fmod(i * 0.7548776662466927, 2.0) - 1.0);
+	}
+
+	double error = 0.0;
+	for (i = 0; i < count; ++i) {
+		imath::iMatrixKernel<T>::multiply(&a[i * 16], &b[i * 16], &c[i * 16]);
+		imath::iMatrixScalarKernel<T>::multiply(&a[i * 16], &b[i * 16], &reference[i * 16]);
+	}
+	for (i = 0; i < count * 16; ++i) error = max(error, fabs(static_cast<double>(c[i] - reference[i])));
+	context.check(what, error, tolerance);
+
+	// interleaved, so that both see the same load of the machine; single
+	// products are bound by loads & stores, which the compiler may issue
+	// as well from the scalar code, chains are bound by the latency the
+	// kernel cuts down
+	for (unsigned int chained = 0; chained < 2; ++chained) {
+		double kernel = HUGE_VAL, scalar = HUGE_VAL;
+		for (i = 0; i < 5; ++i) {
+			kernel = min(kernel, timeMatrixKernel<T, imath::iMatrixKernel<T> >(a, b, c, chained != 0, 3));
+			scalar = min(scalar, timeMatrixKernel<T, imath::iMatrixScalarKernel<T> >(a, b, c, chained != 0, 3));
+		}
+		const string metric = string(type) + (chained ? "ChainSpeedup" : "ProductSpeedup");
+		const double speedup = scalar / max(kernel, 1e-12);
+		context.addMetric("imath", metric.c_str(), speedup);
+#if defined (IMATH_SSE2)
+		const double floor = chained ? 1.3 : 0.85;
+		context.check((metric + " over the floor").c_str(), speedup >= floor);
+#endif
+	}
+}
+
+//-----------------------------------------------------------------------------
+// a vector rotated about an axis by a matrix, as iVector did before
+//-----------------------------------------------------------------------------
+static imath::iVector<double> rotateByMatrix(const imath::iVector<double> &v,
+	unsigned int axis, double theta)
+{
+	const unsigned int b = (axis + 1) % 3, c = (axis + 2) % 3;
+	imath::iMatrix<double> m;
+	m(axis, axis) = 1;
+	m(b, b) = cos(theta);
+	m(b, c) = sin(theta);
+	m(c, b) = -sin(theta);
+	m(c, c) = cos(theta);
+	m(3, 3) = 1;
+	return m * v;
+}
+
+//-----------------------------------------------------------------------------
+// suite of imath: SSE2 kernels & fused transforms against the generic code
+// they replace, as speedups
+//-----------------------------------------------------------------------------
+static void runMathSuite(iSuiteContext &context)
+{
+	measureMatrixKernel<float>(context, "products of float matrices", "float", 1e-5);
+	measureMatrixKernel<double>(context, "products of double matrices", "double", 1e-14);
+
+	// rotations about the axes, directly and through matrices
+	const unsigned int count = 4096;
+	vector< imath::iVector<double> > vectors(count), direct(count), built(count);
+	vector<double> angles(count);
+	unsigned int i, axis;
+	for (i = 0; i < count; ++i) {
+		vectors[i].set(fmod(i * 0.618, 7.0) - 3.5, fmod(i * 0.755, 5.0) - 2.5, fmod(i * 0.570, 3.0) - 1.5);
+		angles[i] = fmod(i * 0.41, 6.28) - 3.14;
+	}
+	double error = 0.0;
+	for (axis = 0; axis < 3; ++axis) {
+		for (i = 0; i < count; ++i) {
+			imath::iVector<double> v = vectors[i];
+			if (0 == axis) v.rotateByAxisX(angles[i]);
+			else if (1 == axis) v.rotateByAxisY(angles[i]);
+			else v.rotateByAxisZ(angles[i]);
+			const imath::iVector<double> m = rotateByMatrix(vectors[i], axis, angles[i]);
+			error = max(error, max(fabs(v.x - m.x), max(fabs(v.y - m.y), fabs(v.z - m.z))));
+		}
+	}
+	context.check("rotations about axes", error, 1e-12);
+
+	// translations & scalings, directly and through matrices
+	error = 0.0;
+	for (i = 0; i < count; ++i) {
+		imath::iMatrix<double> t, s;
+		for (unsigned int k = 0; k < 4; ++k) t(k, k) = 1;
+		t(0, 3) = angles[i]; t(1, 3) = -2.0 * angles[i]; t(2, 3) = 0.5;
+		s(0, 0) = angles[i]; s(1, 1) = 3.0; s(2, 2) = -1.5; s(3, 3) = 1;
+		imath::iVector<double> v = vectors[i];
+		v.translate(angles[i], -2.0 * angles[i], 0.5).scale(angles[i], 3.0, -1.5);
+		const imath::iVector<double> m = s * (t * vectors[i]);
+		error = max(error, max(fabs(v.x - m.x), max(fabs(v.y - m.y), fabs(v.z - m.z))));
+	}
+	context.check("translations & scalings", error, 1e-12);
+
+	double fused = HUGE_VAL, matrix = HUGE_VAL;
+	for (unsigned int r = 0; r < 5; ++r) {
+		double begin = getWallTime();
+		for (i = 0; i < count; ++i) {
+			direct[i] = vectors[i];
+			direct[i].rotateByAxisY(angles[i]);
+		}
+		fused = min(fused, getWallTime() - begin);
+		begin = getWallTime();
+		for (i = 0; i < count; ++i) built[i] = rotateByMatrix(vectors[i], 1, angles[i]);
+		matrix = min(matrix, getWallTime() - begin);
+	}
+	context.check("timed rotations agree", (direct == built) ? 0.0 : 1.0, 0.0);
+	context.addMetric("imath", "rotateSpeedup", matrix / max(fused, 1e-12));
+}
+
+//-----------------------------------------------------------------------------
+// whether braces & brackets of JSON text pair up outside strings, with no
+// comma before a closing one
+//-----------------------------------------------------------------------------
+static bool isWellFormedJson(const string &text)
+{
+	string open;
+	bool quoted = false, comma = false;
+	for (string::size_type i = 0; i < text.size(); ++i) {
+		const char c = text[i];
+		if (quoted) {
+			if ('\\' == c) {
+				++i;
+			} else if ('"' == c) {
+				quoted = false;
+			}
+			continue;
+		}
+		if (isspace(static_cast<unsigned char>(c))) continue;
+		if ('"' == c) {
+			quoted = true;
+		} else if ('{' == c || '[' == c) {
+			open += c;
+		} else if ('}' == c || ']' == c) {
+			if (comma || open.empty() || open[open.size() - 1] != (('}' == c) ? '{' : '[')) return false;
+			open.erase(open.size() - 1);
+		}
+		comma = (',' == c);
+	}
+	return !quoted && open.empty();
+}
+
+//-----------------------------------------------------------------------------
+// suite of import reports: phases, stages, rates & memory of a load written
+// as JSON
+//-----------------------------------------------------------------------------
+static void runReportSuite(iSuiteContext &context)
+{
+	iGeneratorParam param;
+	param.joints = 12;
+	param.frames = 600;
+	ostringstream file;
+	iSkeleton skel;
+	iImportReport report;
+	bool loaded = false;
+	if (generateMocap(param, file) == MC_SUCCESS) {
+		istringstream in(file.str());
+		iMocapDataBvh parser(&in, &skel);
+		loaded = parser.load(&report) == MC_SUCCESS;
+	}
+	context.check("synthetic file loaded with a report", loaded);
+	if (!loaded) return;
+
+	// as the importer fills it in
+	report.file = "take \"quoted\".bvh";
+	report.bytes = static_cast<double>(file.str().size());
+	report.joints = skel.countJoints();
+	report.frames = skel.getFrames();
+	report.addPhase("keys", 1.0);
+	report.addPhase("keys", 0.5);
+	report.keys = 3.0;
+
+	// memory of every joint adds up to the motion, and the largest use
+	// is the one kept
+	iMemoryUse use, none;
+	skel.measureMemory(use);
+	double motion = 0.0;
+	for (unsigned int j = 0; j < use.joints.size(); ++j) motion += use.joints[j].motion;
+	context.check("memory of the motion measured", use.joints.size() == skel.countJoints() &&
+		use.joints[0].motion == static_cast<double>(param.frames * sizeof(iSkeleton::iFrame)) &&
+		motion == use.motion && use.hierarchy > 0.0 && use.names > 0.0 && use.caches > 0.0 &&
+		use.getTotal() == use.hierarchy + use.names + use.motion + use.slack + use.caches);
+	iSkeleton empty;
+	empty.measureMemory(none);
+	report.noteMemory(use);
+	report.noteMemory(none);
+	context.check("largest memory kept", report.memory.getTotal() == use.getTotal() &&
+		report.memory.joints.size() == use.joints.size());
+
+	ostringstream json;
+	report.write(json);
+	const string text = json.str();
+	context.check("report written as JSON", isWellFormedJson(text) &&
+		text.find("\"file\": \"take \\\"quoted\\\".bvh\"") != string::npos);
+	context.check("phases of the load in their order", report.getPhase("motion") > 0.0 &&
+		text.find("\"phases\": {\n\t\t\"hierarchy\": ") != string::npos &&
+		text.find("\t\t\"motion\": ") > text.find("\t\t\"hierarchy\": "));
+	context.check("stages of the parser", 3 == report.stages.size() &&
+		text.find("{ \"name\": \"read\"") != string::npos &&
+		text.find("{ \"name\": \"decode\"") != string::npos &&
+		text.find("{ \"name\": \"store\"") != string::npos);
+	char line[64];
+	sprintf(line, "\"frames\": %u,", param.frames);
+	context.check("rates of a phase entered twice", text.find(line) != string::npos &&
+		text.find("\"keysPerSecond\": 2,") != string::npos && report.getPhase("keys") == 1.5);
+	ostringstream memory;
+	memory << "\"memory\": {\n\t\t\"total\": " << use.getTotal() << ",\n";
+	context.check("memory written with every joint", text.find(memory.str()) != string::npos &&
+		text.find("{ \"name\": \"" + skel.getNode(0).joint->getName() + "\", \"motion\": ") != string::npos);
+}
+
+//-----------------------------------------------------------------------------
+// a thread recording a span of its own
+//-----------------------------------------------------------------------------
+static THREAD_PROC traceThreadProc(void *)
+{
+	ITRACE_SCOPE("suite.worker");
+	return THREAD_RETURN;
+}
+
+//-----------------------------------------------------------------------------
+// a trace written as a Chrome trace, read back as text
+//-----------------------------------------------------------------------------
+static bool readTrace(const string &path, string &text)
+{
+	text.clear();
+	if (writeChromeTrace(path) != MC_SUCCESS) return false;
+	ifstream in(path.c_str());
+	ostringstream buffer;
+	buffer << in.rdbuf();
+	text = buffer.str();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// suite of tracing: spans & messages of two threads, levels filtered at
+// compile time, and nothing recorded out of a trace
+//-----------------------------------------------------------------------------
+static void runTraceSuite(iSuiteContext &context)
+{
+	string path(context.scratch);
+	if (!path.empty() && path[path.size() - 1] != '/' && path[path.size() - 1] != '\\') path += '/';
+	path += "imocap_suite_trace.json";
+	startTrace();
+	{
+		ITRACE_SCOPE("suite.main");
+		ITRACE_LOG2("value " << 42);
+		ITRACE_LOG1("below the level");
+		traceMessage(2, "suite", "\"quoted\"\n");
+		iThread thread;
+		if (startThread(thread, traceThreadProc, NULL)) joinThread(thread);
+	}
+	stopTrace();
+	traceSpan("suite.after", getTraceTime(), getTraceTime());
+
+	string text;
+	const bool written = readTrace(path, text);
+	context.check("trace written as JSON", written && text.find("{\"traceEvents\":[") == 0 &&
+		text.find("],\"displayTimeUnit\":\"ms\"}") != string::npos);
+	unsigned int threads = 0;
+	for (string::size_type at = text.find("\"thread_name\""); at != string::npos;
+		at = text.find("\"thread_name\"", at + 1)) ++threads;
+	context.check("spans of both threads", 2 == threads &&
+		text.find("{\"name\":\"suite.main\",\"ph\":\"X\"") != string::npos &&
+		text.find("{\"name\":\"suite.worker\",\"ph\":\"X\"") != string::npos);
+	context.check("messages at the level kept, escaped", text.find("\"text\":\"value 42\"") != string::npos &&
+		text.find("\"text\":\"\\\"quoted\\\"\\n\"") != string::npos);
+	context.check("messages below the level compiled out", text.find("below the level") == string::npos);
+	context.check("nothing recorded once stopped", text.find("suite.after") == string::npos);
+
+	// a new trace drops the events of the last one
+	startTrace();
+	stopTrace();
+	context.check("events of the last trace dropped", readTrace(path, text) &&
+		text.find("suite.main") == string::npos);
+	remove(path.c_str());
+}
+
+//-----------------------------------------------------------------------------
+// table of suites
+//-----------------------------------------------------------------------------
+static const iSuiteEntry suiteTable[] = {
+	{ "clip", runClipSuite },
+	{ "imath", runMathSuite },
+	{ "keys", runKeysSuite },
+	{ "kinematics", runKinematicsSuite },
+	{ "longtake", runLongTakeSuite },
+	{ "parallel", runParallelSuite },
+	{ "report", runReportSuite },
+	{ "rotation", runRotationSuite },
+	{ "scheduler", runSchedulerSuite },
+	{ "skeleton", runSkeletonSuite },
+	{ "trace", runTraceSuite }
+};
+static const unsigned int suiteCount = sizeof(suiteTable) / sizeof(suiteTable[0]);
+
+//-----------------------------------------------------------------------------
+// getSuiteNames
+//-----------------------------------------------------------------------------
+void getSuiteNames(vector<string> &names)
+{
+	for (unsigned int i = 0; i < suiteCount; ++i) names.push_back(suiteTable[i].name);
+}
+
+//-----------------------------------------------------------------------------
+// runSuite
+//-----------------------------------------------------------------------------
+unsigned int runSuite(const string &name, const string &scratch, ostream &out,
+	iBenchmarkMetrics *metrics)
+{
+	for (unsigned int i = 0; i < suiteCount; ++i) {
+		if (name != suiteTable[i].name) continue;
+		iSuiteContext context(scratch, out, metrics);
+		out << "suite " << name << "\n";
+		const double begin = getWallTime();
+		suiteTable[i].run(context);
+		char line[128];
+		sprintf(line, "  %u checks failed in %.2fs", context.failures, getWallTime() - begin);
+		out << line << "\n";
+		return context.failures;
+	}
+	out << "suite " << name << " is unknown\n";
+	return 1;
+}
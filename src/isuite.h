@@ -0,0 +1,44 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __ISUITE_H__
+#define __ISUITE_H__
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ibenchmark.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// suites checking the core modules
+//
+// A suite runs a module headlessly and compares its results with a
+// reference worked out another way, a line is printed for every check.
+// Suites may time the module as well and add metrics named
+// "<suite>.<metric>", higher is better, so that the gate holds them like
+// the stages of the benchmark. Files are only written to the scratch
+// folder and removed afterwards. Nothing here depends on Maya.
+//
+// names of all suites
+void getSuiteNames(std::vector<std::string> &names);
+
+// run a suite, return the quantity of failed checks (an unknown suite
+// fails once)
+unsigned int runSuite(const std::string &name, const std::string &scratch,
+	std::ostream &out, iBenchmarkMetrics *metrics = NULL);
+
+#endif	// #ifndef __ISUITE_H__
@@ -0,0 +1,194 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __ITHREAD_H__
+#define __ITHREAD_H__
+
+#if defined (_WIN32)
+#	include <windows.h>
+#else
+#	include <pthread.h>
+#	include <unistd.h>
+#	include <sys/time.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// thin wrappers of native threads
+//
+// Only for sources of the core, Maya has its own headers for threads.
+//
+#if defined (_WIN32)
+
+typedef HANDLE iThread;
+typedef CRITICAL_SECTION iMutex;
+#	define THREAD_PROC		DWORD WINAPI
+#	define THREAD_RETURN	0
+
+inline void initMutex(iMutex &m) { InitializeCriticalSection(&m); }
+inline void freeMutex(iMutex &m) { DeleteCriticalSection(&m); }
+inline void lockMutex(iMutex &m) { EnterCriticalSection(&m); }
+inline void unlockMutex(iMutex &m) { LeaveCriticalSection(&m); }
+
+inline bool startThread(iThread &t, LPTHREAD_START_ROUTINE proc, void *arg) {
+	t = CreateThread(NULL, 0, proc, arg, 0, NULL);
+	return (t != NULL);
+}
+inline void joinThread(iThread &t) {
+	WaitForSingleObject(t, INFINITE);
+	CloseHandle(t);
+}
+inline void pauseThread() { Sleep(1); }
+inline double getWallTime() {
+	LARGE_INTEGER count, frequency;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+	return static_cast<double>(count.QuadPart) / static_cast<double>(frequency.QuadPart);
+}
+
+// identity of threads
+typedef DWORD iThreadId;
+inline iThreadId getThreadId() { return GetCurrentThreadId(); }
+inline bool isSameThread(iThreadId a, iThreadId b) { return a == b; }
+
+// slot of a pointer for each thread
+typedef DWORD iThreadKey;
+inline void initThreadKey(iThreadKey &k) { k = TlsAlloc(); }
+inline void freeThreadKey(iThreadKey &k) { TlsFree(k); }
+inline void *getThreadValue(iThreadKey &k) { return TlsGetValue(k); }
+inline void setThreadValue(iThreadKey &k, void *v) { TlsSetValue(k, v); }
+
+// counting signal, waits end with a timeout
+class iSignal {
+	HANDLE sem;
+public:
+	iSignal() { sem = CreateSemaphore(NULL, 0, 0x7fffffff, NULL); }
+	~iSignal() { CloseHandle(sem); }
+	void post(unsigned int n) { if (n > 0) ReleaseSemaphore(sem, n, NULL); }
+	void wait(unsigned int ms) { WaitForSingleObject(sem, ms); }
+};
+
+#else
+
+typedef pthread_t iThread;
+typedef pthread_mutex_t iMutex;
+#	define THREAD_PROC		void *
+#	define THREAD_RETURN	NULL
+
+inline void initMutex(iMutex &m) { pthread_mutex_init(&m, NULL); }
+inline void freeMutex(iMutex &m) { pthread_mutex_destroy(&m); }
+inline void lockMutex(iMutex &m) { pthread_mutex_lock(&m); }
+inline void unlockMutex(iMutex &m) { pthread_mutex_unlock(&m); }
+
+inline bool startThread(iThread &t, void *(*proc)(void *), void *arg) {
+	return (pthread_create(&t, NULL, proc, arg) == 0);
+}
+inline void joinThread(iThread &t) { pthread_join(t, NULL); }
+inline void pauseThread() { usleep(1000); }
+inline double getWallTime() {
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	return now.tv_sec + now.tv_usec * 1.0e-6;
+}
+
+// identity of threads
+typedef pthread_t iThreadId;
+inline iThreadId getThreadId() { return pthread_self(); }
+inline bool isSameThread(iThreadId a, iThreadId b) { return pthread_equal(a, b) != 0; }
+
+// slot of a pointer for each thread
+typedef pthread_key_t iThreadKey;
+inline void initThreadKey(iThreadKey &k) { pthread_key_create(&k, NULL); }
+inline void freeThreadKey(iThreadKey &k) { pthread_key_delete(k); }
+inline void *getThreadValue(iThreadKey &k) { return pthread_getspecific(k); }
+inline void setThreadValue(iThreadKey &k, void *v) { pthread_setspecific(k, v); }
+
+// counting signal, waits end with a timeout
+class iSignal {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	unsigned int count;
+public:
+	iSignal() : count(0) {
+		pthread_mutex_init(&lock, NULL);
+		pthread_cond_init(&cond, NULL);
+	}
+	~iSignal() {
+		pthread_cond_destroy(&cond);
+		pthread_mutex_destroy(&lock);
+	}
+	void post(unsigned int n) {
+		if (0 == n) return;
+		pthread_mutex_lock(&lock);
+		count += n;
+		pthread_cond_broadcast(&cond);
+		pthread_mutex_unlock(&lock);
+	}
+	void wait(unsigned int ms) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		struct timespec until;
+		long usec = now.tv_usec + static_cast<long>(ms) * 1000;
+		until.tv_sec = now.tv_sec + usec / 1000000;
+		until.tv_nsec = (usec % 1000000) * 1000;
+		pthread_mutex_lock(&lock);
+		if (0 == count) pthread_cond_timedwait(&cond, &lock, &until);
+		if (count > 0) --count;
+		pthread_mutex_unlock(&lock);
+	}
+};
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// full memory barrier
+//
+#if defined (_WIN32)
+inline void memoryBarrier() { MemoryBarrier(); }
+#elif defined (__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1))
+inline void memoryBarrier() { __sync_synchronize(); }
+#elif defined (__i386__) || defined (__x86_64__)
+inline void memoryBarrier() { __asm__ __volatile__ ("mfence" : : : "memory"); }
+#elif defined (__ppc__) || defined (__powerpc__)
+inline void memoryBarrier() { __asm__ __volatile__ ("sync" : : : "memory"); }
+#else
+#	error "memoryBarrier() is not available for this platform"
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// atomic addition, returns the new value
+//
+#if defined (_WIN32)
+inline long atomicAdd(volatile long &v, long n) { return InterlockedExchangeAdd(&v, n) + n; }
+#elif defined (__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1))
+inline long atomicAdd(volatile long &v, long n) { return __sync_add_and_fetch(&v, n); }
+#elif defined (__i386__) || defined (__x86_64__)
+inline long atomicAdd(volatile long &v, long n) {
+	long r = n;
+	__asm__ __volatile__ ("lock; xadd %0, %1" : "+r" (r), "+m" (v) : : "memory");
+	return r + n;
+}
+#elif defined (__ppc__) || defined (__powerpc__)
+inline long atomicAdd(volatile long &v, long n) {
+	long r;
+	__asm__ __volatile__ ("1: lwarx %0, 0, %2\n\tadd %0, %0, %3\n\tstwcx. %0, 0, %2\n\tbne- 1b"
+		: "=&r" (r), "+m" (v) : "r" (&v), "r" (n) : "cc", "memory");
+	return r;
+}
+#else
+#	error "atomicAdd() is not available for this platform"
+#endif
+
+#endif	// #ifndef __ITHREAD_H__
@@ -0,0 +1,266 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+
+#include "ithread.h"
+#include "iskeleton.h"
+#include "itrace.h"
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// rings of events
+//
+// A ring is written by its owner only. head is published after the event,
+// so a ring may be read by another thread once its owner stops recording.
+// Rings are never freed, startTrace() hands them out again.
+//
+enum MC_TRACE_PHASE { MC_TP_SPAN, MC_TP_MESSAGE };
+
+struct iTraceEvent {
+	const char *name;
+	double begin;
+	double end;
+	unsigned int level;
+	unsigned int phase;
+	char text[traceTextLength];
+};
+
+struct iTraceRing {
+	vector<iTraceEvent> events;
+	volatile unsigned long head;	// events ever recorded
+	unsigned int generation;		// trace it belongs to
+	iThreadId owner;
+	iTraceRing() : events(traceRingEvents), head(0), generation(0) {}
+};
+
+struct iTraceRegistry {
+	iMutex lock;
+	iThreadKey key;
+	vector<iTraceRing *> rings;		// all rings, owned or not
+	volatile bool enabled;
+	unsigned int generation;
+	double origin;
+
+	iTraceRegistry() : enabled(false), generation(0), origin(0.0) {
+		initMutex(lock);
+		initThreadKey(key);
+	}
+	~iTraceRegistry() {
+		for (unsigned int i = 0; i < rings.size(); ++i) delete rings[i];
+		freeThreadKey(key);
+		freeMutex(lock);
+	}
+};
+
+static iTraceRegistry registry;
+
+//-----------------------------------------------------------------------------
+// ring of the calling thread in the current trace
+//-----------------------------------------------------------------------------
+static iTraceRing *getRing()
+{
+	iTraceRing *ring = static_cast<iTraceRing *>(getThreadValue(registry.key));
+	const iThreadId self = getThreadId();
+	if (NULL != ring && ring->generation == registry.generation && isSameThread(ring->owner, self)) {
+		return ring;
+	}
+
+	// the first event of this thread in the trace
+	lockMutex(registry.lock);
+	ring = NULL;
+	for (unsigned int i = 0; i < registry.rings.size(); ++i) {
+		if (registry.rings[i]->generation != registry.generation) {
+			ring = registry.rings[i];
+			break;
+		}
+	}
+	if (NULL == ring) {
+		ring = new iTraceRing;
+		registry.rings.push_back(ring);
+	}
+	ring->head = 0;
+	ring->owner = self;
+	ring->generation = registry.generation;
+	unlockMutex(registry.lock);
+
+	setThreadValue(registry.key, ring);
+	return ring;
+}
+
+//-----------------------------------------------------------------------------
+// record an event
+//-----------------------------------------------------------------------------
+static void record(unsigned int phase, unsigned int level, const char *name,
+	double begin, double end, const char *text)
+{
+	iTraceRing *ring = getRing();
+	iTraceEvent &ev = ring->events[ring->head % traceRingEvents];
+	ev.name = name;
+	ev.begin = begin;
+	ev.end = end;
+	ev.level = level;
+	ev.phase = phase;
+	if (NULL != text) {
+		strncpy(ev.text, text, traceTextLength - 1);
+		ev.text[traceTextLength - 1] = '\0';
+	} else {
+		ev.text[0] = '\0';
+	}
+	memoryBarrier();
+	ring->head = ring->head + 1;
+}
+
+//-----------------------------------------------------------------------------
+// write a string as JSON
+//-----------------------------------------------------------------------------
+static void writeString(ostream &out, const char *s)
+{
+	out << '"';
+	for (; *s; ++s) {
+		const unsigned char c = static_cast<unsigned char>(*s);
+		switch (c) {
+		case '"': out << "\\\""; break;
+		case '\\': out << "\\\\"; break;
+		case '\n': out << "\\n"; break;
+		case '\r': out << "\\r"; break;
+		case '\t': out << "\\t"; break;
+		default:
+			if (c < 0x20) {
+				char buf[8];
+				sprintf(buf, "\\u%04x", c);
+				out << buf;
+			} else {
+				out << *s;
+			}
+			break;
+		}
+	}
+	out << '"';
+}
+
+//-----------------------------------------------------------------------------
+// startTrace
+//-----------------------------------------------------------------------------
+void startTrace()
+{
+	lockMutex(registry.lock);
+	++registry.generation;
+	registry.origin = getTraceTime();
+	memoryBarrier();
+	registry.enabled = true;
+	unlockMutex(registry.lock);
+}
+
+//-----------------------------------------------------------------------------
+// stopTrace
+//-----------------------------------------------------------------------------
+void stopTrace()
+{
+	registry.enabled = false;
+	memoryBarrier();
+}
+
+//-----------------------------------------------------------------------------
+// isTracing
+//-----------------------------------------------------------------------------
+bool isTracing()
+{
+	return registry.enabled;
+}
+
+//-----------------------------------------------------------------------------
+// getTraceTime
+//-----------------------------------------------------------------------------
+double getTraceTime()
+{
+	return getWallTime();
+}
+
+//-----------------------------------------------------------------------------
+// traceSpan
+//-----------------------------------------------------------------------------
+void traceSpan(const char *name, double begin, double end)
+{
+	if (!registry.enabled) return;
+	record(MC_TP_SPAN, 0, name, begin, end, NULL);
+}
+
+//-----------------------------------------------------------------------------
+// traceMessage
+//-----------------------------------------------------------------------------
+void traceMessage(unsigned int level, const char *name, const char *text)
+{
+	if (!registry.enabled) return;
+	const double now = getTraceTime();
+	record(MC_TP_MESSAGE, level, name, now, now, text);
+}
+
+//-----------------------------------------------------------------------------
+// writeChromeTrace
+//-----------------------------------------------------------------------------
+int writeChromeTrace(const string &path)
+{
+	ofstream out(path.c_str());
+	if (!out) return MC_INVALID_STREAM;
+	out.setf(ios::fixed);
+	out.precision(3);
+
+	lockMutex(registry.lock);
+	out << "{\"traceEvents\":[";
+	bool first = true;
+	unsigned int tid = 0;
+	for (unsigned int i = 0; i < registry.rings.size(); ++i) {
+		const iTraceRing &ring = *registry.rings[i];
+		if (ring.generation != registry.generation) continue;
+
+		out << (first ? "\n" : ",\n");
+		first = false;
+		out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+			<< ",\"args\":{\"name\":\"thread " << tid << "\"}}";
+
+		// the oldest events may have been overwritten
+		const unsigned long head = ring.head;
+		const unsigned long tail = (head > traceRingEvents) ? head - traceRingEvents : 0;
+		for (unsigned long e = tail; e < head; ++e) {
+			const iTraceEvent &ev = ring.events[e % traceRingEvents];
+			const double ts = (ev.begin - registry.origin) * 1.0e6;
+			out << ",\n{\"name\":";
+			writeString(out, ev.name);
+			if (MC_TP_SPAN == ev.phase) {
+				out << ",\"ph\":\"X\",\"ts\":" << ts << ",\"dur\":" << (ev.end - ev.begin) * 1.0e6;
+			} else {
+				out << ",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << ts;
+			}
+			out << ",\"pid\":1,\"tid\":" << tid;
+			if (MC_TP_MESSAGE == ev.phase) {
+				out << ",\"args\":{\"level\":" << ev.level << ",\"text\":";
+				writeString(out, ev.text);
+				out << "}";
+			}
+			out << "}";
+		}
+		++tid;
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	unlockMutex(registry.lock);
+
+	return out ? MC_SUCCESS : MC_INVALID_STREAM;
+}
@@ -0,0 +1,127 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  MoCap File Importer
+//  Copyright(c) Shun Cox (shuncox@gmail.com)
+//
+//  THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY
+//  KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE
+//  IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR
+//  PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+//
+// $Id$
+//
+////////////////////////////////////////////////////////////////////////////
+
+#ifndef __ITRACE_H__
+#define __ITRACE_H__
+
+#include <string>
+#include <sstream>
+
+///////////////////////////////////////////////////////////////////////////////
+// structured tracing
+//
+// Events are kept in a ring buffer owned by the thread recording them, so
+// nothing is locked or formatted on the way in except the text of messages.
+// Tracing is off until startTrace(), then spans and messages are recorded
+// until stopTrace() and may be written as a Chrome trace (chrome://tracing).
+//
+// ITRACE_LEVEL filters messages at compile time with the levels of ILOG,
+// messages below it are compiled out, 5 compiles out everything.
+//
+#ifndef ITRACE_LEVEL
+#	define ITRACE_LEVEL 2
+#endif
+
+// events kept by a thread, older ones are overwritten
+const unsigned int traceRingEvents = 8192;
+// characters of a message kept by an event
+const unsigned int traceTextLength = 64;
+
+// start recording (events of the last trace are dropped)
+void startTrace();
+// stop recording
+void stopTrace();
+// recording or not
+bool isTracing();
+
+// seconds from an arbitrary moment, precise enough for spans
+double getTraceTime();
+// record a span of the calling thread
+void traceSpan(const char *name, double begin, double end);
+// record a message of the calling thread
+void traceMessage(unsigned int level, const char *name, const char *text);
+
+// write events of all threads as a Chrome trace (JSON), call it when
+// nothing is being recorded
+int writeChromeTrace(const std::string &path);
+
+///////////////////////////////////////////////////////////////////////////////
+// span from construction to destruction
+//
+class iTraceScope {
+public:
+	explicit iTraceScope(const char *spanName) : name(spanName), active(isTracing()) {
+		if (active) begin = getTraceTime();
+	}
+	~iTraceScope() {
+		if (active) traceSpan(name, begin, getTraceTime());
+	}
+private:
+	const char *name;
+	bool active;
+	double begin;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// macros
+//
+// ITRACE_SCOPE(name)		: span of the enclosing block, name is a literal
+// ITRACE_LOGn(level, x)	: message streamed like ILOG
+//
+#define ITRACE_JOIN2(a, b)	a##b
+#define ITRACE_JOIN(a, b)	ITRACE_JOIN2(a, b)
+
+#if ITRACE_LEVEL < 5
+#	define ITRACE_SCOPE(name)	iTraceScope ITRACE_JOIN(traceScope, __LINE__)(name)
+#	define ITRACE_LOG(level, x)	{\
+		if (isTracing()) {\
+			std::ostringstream traceBuf;\
+			traceBuf << x;\
+			traceMessage(level, __FUNCTION__, traceBuf.str().c_str());\
+		}\
+	}
+#else
+#	define ITRACE_SCOPE(name)
+#	define ITRACE_LOG(level, x)
+#endif
+
+#if ITRACE_LEVEL <= 0
+#	define ITRACE_LOG0(x)	ITRACE_LOG(0, x)
+#else
+#	define ITRACE_LOG0(x)
+#endif
+#if ITRACE_LEVEL <= 1
+#	define ITRACE_LOG1(x)	ITRACE_LOG(1, x)
+#else
+#	define ITRACE_LOG1(x)
+#endif
+#if ITRACE_LEVEL <= 2
+#	define ITRACE_LOG2(x)	ITRACE_LOG(2, x)
+#else
+#	define ITRACE_LOG2(x)
+#endif
+#if ITRACE_LEVEL <= 3
+#	define ITRACE_LOG3(x)	ITRACE_LOG(3, x)
+#else
+#	define ITRACE_LOG3(x)
+#endif
+#if ITRACE_LEVEL <= 4
+#	define ITRACE_LOG4(x)	ITRACE_LOG(4, x)
+#else
+#	define ITRACE_LOG4(x)
+#endif
+
+#endif	// #ifndef __ITRACE_H__
@@ -34,6 +34,11 @@ public:
 
 	iVector(const float (&c)[3]) : x(c[0]), y(c[1]), z(c[2]) { }
 
+	// from a vector of another precision
+	template <typename U>
+	explicit iVector(const iVector<U> &v1) :
+		x(static_cast<T>(v1.x)), y(static_cast<T>(v1.y)), z(static_cast<T>(v1.z)) { }
+
 	inline void clear() { x = y = z = 0.0; }
 
 	// set & get
@@ -52,7 +57,7 @@ public:
 		return *this;
 	}
 
-	inline void get(T *xx, T *yy, T *zz) {
+	inline void get(T *xx, T *yy, T *zz) const {
 		*xx = x; *yy = y; *zz = z;
 	}
 
@@ -155,83 +160,55 @@ public:
 	}
 
 	// 3d geometry transformation
+	// (the same results as the matrices of them, without building one)
 	// tanslation
-	iVector<T>& translate(T tx, T ty, T tz) {
-		iMatrix<T> m1;
-		m1(0, 0) = 1;
-		m1(1, 1) = 1;
-		m1(2, 2) = 1;
-		m1(3, 3) = 1;
-		m1(0, 3) = tx;
-		m1(1, 3) = ty;
-		m1(2, 3) = tz;
-		*this = m1 * (*this);
+	inline iVector<T>& translate(T tx, T ty, T tz) {
+		x += tx; y += ty; z += tz;
 		return *this;
 	}
 
 	// rotation
-	iVector<T>& rotateByAxisX(T theta) {
-		iMatrix<T> m1;
-		T cosTheta = cos(theta);
-		T sinTheta = sin(theta);
-		m1(0, 0) = 1;
-		m1(1, 1) = cosTheta;
-		m1(1, 2) = sinTheta;
-		m1(2, 1) = - sinTheta;
-		m1(2, 2) = cosTheta;
-		m1(3, 3) = 1;
-		*this = m1 * (*this);
+	inline iVector<T>& rotateByAxisX(T theta) {
+		const T cosTheta = cos(theta);
+		const T sinTheta = sin(theta);
+		const T yy = y;
+		y = cosTheta * yy + sinTheta * z;
+		z = cosTheta * z - sinTheta * yy;
 		return *this;
 	}
 
-	iVector<T>& rotateByAxisZ(T theta) {
-		iMatrix<T> m1;
-		T cosTheta = cos(theta);
-		T sinTheta = sin(theta);
-		m1(0, 0) = cosTheta;
-		m1(0, 1) = sinTheta;
-		m1(1, 0) = - sinTheta;
-		m1(1, 1) = cosTheta;
-		m1(2, 2) = 1;
-		m1(3, 3) = 1;
-		*this = m1 * (*this);
+	inline iVector<T>& rotateByAxisZ(T theta) {
+		const T cosTheta = cos(theta);
+		const T sinTheta = sin(theta);
+		const T xx = x;
+		x = cosTheta * xx + sinTheta * y;
+		y = cosTheta * y - sinTheta * xx;
 		return *this;
 	}
 
-	iVector<T>& rotateByAxisY(T theta) {
-		iVector<T> v1;
-		iMatrix<T> m1;
-		T cosTheta = cos(theta);
-		T sinTheta = sin(theta);
-		m1(0, 0) = cosTheta;
-		m1(0, 2) = - sinTheta;
-		m1(1, 1) = 1;
-		m1(2, 0) = sinTheta;
-		m1(2, 2) = cosTheta;
-		m1(3, 3) = 1;
-		*this = m1 * (*this);
+	inline iVector<T>& rotateByAxisY(T theta) {
+		const T cosTheta = cos(theta);
+		const T sinTheta = sin(theta);
+		const T xx = x;
+		x = cosTheta * xx - sinTheta * z;
+		z = sinTheta * xx + cosTheta * z;
 		return *this;
 	}
 
 	// scaling
-	iVector<T>& scale(T sx, T sy, T sz) {
-		iMatrix<T> m1;
-		m1(0, 0) = sx;
-		m1(1, 1) = sy;
-		m1(2, 2) = sz;
-		m1(3, 3) = 1;
-		*this = m1 * (*this);
+	inline iVector<T>& scale(T sx, T sy, T sz) {
+		x *= sx; y *= sy; z *= sz;
 		return *this;
 	}
 
-	inline friend std::ostream& operator<<(std::ostream &out, iVector<T> &temp) {
+	inline friend std::ostream& operator<<(std::ostream &out, const iVector<T> &temp) {
 		temp.output(out);
 		return out;
 	}
 
 private:
 	// overriding standard output operator
-	inline void output(std::ostream &out) {
+	inline void output(std::ostream &out) const {
 		out << "(" << x << ", " << y << ", " << z << ")";
 	}
 };
@@ -256,7 +233,7 @@ public:
 	}
 
 	inline void clear() {
-		r = g = b = a = 0.0;
+		x = y = z = w = 0.0;
 	}
 
 	// assign a value
@@ -275,7 +252,7 @@ public:
 		return *this;
 	}
 
-	inline void get(T *xx, T *yy, T *zz, T *ww) {
+	inline void get(T *xx, T *yy, T *zz, T *ww) const {
 		*xx = x; *yy = y; *zz = z; *ww = w;
 	}
 
@@ -286,15 +263,15 @@ public:
 		return (T *)(&i);
 	}
 
-	inline friend std::ostream& operator<<(std::ostream &out, iVector4<T> &temp) {
+	inline friend std::ostream& operator<<(std::ostream &out, const iVector4<T> &temp) {
 		temp.output(out);
 		return out;
 	}
 
 private:
 	// overriding standard output operator
-	inline void output(std::ostream &out) {
-		out << "(" << x << ", " << y << ", " << z ", " << w << ")";
+	inline void output(std::ostream &out) const {
+		out << "(" << x << ", " << y << ", " << z << ", " << w << ")";
 	}
 };
 
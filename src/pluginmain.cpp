@@ -16,7 +16,12 @@
 
 
 #include "imocapimport.h"
+#include "imocapstreamnode.h"
 #include "idebug.h"
+#include "iparallel.h"
+#include "imocapasync.h"
+#include "imocapreport.h"
+#include "imocapbenchmark.h"
 
 #include <maya/MFnPlugin.h>
 
@@ -25,7 +30,7 @@ const char *IM_VENDOR_NAME = "Shun Cox @ CAPG, ZJU";
 
 const char *const imocapImportOptionScript = "imocapImportOptions";
 const char *const imocapImportDefaultOptions = 
-	"bonesOnly=false;merge=false;scale=1;rotationOrder=none;startFrame=0;endFrame=2147483648";
+	"bonesOnly=false;merge=false;scale=1;rotationOrder=none;startFrame=0;endFrame=2147483648;frameTime=0;stream=false;eulerFilter=false;reduce=false;rotationTolerance=0.01;translationTolerance=0.01;threads=0;memoryBudget=0;outOfCore=false;async=false;report=false";
 
 //-----------------------------------------------------------------------------
 // Initialize Plug-in
@@ -40,6 +45,23 @@ MStatus initializePlugin(MObject obj)
 											(char *)imocapImportOptionScript,
 											(char *)imocapImportDefaultOptions, 
 											false);
+	if (stat != MS::kSuccess) {
+		return stat;
+	}
+
+	stat = impPlugIn.registerNode(imocapStreamNode::typeName, imocapStreamNode::id,
+								imocapStreamNode::creator, imocapStreamNode::initialize);
+	if (stat == MS::kSuccess) {
+		stat = impPlugIn.registerCommand(imocapReportCmd::commandName, imocapReportCmd::creator,
+										imocapReportCmd::newSyntax);
+	}
+	if (stat == MS::kSuccess) {
+		stat = impPlugIn.registerCommand(imocapBenchmarkCmd::commandName, imocapBenchmarkCmd::creator,
+										imocapBenchmarkCmd::newSyntax);
+	}
+
+	// Workers are started by the first parallel stage
+	startPool();
 
 	ILOG2("Plug-in was loaded.");
 
@@ -64,8 +86,21 @@ MStatus uninitializePlugin(MObject obj)
 {
 	MStatus stat = MS::kFailure;
 
+	// No worker may outlive the plug-in
+	imyAsyncImport::abort();
+	stopPool();
+
 	MFnPlugin impPlugIn(obj);
 	stat = impPlugIn.deregisterFileTranslator(IM_IMPORTER_NAME);
+	if (stat == MS::kSuccess) {
+		stat = impPlugIn.deregisterNode(imocapStreamNode::id);
+	}
+	if (stat == MS::kSuccess) {
+		stat = impPlugIn.deregisterCommand(imocapReportCmd::commandName);
+	}
+	if (stat == MS::kSuccess) {
+		stat = impPlugIn.deregisterCommand(imocapBenchmarkCmd::commandName);
+	}
 
 	ILOG2("Plug-in was unloaded.");
 